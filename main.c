@@ -1,7 +1,28 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE //! O_DIRECT
+#endif
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <time.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "traitement_image.h"
 
 #define C_PI 3.141592653589793
 #define MAX_THETA 180
@@ -9,13 +30,17 @@
 /*-------------------------------------------
 //? DEFINITION DE LA STRUCTURE DE DONNEES QUI VA RECEVOIR L'IMAGE
 //? la largeur, la hauteur, la valeur maximale d'un pixel et le table des valeurs des pixels
+//? max_val > 255: pixels de 16 bits (unsigned short dans l'ordre natif, big-endian dans le fichier)
 ---------------------------------------------*/
 typedef struct
 {
     int largeur;
     int hauteur;
     int max_val;
-    unsigned char *data;
+    unsigned char *data;      //! octets, ou unsigned short si max_val > 255
+    void *projection;         //! fichier projeté (mmap) dont data est une vue, NULL si data vient de malloc
+    size_t taille_projection;
+    int depuis_pool;          //! data vient du pool de tampons et y retourne à la libération
 } ImagePGM;
 
 /*-------------------------------------------
@@ -32,1120 +57,7859 @@ int get_numero_colonne(int n, int largeur)
     return n % largeur;
 }
 //! position dans le fichier
-int get_position(int i, int j, int largeur)
+size_t get_position(int i, int j, int largeur)
 {
-    return i * largeur + j;
+    return (size_t)i * largeur + j;
 }
 
 /*-------------------------------------------
-//? FONCTIONS DE LECTURE DE L'IMAGE
+//? PIXELS DE 8 OU 16 BITS
+//? chaque noyau est écrit une fois avec un paramètre constant seize et des accès
+//? PIXEL_LIRE / PIXEL_ECRIRE; ses deux versions _8 et _16 sont obtenues par inlining
+//? (SPECIALISER_BANDE), la condition disparaît à la compilation dans chacune.
 ---------------------------------------------*/
-ImagePGM *lecture(const char *nom_fichier)
-{
-    /*-------------------------------------------
-    //? LECTURE DU FICHIER QUI CONTIENT L'IMAGE
-    ---------------------------------------------*/
-    FILE *fichier = fopen(nom_fichier, "r");
-    if (!fichier)
-    {
-        perror("cannot open");
-        return NULL;
-    }
+#define NIVEAUX_8_BITS 256
+#define NIVEAUX_16_BITS 65536
 
-    /*-------------------------------------------
-    //? LIBERATION DE L'ESPACE MEMOIRE POUR CONTENIR LES INFOS DE L'IMAGE
-    ---------------------------------------------*/
-    ImagePGM *image = malloc(sizeof(ImagePGM));
-    if (!image)
-    {
-        fclose(fichier);
-        perror("cannot allocate memory");
-        return NULL;
-    }
+#define PIXEL_LIRE(ligne, j, seize) ((seize) ? ((const unsigned short *)(ligne))[j] : ((const unsigned char *)(ligne))[j])
+#define PIXEL_ECRIRE(ligne, j, valeur, seize)          \
+    do                                                 \
+    {                                                  \
+        if (seize)                                     \
+            ((unsigned short *)(ligne))[j] = (valeur); \
+        else                                           \
+            ((unsigned char *)(ligne))[j] = (valeur);  \
+    } while (0)
 
-    /*-------------------------------------------
-    //? LECTURE DE L'ENTETE DU FICHIER PGM
-    ---------------------------------------------*/
-    char format[3];
-    fscanf(fichier, "%2s", format);
-    if (strcmp(format, "P5") != 0)
-    {
-        fprintf(stderr, "Format non pris en charge: %s\n", format);
-        free(image);
-        fclose(fichier);
-        return NULL;
-    }
+#define SPECIALISE static inline __attribute__((always_inline))
+//! tâches par bandes nom_8 et nom_16 à partir de nom(contexte, debut, fin, seize)
+#define SPECIALISER_BANDE(nom)                                                                   \
+    static void nom##_8(void *contexte, int debut, int fin) { nom(contexte, debut, fin, 0); }  \
+    static void nom##_16(void *contexte, int debut, int fin) { nom(contexte, debut, fin, 1); }
 
-    /*-------------------------------------------
-    //? LECTURE DES INFORMATION SUR LE FICHIER TEL QUE
-    //? LA LONGUEUR, LA LARGEUR, ET LA VALEUR MAX D'UN PIXEL
-    ---------------------------------------------*/
-    fscanf(fichier, "%d %d", &image->largeur, &image->hauteur);
-    fscanf(fichier, "%d", &image->max_val);
-    //?LECTURE DE LA LIGNE VIDE
-    fgetc(fichier);
+static inline int image_16_bits(const ImagePGM *image)
+{
+    return image->max_val > 255;
+}
 
-    /*-------------------------------------------
-    //? LIBERATION DE L'ESPACE MEMOIRE POUR CONTENIR LES DONNEES DE L'IMAGE
-    ---------------------------------------------*/
-    image->data = malloc(image->largeur * image->hauteur);
-    if (!image->data)
-    {
-        free(image);
-        fclose(fichier);
-        perror("ne peut pas allouer la mémoire à l'image");
-        return NULL;
-    }
-    /*-------------------------------------------
-    //? LECTURE RÉCUPÉRATION DE L'IMAGE
-    ---------------------------------------------*/
-    fread(image->data, sizeof(unsigned char), image->largeur * image->hauteur, fichier);
-    fclose(fichier);
+static inline size_t octets_par_pixel(const ImagePGM *image)
+{
+    return image_16_bits(image) ? 2 : 1;
+}
 
-    return image;
+//! nombre de cases des histogrammes et des tables: tous les niveaux du type de pixel
+static inline int niveaux_pixel(const ImagePGM *image)
+{
+    return image_16_bits(image) ? NIVEAUX_16_BITS : NIVEAUX_8_BITS;
+}
+
+//! début de la ligne i
+static inline unsigned char *ligne_image(const ImagePGM *image, int i)
+{
+    return image->data + get_position(i, 0, image->largeur) * octets_par_pixel(image);
 }
 
 /*-------------------------------------------
-//? FONCTION D'ENREGISTREMENT DE L'IMAGE MODIFIÉE
+//? PROFILAGE DES ÉTAPES (--profile)
+//? chaque étape (lecture, allocation, opérateur, écriture, bande du pool, ...) est encadrée
+//? par PROFIL_DEBUT / PROFIL_FIN: horloge monotone et, si perf_event_open est permis,
+//? cycles et instructions du thread qui l'exécute (compteurs ouverts par thread au premier
+//? usage; les bandes du pool portent les compteurs des threads de travail).
+//? À la sortie: résumé par étape sur stderr, ou trace Chrome (chrome://tracing, Perfetto)
+//? si un fichier est donné. Désactivé, chaque point de mesure coûte un test de profilage.actif.
 ---------------------------------------------*/
-void enregister_pgm(const char *nom_fichier, ImagePGM *image)
+#define ETAPES_PROFIL_MAX 64
+#define EVENEMENTS_PROFIL_MAX (1 << 20)
+#define NB_COMPTEURS_PROFIL 2 //! cycles, instructions
+
+typedef struct
 {
-    FILE *fichier = fopen(nom_fichier, "w");
-    if (!fichier)
-    {
-        perror("cannot open");
-        return;
-    }
+    double debut_ms;
+    long long compteurs[NB_COMPTEURS_PROFIL];
+} MesureProfil;
+
+typedef struct
+{
+    const char *nom;
+    long long appels;
+    double total_ms;
+    double min_ms;
+    double max_ms;
+    long long compteurs[NB_COMPTEURS_PROFIL];
+} StatEtape;
+
+typedef struct
+{
+    const char *nom;
+    int thread;
+    double debut_ms;
+    double duree_ms;
+    long long compteurs[NB_COMPTEURS_PROFIL];
+} EvenementProfil;
+
+static struct
+{
+    int actif;
+    const char *fichier_trace; //! NULL: résumé sur stderr
+    double origine_ms;
+    int compteurs; //! 1 si au moins un thread a pu ouvrir ses compteurs
+    int nb_threads;
+    StatEtape etapes[ETAPES_PROFIL_MAX];
+    int nb_etapes;
+    EvenementProfil *evenements;
+    size_t nb_evenements;
+    size_t capacite_evenements;
+    size_t evenements_perdus;
+    pthread_mutex_t verrou;
+} profilage = {.verrou = PTHREAD_MUTEX_INITIALIZER};
+
+//! descripteurs perf du thread courant (-1: indisponible), numéro du thread dans la trace
+static __thread int compteurs_thread[NB_COMPTEURS_PROFIL];
+static __thread int compteurs_thread_ouverts;
+static __thread int numero_thread_profil;
 
-    fprintf(fichier, "P5\n%d %d\n%d\n", image->largeur, image->hauteur, image->max_val);
-    fwrite(image->data, sizeof(unsigned char), image->largeur * image->hauteur, fichier);
-    fclose(fichier);
+double horloge_ms(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
 }
-/*-------------------------------------------
-//? FONCTION DE CRÉATION D'IMAGE NOIR
----------------------------------------------*/
-ImagePGM *init_image_pgm(int hauteur, int largeur, int max_val)
+
+static int ouvrir_compteur_materiel(unsigned long long evenement)
 {
-    /*-------------------------------------------
-    //? LIBERATION DE L'ESPACE MEMOIRE POUR CONTENIR LES INFOS DE L'IMAGE
-    ---------------------------------------------*/
-    ImagePGM *image_noir = malloc(sizeof(ImagePGM));
-    if (!image_noir)
-    {
-        perror("cannot allocate memory");
-        return NULL;
-    }
-    //? RÉCUPÉRATION DES PARAMÈTRES DE L'IMAGE
-    image_noir->hauteur = hauteur;
-    image_noir->largeur = largeur;
-    image_noir->max_val = max_val;
+#ifdef __linux__
+    struct perf_event_attr attributs;
+    memset(&attributs, 0, sizeof(attributs));
+    attributs.type = PERF_TYPE_HARDWARE;
+    attributs.size = sizeof(attributs);
+    attributs.config = evenement;
+    attributs.exclude_kernel = 1; //! permis avec perf_event_paranoid <= 2
+    attributs.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attributs, 0, -1, -1, 0);
+#else
+    (void)evenement;
+    return -1;
+#endif
+}
 
-    /*-------------------------------------------
-    //? LIBERATION DE L'ESPACE MEMOIRE POUR CONTENIR LES DONNEES DE L'IMAGE
-    ---------------------------------------------*/
-    image_noir->data = malloc(image_noir->largeur * image_noir->hauteur);
-    if (!image_noir->data)
+static void lire_compteurs_thread(long long *valeurs)
+{
+    if (!compteurs_thread_ouverts)
     {
-        free(image_noir);
-        perror("ne peut pas allouer la mémoire à l'image");
-        return NULL;
+        compteurs_thread_ouverts = 1;
+#ifdef __linux__
+        compteurs_thread[0] = ouvrir_compteur_materiel(PERF_COUNT_HW_CPU_CYCLES);
+        compteurs_thread[1] = ouvrir_compteur_materiel(PERF_COUNT_HW_INSTRUCTIONS);
+#else
+        compteurs_thread[0] = compteurs_thread[1] = -1;
+#endif
+        if (compteurs_thread[0] >= 0 && compteurs_thread[1] >= 0)
+            profilage.compteurs = 1;
+        numero_thread_profil = __atomic_add_fetch(&profilage.nb_threads, 1, __ATOMIC_RELAXED);
     }
-    for (int i = 0; i < image_noir->largeur * image_noir->hauteur; i++)
+    for (int k = 0; k < NB_COMPTEURS_PROFIL; k++)
     {
-        image_noir->data[i] = 0;
+        valeurs[k] = 0;
+        if (compteurs_thread[k] >= 0 && read(compteurs_thread[k], &valeurs[k], sizeof(long long)) != sizeof(long long))
+            valeurs[k] = 0;
     }
-    return image_noir;
 }
 
-/*-------------------------------------------
-//? FONCTION DE LIBÉRATION DE L'ESPACE MÉMOIRE UTILISÉ POUR MANIPULER L'IMAGE
----------------------------------------------*/
-void liberer_une_image(ImagePGM *image)
+static void profil_debut_mesure(MesureProfil *mesure)
 {
-    if (image)
-    {
-        free(image->data);
-        free(image);
-    }
+    lire_compteurs_thread(mesure->compteurs);
+    mesure->debut_ms = horloge_ms();
 }
-/*-------------------------------------------
-//? FONCTION DE SOMME DE DEUX IMAGES
----------------------------------------------*/
-ImagePGM *somme_images(ImagePGM *image1, ImagePGM *image2)
+
+static void profil_fin_mesure(const MesureProfil *mesure, const char *nom)
 {
-    if (image1->hauteur != image2->hauteur || image1->largeur != image2->largeur)
+    double fin_ms = horloge_ms();
+    long long compteurs[NB_COMPTEURS_PROFIL];
+    lire_compteurs_thread(compteurs);
+    double duree = fin_ms - mesure->debut_ms;
+    for (int k = 0; k < NB_COMPTEURS_PROFIL; k++)
     {
-        printf("\nles hauteurs ou les largeurs de vos deux images ne correspondent pas\n");
-        return NULL;
+        compteurs[k] -= mesure->compteurs[k];
     }
-    /*-------------------------------------------
-    //? LIBERATION DE L'ESPACE MEMOIRE POUR CONTENIR LES INFOS DE L'IMAGE
-    ---------------------------------------------*/
-    ImagePGM *somme = malloc(sizeof(ImagePGM));
-    if (!somme)
+
+    pthread_mutex_lock(&profilage.verrou);
+    //? les noms sont des chaînes statiques: la comparaison des pointeurs suffit presque toujours
+    StatEtape *etape = NULL;
+    for (int e = 0; e < profilage.nb_etapes && !etape; e++)
     {
-        perror("cannot allocate memory");
-        return NULL;
+        if (profilage.etapes[e].nom == nom || strcmp(profilage.etapes[e].nom, nom) == 0)
+            etape = &profilage.etapes[e];
     }
-    //? RÉCUPÉRATION DES PARAMÈTRES DE L'IMAGE
-    somme->hauteur = image1->hauteur;
-    somme->largeur = image1->largeur;
-    somme->max_val = image1->max_val;
-
-    /*-------------------------------------------
-    //? LIBERATION DE L'ESPACE MEMOIRE POUR CONTENIR LES DONNEES DE L'IMAGE
-    ---------------------------------------------*/
-    somme->data = malloc(somme->largeur * somme->hauteur);
-    if (!image1->data)
+    if (!etape && profilage.nb_etapes < ETAPES_PROFIL_MAX)
     {
-        free(somme);
-        perror("ne peut pas allouer la mémoire à l'image");
-        return NULL;
+        etape = &profilage.etapes[profilage.nb_etapes++];
+        *etape = (StatEtape){nom, 0, 0.0, duree, duree, {0, 0}};
     }
-    for (int i = 0; i < somme->largeur * somme->hauteur; i++)
+    if (etape)
     {
-        int n = image1->data[i] + image2->data[i];
-        if (n > somme->max_val)
+        etape->appels++;
+        etape->total_ms += duree;
+        etape->min_ms = (duree < etape->min_ms) ? duree : etape->min_ms;
+        etape->max_ms = (duree > etape->max_ms) ? duree : etape->max_ms;
+        for (int k = 0; k < NB_COMPTEURS_PROFIL; k++)
         {
-            somme->data[i] = somme->max_val;
+            etape->compteurs[k] += compteurs[k];
         }
-        else
+    }
+    if (profilage.fichier_trace)
+    {
+        if (profilage.nb_evenements == profilage.capacite_evenements && profilage.capacite_evenements < EVENEMENTS_PROFIL_MAX)
         {
-            somme->data[i] = n;
+            size_t capacite = profilage.capacite_evenements ? 2 * profilage.capacite_evenements : 1024;
+            EvenementProfil *plus_grand = realloc(profilage.evenements, capacite * sizeof(EvenementProfil));
+            if (plus_grand)
+            {
+                profilage.evenements = plus_grand;
+                profilage.capacite_evenements = capacite;
+            }
         }
+        if (profilage.nb_evenements < profilage.capacite_evenements)
+            profilage.evenements[profilage.nb_evenements++] = (EvenementProfil){nom, numero_thread_profil, mesure->debut_ms - profilage.origine_ms, duree, {compteurs[0], compteurs[1]}};
+        else
+            profilage.evenements_perdus++;
     }
-    return somme;
+    pthread_mutex_unlock(&profilage.verrou);
 }
 
-/*-------------------------------------------
-//? FONCTION DE DIFFÉRENCE DE DEUX IMAGES
----------------------------------------------*/
-ImagePGM *difference_images(ImagePGM *image1, ImagePGM *image2)
+#define PROFIL_DEBUT(mesure)                        \
+    do                                              \
+    {                                               \
+        if (__builtin_expect(profilage.actif, 0))      \
+            profil_debut_mesure(&(mesure));         \
+    } while (0)
+#define PROFIL_FIN(mesure, nom)                     \
+    do                                              \
+    {                                               \
+        if (__builtin_expect(profilage.actif, 0))      \
+            profil_fin_mesure(&(mesure), (nom));    \
+    } while (0)
+
+static void profil_ecrire_resume(void)
 {
-    if (image1->hauteur != image2->hauteur || image1->largeur != image2->largeur)
-    {
-        printf("\nles hauteurs ou les largeurs de vos deux images ne correspondent pas\n");
-        return NULL;
-    }
-    /*-------------------------------------------
-    //? LIBERATION DE L'ESPACE MEMOIRE POUR CONTENIR LES INFOS DE L'IMAGE
-    ---------------------------------------------*/
-    ImagePGM *somme = malloc(sizeof(ImagePGM));
-    if (!somme)
+    double total_ms = horloge_ms() - profilage.origine_ms;
+    fprintf(stderr, "\nprofil: %.3f ms au total\n", total_ms);
+    fprintf(stderr, "%-20s %8s %12s %10s %10s %10s %6s", "etape", "appels", "total_ms", "moyenne_ms", "min_ms", "max_ms", "%");
+    if (profilage.compteurs)
+        fprintf(stderr, " %14s %14s %5s", "cycles", "instructions", "IPC");
+    fprintf(stderr, "\n");
+    for (int e = 0; e < profilage.nb_etapes; e++)
     {
-        perror("cannot allocate memory");
-        return NULL;
+        const StatEtape *etape = &profilage.etapes[e];
+        fprintf(stderr, "%-20s %8lld %12.3f %10.3f %10.3f %10.3f %6.1f", etape->nom, etape->appels, etape->total_ms,
+                etape->total_ms / etape->appels, etape->min_ms, etape->max_ms, total_ms > 0.0 ? 100.0 * etape->total_ms / total_ms : 0.0);
+        if (profilage.compteurs)
+            fprintf(stderr, " %14lld %14lld %5.2f", etape->compteurs[0], etape->compteurs[1],
+                    etape->compteurs[0] ? (double)etape->compteurs[1] / etape->compteurs[0] : 0.0);
+        fprintf(stderr, "\n");
     }
-    //? RÉCUPÉRATION DES PARAMÈTRES DE L'IMAGE
-    somme->hauteur = image1->hauteur;
-    somme->largeur = image1->largeur;
-    somme->max_val = image1->max_val;
+    if (!profilage.compteurs)
+        fprintf(stderr, "(compteurs matériels indisponibles: perf_event_open refusé)\n");
+}
 
-    /*-------------------------------------------
-    //? LIBERATION DE L'ESPACE MEMOIRE POUR CONTENIR LES DONNEES DE L'IMAGE
-    ---------------------------------------------*/
-    somme->data = malloc(somme->largeur * somme->hauteur);
-    if (!image1->data)
+//! trace au format Chrome trace-event: un événement complet ("ph": "X") par mesure
+static void profil_ecrire_trace(void)
+{
+    FILE *fichier = fopen(profilage.fichier_trace, "w");
+    if (!fichier)
     {
-        free(somme);
-        perror("ne peut pas allouer la mémoire à l'image");
-        return NULL;
+        perror("cannot open");
+        return;
     }
-    for (int i = 0; i < somme->largeur * somme->hauteur; i++)
+    fprintf(fichier, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+    for (size_t n = 0; n < profilage.nb_evenements; n++)
     {
-        int n = image1->data[i] - image2->data[i];
-        if (n < 0)
-        {
-            somme->data[i] = 0;
-        }
-        else
-        {
-            somme->data[i] = n;
-        }
+        const EvenementProfil *e = &profilage.evenements[n];
+        fprintf(fichier, "%s\n  {\"name\": \"%s\", \"cat\": \"etape\", \"ph\": \"X\", \"pid\": %d, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f",
+                n ? "," : "", e->nom, (int)getpid(), e->thread, e->debut_ms * 1e3, e->duree_ms * 1e3);
+        if (profilage.compteurs)
+            fprintf(fichier, ", \"args\": {\"cycles\": %lld, \"instructions\": %lld}", e->compteurs[0], e->compteurs[1]);
+        fprintf(fichier, "}");
     }
-    return somme;
+    fprintf(fichier, "\n]}\n");
+    if (fclose(fichier) != 0)
+        perror("cannot write");
+    if (profilage.evenements_perdus)
+        fprintf(stderr, "profil: %zu événements au-delà de %d non tracés\n", profilage.evenements_perdus, EVENEMENTS_PROFIL_MAX);
 }
 
-/*-------------------------------------------
-//? FONCTION D'AUGMENTATION DE LA LUMINOSITÉ
----------------------------------------------*/
-ImagePGM *modifier_luminosite(ImagePGM *image, int facteur)
+static void profil_terminer(void)
 {
-    ImagePGM *intensity_image = init_image_pgm(image->hauteur, image->largeur, image->max_val);
-    for (int i = 0; i < image->largeur * image->hauteur; i++)
-    {
-        int nouvelle = image->data[i] + facteur;
-        if (nouvelle > image->max_val)
-            nouvelle = image->max_val;
-        if (nouvelle < 0)
-            nouvelle = 0;
-        intensity_image->data[i] = (unsigned char)nouvelle;
-    }
-    return intensity_image;
+    pthread_mutex_lock(&profilage.verrou);
+    profilage.actif = 0;
+    if (profilage.fichier_trace)
+        profil_ecrire_trace();
+    else
+        profil_ecrire_resume();
+    free(profilage.evenements);
+    profilage.evenements = NULL;
+    pthread_mutex_unlock(&profilage.verrou);
+}
+
+//! active le profilage; résumé ou trace écrits à la sortie du programme
+void activer_profil(const char *fichier_trace)
+{
+    if (profilage.actif)
+        return;
+    profilage.fichier_trace = fichier_trace;
+    profilage.origine_ms = horloge_ms();
+    profilage.actif = 1;
+    atexit(profil_terminer);
 }
 
 /*-------------------------------------------
-//? FONCTION D'AMÉLIORATION DU CONTRASTE
+//? POOL DE TAMPONS D'IMAGES
+//? les tampons de pixels libérés sont gardés, rangés par (largeur, hauteur, octets par pixel),
+//? et rendus à la prochaine demande de même forme: les images intermédiaires d'un pipeline,
+//? d'une transformée de Hough ou d'un lot d'images ne repassent pas par malloc.
+//? Tampons alignés sur ALIGNEMENT_TAMPONS octets (lignes SIMD), contenu non initialisé.
+//? Le pool garde au plus TAMPONS_POOL_MAX tampons et OCTETS_POOL_MAX octets, les plus
+//? anciens sont libérés en premier.
 ---------------------------------------------*/
-ImagePGM *modification_basique_du_contraste(ImagePGM *image)
+#define ALIGNEMENT_TAMPONS 64
+#define TAMPONS_POOL_MAX 8
+#define OCTETS_POOL_MAX ((size_t)512 << 20)
+
+typedef struct
 {
-    ImagePGM *contrast_image = init_image_pgm(image->hauteur, image->largeur, image->max_val);
-    //! DÉTERMINATION DU MIN ET DU MAX
-    int min = image->data[0];
-    int max = image->data[0];
-    for (int i = 0; i < image->hauteur * image->largeur; i++)
-    {
-        if (max < image->data[i])
-            max = image->data[i];
-        if (image->data[i] < min)
-            min = image->data[i];
-    }
+    int largeur;
+    int hauteur;
+    int octets; //! octets par pixel
+    unsigned char *data;
+} TamponLibre;
 
-    //! APPLICATION DE LA FONCTION DE MODIFICATION DU CONTRAST
-    for (int i = 0; i < image->hauteur * image->largeur; i++)
-    {
-        contrast_image->data[i] = (unsigned char)image->max_val * (image->data[i] - min) / (max - min);
-    }
+static struct
+{
+    TamponLibre libres[TAMPONS_POOL_MAX]; //! du plus ancien au plus récent
+    int nb;
+    size_t octets;
+    pthread_mutex_t verrou;
+} pool_tampons = {.verrou = PTHREAD_MUTEX_INITIALIZER};
 
-    return contrast_image;
+static size_t taille_tampon(int largeur, int hauteur, int octets)
+{
+    return (size_t)largeur * hauteur * octets;
 }
 
-/*-------------------------------------------
-//? HISTOGRAMME D'UNE IMAGE
----------------------------------------------*/
-int *histogramme(ImagePGM *image)
+//! retire le tampon k du pool (verrou tenu)
+static unsigned char *pool_retirer(int k)
 {
-    int *hist = malloc(image->max_val * sizeof(int));
-    //* initialisationde l'histogramme
-    for (int i = 0; i < image->max_val; i++)
-    {
-        hist[i] = 0;
-    }
-    //*remplissage de l'histogramme
-    for (int i = 0; i < image->largeur * image->hauteur; i++)
-    {
-        hist[image->data[i]] += 1;
-    }
-    return hist;
+    unsigned char *data = pool_tampons.libres[k].data;
+    pool_tampons.octets -= taille_tampon(pool_tampons.libres[k].largeur, pool_tampons.libres[k].hauteur, pool_tampons.libres[k].octets);
+    memmove(&pool_tampons.libres[k], &pool_tampons.libres[k + 1], (size_t)(pool_tampons.nb - k - 1) * sizeof(TamponLibre));
+    pool_tampons.nb--;
+    return data;
 }
 
-/*-------------------------------------------
-//? FONCTION D'APPLANISSEMENT DE L'HISTOGRAMME
----------------------------------------------*/
-ImagePGM *egaliser_histogramme(ImagePGM *image)
+//! tampon non initialisé de largeur x hauteur pixels, recyclé si possible; NULL si l'allocation échoue
+static unsigned char *obtenir_tampon(int largeur, int hauteur, int octets)
 {
-    ImagePGM *hist_equal = init_image_pgm(image->hauteur, image->largeur, image->max_val);
-    //*Etape 1 : Calcul de l'histogramme
-    int *hist = histogramme(image);
-
-    //* Etape 2 : Normalisation de l'histogramme
-    float *nouvel_histogram = malloc(image->max_val * sizeof(float));
-    for (int i = 0; i < image->max_val; i++)
+    unsigned char *data = NULL;
+    pthread_mutex_lock(&pool_tampons.verrou);
+    //? le plus récent d'abord: il a le plus de chances d'être encore en cache
+    for (int k = pool_tampons.nb - 1; k >= 0; k--)
     {
-        nouvel_histogram[i] = hist[i] / ((float)(image->largeur * image->hauteur));
+        const TamponLibre *t = &pool_tampons.libres[k];
+        if (t->largeur == largeur && t->hauteur == hauteur && t->octets == octets)
+        {
+            data = pool_retirer(k);
+            break;
+        }
     }
+    pthread_mutex_unlock(&pool_tampons.verrou);
+    if (data)
+        return data;
 
-    //*Etape 3 : Densité de probabilité normalisé
+    size_t taille = taille_tampon(largeur, hauteur, octets);
+    //? arrondi au multiple de l'alignement: un vecteur peut lire la fin de la dernière ligne
+    taille = (taille + ALIGNEMENT_TAMPONS - 1) / ALIGNEMENT_TAMPONS * ALIGNEMENT_TAMPONS;
+    if (posix_memalign((void **)&data, ALIGNEMENT_TAMPONS, taille ? taille : ALIGNEMENT_TAMPONS) != 0)
+        return NULL;
+    return data;
+}
 
-    float *densite = malloc(image->max_val * sizeof(float));
-    //* initialisation
-    for (int i = 0; i < image->max_val; i++)
+//! rend au pool un tampon obtenu par obtenir_tampon
+static void rendre_tampon(unsigned char *data, int largeur, int hauteur, int octets)
+{
+    if (!data)
+        return;
+    size_t taille = taille_tampon(largeur, hauteur, octets);
+    if (taille > OCTETS_POOL_MAX)
     {
-        densite[i] = 0.0;
+        free(data);
+        return;
     }
-    for (int i = 0; i < image->max_val; i++)
+    unsigned char *a_liberer[TAMPONS_POOL_MAX];
+    int nb_a_liberer = 0;
+    pthread_mutex_lock(&pool_tampons.verrou);
+    while (pool_tampons.nb == TAMPONS_POOL_MAX || pool_tampons.octets + taille > OCTETS_POOL_MAX)
     {
-        for (int j = 0; j <= i; j++)
-        {
-            densite[i] += nouvel_histogram[j];
-        }
+        a_liberer[nb_a_liberer++] = pool_retirer(0);
     }
-
-    //*Etape 4 : Transformation des niveaux de gris de l'image
-    for (int i = 0; i < image->hauteur * image->largeur; i++)
+    pool_tampons.libres[pool_tampons.nb++] = (TamponLibre){largeur, hauteur, octets, data};
+    pool_tampons.octets += taille;
+    pthread_mutex_unlock(&pool_tampons.verrou);
+    //? free hors du verrou
+    for (int k = 0; k < nb_a_liberer; k++)
     {
-        hist_equal->data[i] = (unsigned char)(densite[image->data[i]] * 255);
+        free(a_liberer[k]);
     }
-
-    return hist_equal;
 }
 
-/*-------------------------------------------
-//? SEULLAGE D'UNE IMAGE (transformation en image binaire)
----------------------------------------------*/
-ImagePGM *seuillage(ImagePGM *image, int seuil)
+//! libère tous les tampons gardés par le pool
+void vider_pool_tampons(void)
 {
-    if (seuil < 0 || seuil > image->max_val)
-        return NULL;
-
-    //?initialisation des images
-    ImagePGM *image_binaire = init_image_pgm(image->hauteur, image->largeur, image->max_val);
-
-    for (int n = 0; n < image->largeur * image->hauteur; n++)
+    pthread_mutex_lock(&pool_tampons.verrou);
+    while (pool_tampons.nb > 0)
     {
-        if (image->data[n] < seuil)
-        {
-            image_binaire->data[n] = 0;
-        }
-        else
-        {
-            image_binaire->data[n] = image_binaire->max_val;
-        }
+        free(pool_retirer(pool_tampons.nb - 1));
     }
-
-    return image_binaire;
+    pthread_mutex_unlock(&pool_tampons.verrou);
 }
 
 /*-------------------------------------------
-//? FONCTION DE LISSAGE(Moyenneur)
+//? POOL DE THREADS: EXÉCUTION D'UNE TÂCHE PAR BANDES DE LIGNES
+//? la tâche reçoit [debut, fin[ et lit elle-même les lignes de halo dont elle a besoin
+//? (les images d'entrée sont partagées en lecture seule entre les threads).
 ---------------------------------------------*/
-ImagePGM *filtre_moyenneur(ImagePGM *image)
-{
-    float filtre[3][3] = {{1.0 / 9, 1.0 / 9, 1.0 / 9}, {1.0 / 9, 1.0 / 9, 1.0 / 9}, {1.0 / 9, 1.0 / 9, 1.0 / 9}};
+typedef void (*TacheBande)(void *contexte, int debut, int fin);
 
-    //?initialisation des images
-    ImagePGM *image_lisse = init_image_pgm(image->hauteur, image->largeur, image->max_val);
+typedef struct
+{
+    pthread_t *threads;
+    int nb_threads;
+    int demarre;
+    int arret;
+    pthread_mutex_t verrou;
+    pthread_cond_t travail;
+    pthread_cond_t termine;
+    //? tâche en cours
+    TacheBande tache;
+    void *contexte;
+    int nb_lignes;
+    int nb_bandes;
+    int prochaine_bande;
+    int bandes_restantes;
+} PoolThreads;
 
-    for (int n = 0; n < image->largeur * image->hauteur; n++)
-    {
-        int j = get_numero_colonne(n, image->largeur);
-        int i = get_numero_ligne(n, image->largeur);
+PoolThreads pool_threads = {NULL, 0, 0, 0, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL, NULL, 0, 0, 0, 0};
 
-        if (i < image->hauteur && i + 1 < image->hauteur && i + 2 < image->hauteur && j < image->largeur && j + 1 < image->largeur && j + 2 < image->largeur)
-        {
-            int a = get_position(i, j + 1, image->largeur);
-            int b = get_position(i, j + 2, image->largeur);
-            int c = get_position(i + 1, j, image->largeur);
-            int d = get_position(i + 1, j + 1, image->largeur);
-            int e = get_position(i + 1, j + 2, image->largeur);
-            int f = get_position(i + 2, j, image->largeur);
-            int g = get_position(i + 2, j + 1, image->largeur);
-            int h = get_position(i + 2, j + 2, image->largeur);
+//! nombre de threads demandé par --threads (0: un par cœur)
+int nb_threads_demandes = 0;
 
-            image_lisse->data[n] = abs(image->data[n] * filtre[0][0] + image->data[a] * filtre[0][1] + image->data[b] * filtre[0][2] + image->data[c] * filtre[1][0] + image->data[d] * filtre[1][1] + image->data[e] * filtre[1][2] + image->data[f] * filtre[2][0] + image->data[g] * filtre[2][1] + image->data[h] * filtre[2][2]);
-        }
-    }
+#define BANDES_PAR_THREAD 4
+#define LIGNES_MIN_PAR_BANDE 16
 
-    return image_lisse;
+int nb_threads_effectifs(void)
+{
+    if (nb_threads_demandes > 0)
+        return nb_threads_demandes;
+    long coeurs = sysconf(_SC_NPROCESSORS_ONLN);
+    return (coeurs > 0) ? (int)coeurs : 1;
 }
 
-/*-------------------------------------------
-//? FONCTION DE LISSAGE(Gaussien)
----------------------------------------------*/
-ImagePGM *filtre_gaussien(ImagePGM *image)
+//! exécute les bandes disponibles; appelé verrou pris, rend la main verrou pris
+static void pool_executer_bandes(PoolThreads *pool)
 {
-    float filtre[3][3] = {{1.0 / 16, 1.0 / 8, 1.0 / 16}, {1.0 / 8, 1.0 / 4, 1.0 / 8}, {1.0 / 16, 1.0 / 8, 1.0 / 16}};
-
-    //?initialisation des images
-    ImagePGM *image_lisse = init_image_pgm(image->hauteur, image->largeur, image->max_val);
-
-    for (int n = 0; n < image->largeur * image->hauteur; n++)
+    while (pool->tache && pool->prochaine_bande < pool->nb_bandes)
     {
-        int j = get_numero_colonne(n, image->largeur);
-        int i = get_numero_ligne(n, image->largeur);
+        int bande = pool->prochaine_bande++;
+        TacheBande tache = pool->tache;
+        void *contexte = pool->contexte;
+        int debut = (int)((long long)bande * pool->nb_lignes / pool->nb_bandes);
+        int fin = (int)((long long)(bande + 1) * pool->nb_lignes / pool->nb_bandes);
 
-        if (i < image->hauteur && i + 1 < image->hauteur && i + 2 < image->hauteur && j < image->largeur && j + 1 < image->largeur && j + 2 < image->largeur)
-        {
-            int a = get_position(i, j + 1, image->largeur);
-            int b = get_position(i, j + 2, image->largeur);
-            int c = get_position(i + 1, j, image->largeur);
-            int d = get_position(i + 1, j + 1, image->largeur);
-            int e = get_position(i + 1, j + 2, image->largeur);
-            int f = get_position(i + 2, j, image->largeur);
-            int g = get_position(i + 2, j + 1, image->largeur);
-            int h = get_position(i + 2, j + 2, image->largeur);
+        pthread_mutex_unlock(&pool->verrou);
+        MesureProfil mesure;
+        PROFIL_DEBUT(mesure);
+        tache(contexte, debut, fin);
+        PROFIL_FIN(mesure, "bande");
+        pthread_mutex_lock(&pool->verrou);
 
-            image_lisse->data[n] = abs(image->data[n] * filtre[0][0] + image->data[a] * filtre[0][1] + image->data[b] * filtre[0][2] + image->data[c] * filtre[1][0] + image->data[d] * filtre[1][1] + image->data[e] * filtre[1][2] + image->data[f] * filtre[2][0] + image->data[g] * filtre[2][1] + image->data[h] * filtre[2][2]);
-        }
+        if (--pool->bandes_restantes == 0)
+            pthread_cond_broadcast(&pool->termine);
     }
-
-    return image_lisse;
 }
 
-/*-------------------------------------------
-//? FONCTION DE DETECTION DES CONTOURS(Prewitt)
----------------------------------------------*/
-ImagePGM *filtre_prewitt(ImagePGM *image)
+static void *pool_boucle_travailleur(void *argument)
 {
-    int Gx[3][3] = {{-1, 0, 1}, {-1, 0, 1}, {-1, 0, 1}};
-    int Gy[3][3] = {{-1, -1, -1}, {0, 0, 0}, {1, 1, 1}};
-
-    //?initialisation des images
-    ImagePGM *imageX = init_image_pgm(image->hauteur, image->largeur, image->max_val);
-    ImagePGM *imageY = init_image_pgm(image->hauteur, image->largeur, image->max_val);
-    for (int n = 0; n < image->largeur * image->hauteur; n++)
+    PoolThreads *pool = argument;
+    pthread_mutex_lock(&pool->verrou);
+    while (!pool->arret)
     {
-        int j = get_numero_colonne(n, image->largeur);
-        int i = get_numero_ligne(n, image->largeur);
-
-        if (i < image->hauteur && i + 1 < image->hauteur && i + 2 < image->hauteur && j < image->largeur && j + 1 < image->largeur && j + 2 < image->largeur)
-        {
-            int a = get_position(i, j + 1, image->largeur);
-            int b = get_position(i, j + 2, image->largeur);
-            int c = get_position(i + 1, j, image->largeur);
-            int d = get_position(i + 1, j + 1, image->largeur);
-            int e = get_position(i + 1, j + 2, image->largeur);
-            int f = get_position(i + 2, j, image->largeur);
-            int g = get_position(i + 2, j + 1, image->largeur);
-            int h = get_position(i + 2, j + 2, image->largeur);
-            imageX->data[n] = abs(image->data[n] * Gx[0][0] + image->data[a] * Gx[0][1] + image->data[b] * Gx[0][2] + image->data[c] * Gx[1][0] + image->data[d] * Gx[1][1] + image->data[e] * Gx[1][2] + image->data[f] * Gx[2][0] + image->data[g] * Gx[2][1] + image->data[h] * Gx[2][2]);
-            imageY->data[n] = abs(image->data[n] * Gy[0][0] + image->data[a] * Gy[0][1] + image->data[b] * Gy[0][2] + image->data[c] * Gy[1][0] + image->data[d] * Gy[1][1] + image->data[e] * Gy[1][2] + image->data[f] * Gy[2][0] + image->data[g] * Gy[2][1] + image->data[h] * Gy[2][2]);
-        }
+        if (pool->tache && pool->prochaine_bande < pool->nb_bandes)
+            pool_executer_bandes(pool);
+        else
+            pthread_cond_wait(&pool->travail, &pool->verrou);
     }
+    pthread_mutex_unlock(&pool->verrou);
+    return NULL;
+}
 
-    for (int n = 0; n < image->largeur * image->hauteur; n++)
-    {
-        if (imageX->data[n] + imageY->data[n] > imageX->max_val)
-        {
-            imageX->data[n] = imageX->max_val;
-        }
-        else
-        {
-            imageX->data[n] = imageX->data[n] + imageY->data[n];
-        }
+//! démarre les threads de travail au premier usage (l'appelant compte pour un thread)
+static void pool_demarrer(PoolThreads *pool)
+{
+    if (pool->demarre)
+        return;
+    pool->demarre = 1;
+    int nb = nb_threads_effectifs() - 1;
+    if (nb <= 0)
+        return;
+    pool->threads = malloc(nb * sizeof(pthread_t));
+    if (!pool->threads)
+        return;
+    for (int t = 0; t < nb; t++)
+    {
+        if (pthread_create(&pool->threads[t], NULL, pool_boucle_travailleur, pool) != 0)
+            break;
+        pool->nb_threads++;
     }
-
-    return imageX;
 }
 
 /*-------------------------------------------
-//? FONCTION DE DETECTION DES CONTOURS(Sobel)
+//? RÉPARTITION DE [0, nb_lignes[ EN BANDES SUR LE POOL
+//? si le pool est déjà occupé (appel imbriqué ou concurrent) la tâche s'exécute sur l'appelant
 ---------------------------------------------*/
-ImagePGM *filtre_sobel(ImagePGM *image)
+//! bandes d'au moins lignes_min lignes
+static void executer_reparti(int nb_lignes, int lignes_min, TacheBande tache, void *contexte)
 {
-    int Gx[3][3] = {{-1, 0, 1}, {-2, 0, 2}, {-1, 0, 1}};
-    int Gy[3][3] = {{-1, -2, -1}, {0, 0, 0}, {1, 2, 1}};
+    if (nb_lignes <= 0)
+        return;
 
-    //?initialisation des images
-    ImagePGM *imageX = init_image_pgm(image->hauteur, image->largeur, image->max_val);
-    ImagePGM *imageY = init_image_pgm(image->hauteur, image->largeur, image->max_val);
-    for (int n = 0; n < image->largeur * image->hauteur; n++)
-    {
-        int j = get_numero_colonne(n, image->largeur);
-        int i = get_numero_ligne(n, image->largeur);
+    PoolThreads *pool = &pool_threads;
+    pthread_mutex_lock(&pool->verrou);
+    pool_demarrer(pool);
 
-        if (i < image->hauteur && i + 1 < image->hauteur && i + 2 < image->hauteur && j < image->largeur && j + 1 < image->largeur && j + 2 < image->largeur)
-        {
-            int a = get_position(i, j + 1, image->largeur);
-            int b = get_position(i, j + 2, image->largeur);
-            int c = get_position(i + 1, j, image->largeur);
-            int d = get_position(i + 1, j + 1, image->largeur);
-            int e = get_position(i + 1, j + 2, image->largeur);
-            int f = get_position(i + 2, j, image->largeur);
-            int g = get_position(i + 2, j + 1, image->largeur);
-            int h = get_position(i + 2, j + 2, image->largeur);
-            imageX->data[n] = abs(image->data[n] * Gx[0][0] + image->data[a] * Gx[0][1] + image->data[b] * Gx[0][2] + image->data[c] * Gx[1][0] + image->data[d] * Gx[1][1] + image->data[e] * Gx[1][2] + image->data[f] * Gx[2][0] + image->data[g] * Gx[2][1] + image->data[h] * Gx[2][2]);
-            imageY->data[n] = abs(image->data[n] * Gy[0][0] + image->data[a] * Gy[0][1] + image->data[b] * Gy[0][2] + image->data[c] * Gy[1][0] + image->data[d] * Gy[1][1] + image->data[e] * Gy[1][2] + image->data[f] * Gy[2][0] + image->data[g] * Gy[2][1] + image->data[h] * Gy[2][2]);
-        }
-    }
+    int nb_bandes = (pool->nb_threads + 1) * BANDES_PAR_THREAD;
+    if (nb_bandes > nb_lignes / lignes_min)
+        nb_bandes = nb_lignes / lignes_min;
 
-    for (int n = 0; n < image->largeur * image->hauteur; n++)
+    if (pool->nb_threads == 0 || pool->tache || nb_bandes <= 1)
     {
-        if (imageX->data[n] + imageY->data[n] > imageX->max_val)
-        {
-            imageX->data[n] = imageX->max_val;
-        }
-        else
-        {
-            imageX->data[n] = imageX->data[n] + imageY->data[n];
-        }
+        pthread_mutex_unlock(&pool->verrou);
+        MesureProfil mesure;
+        PROFIL_DEBUT(mesure);
+        tache(contexte, 0, nb_lignes);
+        PROFIL_FIN(mesure, "bande");
+        return;
     }
 
-    return imageX;
+    pool->tache = tache;
+    pool->contexte = contexte;
+    pool->nb_lignes = nb_lignes;
+    pool->nb_bandes = nb_bandes;
+    pool->prochaine_bande = 0;
+    pool->bandes_restantes = nb_bandes;
+    pthread_cond_broadcast(&pool->travail);
+
+    //? l'appelant travaille aussi, puis attend les bandes encore en cours
+    pool_executer_bandes(pool);
+    while (pool->bandes_restantes > 0)
+        pthread_cond_wait(&pool->termine, &pool->verrou);
+
+    pool->tache = NULL;
+    pool->contexte = NULL;
+    pthread_mutex_unlock(&pool->verrou);
 }
 
-/*-------------------------------------------
-//? FONCTION DE DETECTION DES CONTOURS(Robert)
----------------------------------------------*/
-ImagePGM *filtre_robert(ImagePGM *image)
+void executer_par_bandes(int nb_lignes, TacheBande tache, void *contexte)
 {
-    int Gx[2][2] = {{0, 1}, {-1, 0}};
-    int Gy[2][2] = {{1, 0}, {0, -1}};
+    executer_reparti(nb_lignes, LIGNES_MIN_PAR_BANDE, tache, contexte);
+}
 
-    //?initialisation des images
-    ImagePGM *imageX = init_image_pgm(image->hauteur, image->largeur, image->max_val);
-    ImagePGM *imageY = init_image_pgm(image->hauteur, image->largeur, image->max_val);
-    for (int n = 0; n < image->largeur * image->hauteur; n++)
+//! nb_taches tâches indépendantes et coûteuses (tuiles, blocs): réparties sans minimum de lignes
+void executer_par_taches(int nb_taches, TacheBande tache, void *contexte)
+{
+    executer_reparti(nb_taches, 1, tache, contexte);
+}
+
+//! arrêt et attente des threads de travail
+void arreter_pool_threads(void)
+{
+    PoolThreads *pool = &pool_threads;
+    pthread_mutex_lock(&pool->verrou);
+    pool->arret = 1;
+    pthread_cond_broadcast(&pool->travail);
+    pthread_mutex_unlock(&pool->verrou);
+    for (int t = 0; t < pool->nb_threads; t++)
     {
-        int j = get_numero_colonne(n, image->largeur);
-        int i = get_numero_ligne(n, image->largeur);
-        if (i < image->hauteur && i + 1 < image->hauteur && j < image->largeur && j + 1 < image->largeur)
-        {
-            int a = get_position(i, j + 1, image->largeur);
-            int b = get_position(i + 1, j, image->largeur);
-            int c = get_position(i + 1, j + 1, image->largeur);
-            imageX->data[n] = abs(image->data[n] * Gx[0][0] + image->data[a] * Gx[0][1] + image->data[b] * Gx[1][0] + image->data[c] * Gx[1][1]);
-            imageY->data[n] = abs(image->data[n] * Gy[0][0] + image->data[a] * Gy[0][1] + image->data[b] * Gy[1][0] + image->data[c] * Gy[1][1]);
-        }
+        pthread_join(pool->threads[t], NULL);
     }
+    free(pool->threads);
+    pool->threads = NULL;
+    pool->nb_threads = 0;
+    //? le prochain executer_par_bandes redémarre le pool (usage en bibliothèque)
+    pool->demarre = 0;
+    pool->arret = 0;
+}
 
-    for (int n = 0; n < image->largeur * image->hauteur; n++)
+/*-------------------------------------------
+//? ANALYSE DE L'ENTÊTE D'UN FICHIER PGM BINAIRE (P5)
+//? les champs qui suivent le nombre magique sont communs à tous les formats (P2, PZ)
+//? commentaires '#' jusqu'à la fin de ligne et blancs quelconques entre les champs,
+//? un seul blanc entre la valeur maximale et les pixels.
+//? retourne la position du premier pixel, ou 0 si l'entête est invalide
+//? (la présence de tous les pixels est vérifiée par l'appelant)
+---------------------------------------------*/
+static int pgm_lire_entier(const unsigned char *octets, size_t taille, size_t *position, int *valeur)
+{
+    size_t p = *position;
+    //? blancs et commentaires
+    while (p < taille)
     {
-        if (imageX->data[n] + imageY->data[n] > imageX->max_val)
+        if (octets[p] == '#')
+        {
+            while (p < taille && octets[p] != '\n' && octets[p] != '\r')
+                p++;
+        }
+        else if (octets[p] == ' ' || octets[p] == '\t' || octets[p] == '\n' || octets[p] == '\r' || octets[p] == '\v' || octets[p] == '\f')
         {
-            imageX->data[n] = imageX->max_val;
+            p++;
         }
         else
         {
-            imageX->data[n] = imageX->data[n] + imageY->data[n];
+            break;
         }
     }
+    if (p >= taille || octets[p] < '0' || octets[p] > '9')
+        return -1;
 
-    return imageX;
+    long n = 0;
+    while (p < taille && octets[p] >= '0' && octets[p] <= '9')
+    {
+        n = n * 10 + (octets[p] - '0');
+        if (n > 0x7fffffff)
+            return -1;
+        p++;
+    }
+    *valeur = (int)n;
+    *position = p;
+    return 0;
 }
 
-/*-------------------------------------------
-//? FONCTION DE DETECTION DES CONTOURS(Usage de l'approximation discret du LAPLACIEN)
----------------------------------------------*/
-ImagePGM *filtre_laplacien(ImagePGM *image)
+//! largeur, hauteur et valeur maximale après les deux octets du nombre magique
+static size_t pgm_analyser_champs(const unsigned char *octets, size_t taille, int *largeur, int *hauteur, int *max_val)
 {
-    float laplacien[3][3] = {{1, 1, 1}, {1, -8, 1}, {1, 1, 1}};
-    float laplacien2[3][3] = {{0, 1, 0}, {1, -4, 1}, {0, 1, 0}};
-
-    //?initialisation des images
-    ImagePGM *image_lisse = init_image_pgm(image->hauteur, image->largeur, image->max_val);
-
-    for (int n = 0; n < image->largeur * image->hauteur; n++)
+    size_t position = 2;
+    if (pgm_lire_entier(octets, taille, &position, largeur) != 0 ||
+        pgm_lire_entier(octets, taille, &position, hauteur) != 0 ||
+        pgm_lire_entier(octets, taille, &position, max_val) != 0 ||
+        position >= taille)
     {
-        int j = get_numero_colonne(n, image->largeur);
-        int i = get_numero_ligne(n, image->largeur);
-
-        if (i < image->hauteur && i + 1 < image->hauteur && i + 2 < image->hauteur && j < image->largeur && j + 1 < image->largeur && j + 2 < image->largeur)
-        {
-            int a = get_position(i, j + 1, image->largeur);
-            int b = get_position(i, j + 2, image->largeur);
-            int c = get_position(i + 1, j, image->largeur);
-            int d = get_position(i + 1, j + 1, image->largeur);
-            int e = get_position(i + 1, j + 2, image->largeur);
-            int f = get_position(i + 2, j, image->largeur);
-            int g = get_position(i + 2, j + 1, image->largeur);
-            int h = get_position(i + 2, j + 2, image->largeur);
-            int valeur = abs(image->data[n] * laplacien[0][0] + image->data[a] * laplacien[0][1] +
-                             image->data[b] * laplacien[0][2] + image->data[c] * laplacien[1][0] +
-                             image->data[d] * laplacien[1][1] + image->data[e] * laplacien[1][2] +
-                             image->data[f] * laplacien[2][0] + image->data[g] * laplacien[2][1] +
-                             image->data[h] * laplacien[2][2]);
-
-            image_lisse->data[n] = valeur;
-        }
+        fprintf(stderr, "Entête PGM invalide\n");
+        return 0;
     }
-
-    return image_lisse;
+    if (*largeur <= 0 || *hauteur <= 0 || *max_val <= 0 || *max_val > 65535)
+    {
+        fprintf(stderr, "Entête PGM non pris en charge: %d x %d, max %d\n", *largeur, *hauteur, *max_val);
+        return 0;
+    }
+    //?LECTURE DU BLANC UNIQUE QUI PRÉCÈDE LES PIXELS
+    return position + 1;
 }
 
+size_t analyser_entete_pgm(const unsigned char *octets, size_t taille, int *largeur, int *hauteur, int *max_val)
+{
+    if (taille < 2 || octets[0] != 'P' || octets[1] != '5')
+    {
+        fprintf(stderr, "Format non pris en charge: %.2s\n", taille >= 2 ? (const char *)octets : "");
+        return 0;
+    }
+    return pgm_analyser_champs(octets, taille, largeur, hauteur, max_val);
+}
 
+//! pixels d'un fichier tronqué: copie des pixels présents, les manquants sont mis à 0
+static unsigned char *pgm_copier_pixels_tronques(const unsigned char *pixels, size_t disponibles, const ImagePGM *image)
+{
+    size_t nb_pixels = (size_t)image->largeur * image->hauteur;
+    fprintf(stderr, "Fichier PGM tronqué: %zu pixels manquants mis à 0\n", nb_pixels - disponibles);
+    unsigned char *data = obtenir_tampon(image->largeur, image->hauteur, 1);
+    if (!data)
+    {
+        perror("ne peut pas allouer la mémoire à l'image");
+        return NULL;
+    }
+    memcpy(data, pixels, disponibles);
+    memset(data + disponibles, 0, nb_pixels - disponibles);
+    return data;
+}
 
-/*-------------------------------------------
-//? FONCTION DE DETECTION DES CONTOURS AVEC SEUIL(Prewitt)
----------------------------------------------*/
-ImagePGM *filtre_prewitt_seuil(ImagePGM *image, int seuil)
+typedef struct
 {
-    int Gx[3][3] = {{-1, 0, 1}, {-1, 0, 1}, {-1, 0, 1}};
-    int Gy[3][3] = {{-1, -1, -1}, {0, 0, 0}, {1, 1, 1}};
+    const unsigned char *octets;
+    unsigned short *data;
+    size_t presents;
+    int largeur;
+} Decodage16Bits;
 
-    //?initialisation des images
-    ImagePGM *imageX = init_image_pgm(image->hauteur, image->largeur, image->max_val);
-    ImagePGM *imageY = init_image_pgm(image->hauteur, image->largeur, image->max_val);
-    for (int n = 0; n < image->largeur * image->hauteur; n++)
+static void pgm_decoder_lignes_16_bits(void *contexte, int debut, int fin)
+{
+    Decodage16Bits *decodage = contexte;
+    size_t k = (size_t)debut * decodage->largeur;
+    size_t limite = (size_t)fin * decodage->largeur;
+    if (limite > decodage->presents)
+        limite = decodage->presents;
+    for (; k < limite; k++)
     {
-        int j = get_numero_colonne(n, image->largeur);
-        int i = get_numero_ligne(n, image->largeur);
-
-        if (i < image->hauteur && i + 1 < image->hauteur && i + 2 < image->hauteur && j < image->largeur && j + 1 < image->largeur && j + 2 < image->largeur)
-        {
-            int a = get_position(i, j + 1, image->largeur);
-            int b = get_position(i, j + 2, image->largeur);
-            int c = get_position(i + 1, j, image->largeur);
-            int d = get_position(i + 1, j + 1, image->largeur);
-            int e = get_position(i + 1, j + 2, image->largeur);
-            int f = get_position(i + 2, j, image->largeur);
-            int g = get_position(i + 2, j + 1, image->largeur);
-            int h = get_position(i + 2, j + 2, image->largeur);
-            imageX->data[n] = abs(image->data[n] * Gx[0][0] + image->data[a] * Gx[0][1] + image->data[b] * Gx[0][2] + image->data[c] * Gx[1][0] + image->data[d] * Gx[1][1] + image->data[e] * Gx[1][2] + image->data[f] * Gx[2][0] + image->data[g] * Gx[2][1] + image->data[h] * Gx[2][2]);
-            imageY->data[n] = abs(image->data[n] * Gy[0][0] + image->data[a] * Gy[0][1] + image->data[b] * Gy[0][2] + image->data[c] * Gy[1][0] + image->data[d] * Gy[1][1] + image->data[e] * Gy[1][2] + image->data[f] * Gy[2][0] + image->data[g] * Gy[2][1] + image->data[h] * Gy[2][2]);
-        }
+        decodage->data[k] = (unsigned short)(decodage->octets[2 * k] << 8 | decodage->octets[2 * k + 1]);
     }
+}
 
-    for (int n = 0; n < image->largeur * image->hauteur; n++)
+//! pixels de 16 bits big-endian du fichier vers l'ordre natif, par bandes sur le pool; les manquants sont mis à 0
+static unsigned char *pgm_decoder_16_bits(const unsigned char *octets, size_t disponibles, const ImagePGM *image)
+{
+    size_t nb_pixels = (size_t)image->largeur * image->hauteur;
+    size_t presents = disponibles / 2;
+    if (presents < nb_pixels)
+        fprintf(stderr, "Fichier PGM tronqué: %zu pixels manquants mis à 0\n", nb_pixels - presents);
+    else
+        presents = nb_pixels;
+    unsigned short *data = (unsigned short *)obtenir_tampon(image->largeur, image->hauteur, 2);
+    if (!data)
     {
-        if (imageX->data[n] + imageY->data[n] > seuil)
-        {
-            imageX->data[n] = imageX->max_val;
-        }
-        else
-        {
-            imageX->data[n] = 0;
-            // imageX->data[n] = imageX->data[n] + imageY->data[n];
-        }
+        perror("ne peut pas allouer la mémoire à l'image");
+        return NULL;
     }
-
-    return imageX;
+    Decodage16Bits decodage = {octets, data, presents, image->largeur};
+    executer_par_bandes(image->hauteur, pgm_decoder_lignes_16_bits, &decodage);
+    memset(data + presents, 0, (nb_pixels - presents) * sizeof(unsigned short));
+    return (unsigned char *)data;
 }
 
 /*-------------------------------------------
-//? FONCTION DE DETECTION DES CONTOURS AVEC SEUIL(Sobel)
+//? SORTIE DES IMAGES
+//? un fichier est écrit dans <chemin>.tmp.<pid>.<n> puis renommé: un lecteur ne voit jamais
+//? d'image partielle et un échec laisse l'ancienne version en place. Les octets passent par
+//? des tampons alignés de TAMPON_SORTIE; en mode asynchrone un thread vide l'un pendant que
+//? l'appelant remplit l'autre. La taille du fichier est vérifiée avant le renommage.
+//? Pas de fsync: le renommage est atomique pour les lecteurs, pas durable après une panne.
+//? --direct: O_DIRECT (sans passer par le cache de pages) si le système de fichiers l'accepte.
+//? Une cible qui n'est pas un fichier régulier (/dev/null, tube) est écrite directement.
 ---------------------------------------------*/
-ImagePGM *filtre_sobel_seuil(ImagePGM *image, int seuil)
+#define TAMPON_SORTIE (1 << 20)
+#define BLOC_DIRECT 4096
+
+static int sortie_directe = 0; //! --direct
+static unsigned int compteur_temporaires = 0;
+
+typedef struct
 {
-    int Gx[3][3] = {{-1, 0, 1}, {-2, 0, 2}, {-1, 0, 1}};
-    int Gy[3][3] = {{-1, -2, -1}, {0, 0, 0}, {1, 2, 1}};
+    const char *chemin;
+    char *temporaire; //! NULL: écriture directe dans chemin
+    int fd;
+    int direct;       //! O_DIRECT actif sur fd
+    unsigned char *tampons[2];
+    int courant;
+    size_t rempli;    //! octets dans tampons[courant]
+    off_t ecrits;     //! octets confiés au noyau ou au thread de vidage
+    int erreur;       //! premier errno rencontré
 
-    //?initialisation des images
-    ImagePGM *imageX = init_image_pgm(image->hauteur, image->largeur, image->max_val);
-    ImagePGM *imageY = init_image_pgm(image->hauteur, image->largeur, image->max_val);
-    for (int n = 0; n < image->largeur * image->hauteur; n++)
-    {
-        int j = get_numero_colonne(n, image->largeur);
-        int i = get_numero_ligne(n, image->largeur);
+    //? vidage asynchrone (erreur et a_vider sont alors protégés par verrou)
+    int asynchrone;
+    pthread_t thread;
+    pthread_mutex_t verrou;
+    pthread_cond_t signal;
+    const unsigned char *a_vider;
+    size_t taille_a_vider;
+    int arret;
+} SortiePGM;
 
-        if (i < image->hauteur && i + 1 < image->hauteur && i + 2 < image->hauteur && j < image->largeur && j + 1 < image->largeur && j + 2 < image->largeur)
+//! écrit n octets malgré les écritures partielles et les interruptions; -1 avec errno sinon
+static int ecrire_tout(int fd, const void *source, size_t n)
+{
+    const unsigned char *octets = source;
+    while (n > 0)
+    {
+        ssize_t nb = write(fd, octets, n);
+        if (nb < 0 && errno == EINTR)
+            continue;
+        if (nb <= 0)
         {
-            int a = get_position(i, j + 1, image->largeur);
-            int b = get_position(i, j + 2, image->largeur);
-            int c = get_position(i + 1, j, image->largeur);
-            int d = get_position(i + 1, j + 1, image->largeur);
-            int e = get_position(i + 1, j + 2, image->largeur);
-            int f = get_position(i + 2, j, image->largeur);
-            int g = get_position(i + 2, j + 1, image->largeur);
-            int h = get_position(i + 2, j + 2, image->largeur);
-            imageX->data[n] = abs(image->data[n] * Gx[0][0] + image->data[a] * Gx[0][1] + image->data[b] * Gx[0][2] + image->data[c] * Gx[1][0] + image->data[d] * Gx[1][1] + image->data[e] * Gx[1][2] + image->data[f] * Gx[2][0] + image->data[g] * Gx[2][1] + image->data[h] * Gx[2][2]);
-            imageY->data[n] = abs(image->data[n] * Gy[0][0] + image->data[a] * Gy[0][1] + image->data[b] * Gy[0][2] + image->data[c] * Gy[1][0] + image->data[d] * Gy[1][1] + image->data[e] * Gy[1][2] + image->data[f] * Gy[2][0] + image->data[g] * Gy[2][1] + image->data[h] * Gy[2][2]);
+            if (nb == 0)
+                errno = ENOSPC;
+            return -1;
         }
+        octets += nb;
+        n -= (size_t)nb;
     }
+    return 0;
+}
 
-    for (int n = 0; n < image->largeur * image->hauteur; n++)
+static void *sortie_vidage(void *argument)
+{
+    SortiePGM *sortie = argument;
+    pthread_mutex_lock(&sortie->verrou);
+    for (;;)
     {
-        if (imageX->data[n] + imageY->data[n] > seuil)
-        {
-            imageX->data[n] = imageX->max_val;
-        }
-        else
-        {
-            // imageX->data[n] = imageX->data[n] + imageY->data[n];
-            imageX->data[n] = 0;
-        }
+        while (!sortie->a_vider && !sortie->arret)
+            pthread_cond_wait(&sortie->signal, &sortie->verrou);
+        if (!sortie->a_vider)
+            break;
+        const unsigned char *bloc = sortie->a_vider;
+        size_t taille = sortie->taille_a_vider;
+        pthread_mutex_unlock(&sortie->verrou);
+        int code = ecrire_tout(sortie->fd, bloc, taille);
+        int erreur = errno;
+        pthread_mutex_lock(&sortie->verrou);
+        if (code != 0 && !sortie->erreur)
+            sortie->erreur = erreur;
+        sortie->a_vider = NULL;
+        pthread_cond_broadcast(&sortie->signal);
     }
+    pthread_mutex_unlock(&sortie->verrou);
+    return NULL;
+}
 
-    return imageX;
+//! attend la fin du vidage en cours; retourne la première erreur
+static int sortie_attendre(SortiePGM *sortie)
+{
+    if (!sortie->asynchrone)
+        return sortie->erreur;
+    pthread_mutex_lock(&sortie->verrou);
+    while (sortie->a_vider)
+        pthread_cond_wait(&sortie->signal, &sortie->verrou);
+    int erreur = sortie->erreur;
+    pthread_mutex_unlock(&sortie->verrou);
+    return erreur;
 }
 
-/*-------------------------------------------
-//? FONCTION DE DETECTION DES CONTOURS AVEC SEUIL(Robert)
----------------------------------------------*/
-ImagePGM *filtre_robert_seuil(ImagePGM *image, int seuil)
+//! arrête le thread de vidage, ferme fd et libère les tampons
+static void sortie_terminer(SortiePGM *sortie)
 {
-    int Gx[2][2] = {{0, 1}, {-1, 0}};
-    int Gy[2][2] = {{1, 0}, {0, -1}};
+    if (sortie->asynchrone)
+    {
+        pthread_mutex_lock(&sortie->verrou);
+        sortie->arret = 1;
+        pthread_cond_broadcast(&sortie->signal);
+        pthread_mutex_unlock(&sortie->verrou);
+        pthread_join(sortie->thread, NULL);
+        pthread_mutex_destroy(&sortie->verrou);
+        pthread_cond_destroy(&sortie->signal);
+        sortie->asynchrone = 0;
+    }
+    if (sortie->fd >= 0 && close(sortie->fd) != 0 && !sortie->erreur)
+        sortie->erreur = errno;
+    sortie->fd = -1;
+    free(sortie->tampons[0]);
+    free(sortie->tampons[1]);
+    sortie->tampons[0] = sortie->tampons[1] = NULL;
+}
 
-    //?initialisation des images
-    ImagePGM *imageX = init_image_pgm(image->hauteur, image->largeur, image->max_val);
-    ImagePGM *imageY = init_image_pgm(image->hauteur, image->largeur, image->max_val);
-    for (int n = 0; n < image->largeur * image->hauteur; n++)
+//! ouvre la sortie; asynchrone: les tampons pleins sont écrits par un thread dédié
+static int sortie_ouvrir(SortiePGM *sortie, const char *chemin, int asynchrone)
+{
+    memset(sortie, 0, sizeof(SortiePGM));
+    sortie->chemin = chemin;
+    struct stat etat;
+    int existe = stat(chemin, &etat) == 0;
+    if (existe && !S_ISREG(etat.st_mode))
+    {
+        sortie->fd = open(chemin, O_WRONLY);
+    }
+    else
     {
-        int j = get_numero_colonne(n, image->largeur);
-        int i = get_numero_ligne(n, image->largeur);
-        if (i < image->hauteur && i + 1 < image->hauteur && j < image->largeur && j + 1 < image->largeur)
+        size_t taille = strlen(chemin) + 48;
+        sortie->temporaire = malloc(taille);
+        if (!sortie->temporaire)
+        {
+            perror("cannot allocate memory");
+            return -1;
+        }
+        snprintf(sortie->temporaire, taille, "%s.tmp.%ld.%u", chemin, (long)getpid(),
+                 __atomic_fetch_add(&compteur_temporaires, 1, __ATOMIC_RELAXED));
+        int options = O_WRONLY | O_CREAT | O_EXCL;
+#ifdef O_DIRECT
+        if (sortie_directe)
         {
-            int a = get_position(i, j + 1, image->largeur);
-            int b = get_position(i + 1, j, image->largeur);
-            int c = get_position(i + 1, j + 1, image->largeur);
-            imageX->data[n] = abs(image->data[n] * Gx[0][0] + image->data[a] * Gx[0][1] + image->data[b] * Gx[1][0] + image->data[c] * Gx[1][1]);
-            imageY->data[n] = abs(image->data[n] * Gy[0][0] + image->data[a] * Gy[0][1] + image->data[b] * Gy[1][0] + image->data[c] * Gy[1][1]);
+            sortie->fd = open(sortie->temporaire, options | O_DIRECT, 0666);
+            sortie->direct = sortie->fd >= 0;
+            if (sortie->fd < 0 && errno == EINVAL) //! refusé par le système de fichiers (tmpfs, ...)
+                sortie->fd = open(sortie->temporaire, options, 0666);
         }
+        else
+#endif
+            sortie->fd = open(sortie->temporaire, options, 0666);
+        if (sortie->fd >= 0 && existe)
+            fchmod(sortie->fd, etat.st_mode & 07777); //! le renommage garde les droits de l'ancienne version
+    }
+    if (sortie->fd < 0)
+    {
+        fprintf(stderr, "cannot open %s: %s\n", chemin, strerror(errno));
+        free(sortie->temporaire);
+        return -1;
     }
 
-    for (int n = 0; n < image->largeur * image->hauteur; n++)
+    int nb_tampons = asynchrone ? 2 : 1;
+    for (int k = 0; k < nb_tampons; k++)
     {
-        if (imageX->data[n] + imageY->data[n] > seuil)
+        void *tampon = NULL;
+        if (posix_memalign(&tampon, BLOC_DIRECT, TAMPON_SORTIE) != 0)
         {
-            imageX->data[n] = imageX->max_val;
+            perror("cannot allocate memory");
+            sortie_terminer(sortie);
+            if (sortie->temporaire)
+                unlink(sortie->temporaire);
+            free(sortie->temporaire);
+            return -1;
         }
-        else
+        sortie->tampons[k] = tampon;
+    }
+    if (asynchrone)
+    {
+        pthread_mutex_init(&sortie->verrou, NULL);
+        pthread_cond_init(&sortie->signal, NULL);
+        sortie->asynchrone = pthread_create(&sortie->thread, NULL, sortie_vidage, sortie) == 0;
+        if (!sortie->asynchrone)
         {
-            imageX->data[n] = 0;
-            // imageX->data[n] = imageX->data[n] + imageY->data[n];
+            pthread_mutex_destroy(&sortie->verrou);
+            pthread_cond_destroy(&sortie->signal);
         }
     }
-
-    return imageX;
+    return 0;
 }
 
-/*-------------------------------------------
-//? FONCTION DE DETECTION DES CONTOURS AVEC SEUIL(Usage de l'approximation discret du LAPLACIEN)
----------------------------------------------*/
-ImagePGM *filtre_laplacien_seuil(ImagePGM *image, int seuil)
+//! confie le tampon courant au noyau (ou au thread de vidage, qui libère alors l'autre tampon)
+static int sortie_vider(SortiePGM *sortie)
 {
-    float laplacien[3][3] = {{1, 1, 1}, {1, -8, 1}, {1, 1, 1}};
-    float laplacien2[3][3] = {{0, 1, 0}, {1, -4, 1}, {0, 1, 0}};
-
-    //?initialisation des images
-    ImagePGM *image_lisse = init_image_pgm(image->hauteur, image->largeur, image->max_val);
-
-    for (int n = 0; n < image->largeur * image->hauteur; n++)
+    if (sortie->rempli == 0)
+        return sortie_attendre(sortie) ? -1 : 0;
+    int erreur;
+    if (sortie->asynchrone)
+    {
+        pthread_mutex_lock(&sortie->verrou);
+        while (sortie->a_vider)
+            pthread_cond_wait(&sortie->signal, &sortie->verrou);
+        sortie->a_vider = sortie->tampons[sortie->courant];
+        sortie->taille_a_vider = sortie->rempli;
+        pthread_cond_broadcast(&sortie->signal);
+        erreur = sortie->erreur;
+        pthread_mutex_unlock(&sortie->verrou);
+        sortie->courant ^= 1;
+    }
+    else
     {
-        int j = get_numero_colonne(n, image->largeur);
-        int i = get_numero_ligne(n, image->largeur);
+        if (ecrire_tout(sortie->fd, sortie->tampons[0], sortie->rempli) != 0 && !sortie->erreur)
+            sortie->erreur = errno;
+        erreur = sortie->erreur;
+    }
+    sortie->ecrits += sortie->rempli;
+    sortie->rempli = 0;
+    return erreur ? -1 : 0;
+}
 
-        if (i < image->hauteur && i + 1 < image->hauteur && i + 2 < image->hauteur && j < image->largeur && j + 1 < image->largeur && j + 2 < image->largeur)
+static int sortie_ecrire(SortiePGM *sortie, const void *source, size_t n)
+{
+    const unsigned char *octets = source;
+    if (!sortie->asynchrone && !sortie->direct && n >= TAMPON_SORTIE)
+    {
+        //? gros bloc en synchrone: écrit depuis la mémoire de l'appelant, sans copie
+        if (sortie_vider(sortie) != 0)
+            return -1;
+        if (ecrire_tout(sortie->fd, octets, n) != 0)
         {
-            int a = get_position(i, j + 1, image->largeur);
-            int b = get_position(i, j + 2, image->largeur);
-            int c = get_position(i + 1, j, image->largeur);
-            int d = get_position(i + 1, j + 1, image->largeur);
-            int e = get_position(i + 1, j + 2, image->largeur);
-            int f = get_position(i + 2, j, image->largeur);
-            int g = get_position(i + 2, j + 1, image->largeur);
-            int h = get_position(i + 2, j + 2, image->largeur);
-            int valeur = abs(image->data[n] * laplacien[0][0] + image->data[a] * laplacien[0][1] +
-                             image->data[b] * laplacien[0][2] + image->data[c] * laplacien[1][0] +
-                             image->data[d] * laplacien[1][1] + image->data[e] * laplacien[1][2] +
-                             image->data[f] * laplacien[2][0] + image->data[g] * laplacien[2][1] +
-                             image->data[h] * laplacien[2][2]);
-
-            image_lisse->data[n] = (valeur >= seuil) ? image->max_val : 0;
+            sortie->erreur = errno;
+            return -1;
         }
+        sortie->ecrits += n;
+        return 0;
     }
-
-    return image_lisse;
+    while (n > 0)
+    {
+        size_t nb = TAMPON_SORTIE - sortie->rempli;
+        if (nb > n)
+            nb = n;
+        memcpy(sortie->tampons[sortie->courant] + sortie->rempli, octets, nb);
+        sortie->rempli += nb;
+        octets += nb;
+        n -= nb;
+        if (sortie->rempli == TAMPON_SORTIE && sortie_vider(sortie) != 0)
+            return -1;
+    }
+    return 0;
 }
 
-/*-------------------------------------------
-//? FONCTION D'IMPLÉMENTATION DE LA MÉTHODE DE HOUGH
----------------------------------------------*/
-ImagePGM *hough_transform(ImagePGM *image1,int seuil)
+//! magique: "P5", "P2", "PZ"
+static int sortie_entete_pgm(SortiePGM *sortie, const char *magique, int largeur, int hauteur, int max_val)
 {
-    ImagePGM *image = filtre_robert_seuil(image1,seuil);
-
-
-    int diag = sqrt((image->hauteur * image->hauteur) + (image->largeur * image->largeur));
-    int indLig,X;
-    ImagePGM *imageVote = init_image_pgm(diag, 181, 255);
+    char entete[64];
+    int n = snprintf(entete, sizeof(entete), "%s\n%d %d\n%d\n", magique, largeur, hauteur, max_val);
+    return sortie_ecrire(sortie, entete, (size_t)n);
+}
 
-    // Application de Hough pour construction de l'image de vote
-    for (int i = 0; i < image->hauteur; i++)
+//! n pixels de 16 bits de l'ordre natif vers le big-endian du fichier
+static void pgm_encoder_16_bits(const unsigned short *pixels, unsigned char *octets, size_t n)
+{
+    for (size_t k = 0; k < n; k++)
     {
-        for (int j = 0; j < image->largeur; j++)
-        {
-            int pixel_value = image->data[get_position(i, j, image->largeur)];
-            if (pixel_value >= 240)
-            {
-                for (int theta = 0; theta < 181; theta++)
-                {
-                    indLig = i * cos(theta * C_PI / 180) + j * sin(theta * C_PI / 180);
-                    if (indLig >= 0 && indLig < diag)
-                    {
-                        imageVote->data[get_position(indLig, theta, 181)]++;
-                    }
-                }
-            }
-        }
+        octets[2 * k] = pixels[k] >> 8;
+        octets[2 * k + 1] = pixels[k] & 0xff;
     }
+}
 
-    // Initialisation de l'image contenant la droite contour
-    ImagePGM *imageDroite = init_image_pgm(image->hauteur, image->largeur, image->max_val);
-
-    // Construction de l'image droite
-    for (int rho = 0; rho < diag; rho++)
+//! écrit n pixels (8 ou 16 bits); les pixels de 16 bits sont encodés directement dans le tampon
+static int sortie_pixels(SortiePGM *sortie, const unsigned char *data, size_t n, int seize)
+{
+    if (!seize)
+        return sortie_ecrire(sortie, data, n);
+    const unsigned short *pixels = (const unsigned short *)data;
+    size_t k = 0;
+    while (k < n)
     {
-        for (int theta = 0; theta < 181; theta++)
+        size_t nb = (TAMPON_SORTIE - sortie->rempli) / 2;
+        if (nb == 0)
         {
-            if (imageVote->data[get_position(rho, theta, 181)] >= 80)
-            {
-                for (int j = 0; j < image->largeur; j++)
-                {
-                    X = (rho - (j * sin(theta * C_PI / 180))) / cos(theta * C_PI / 180);
-                    if (X >= 0 && X < image->hauteur)
-                    {
-                        imageDroite->data[get_position(X, j, image->largeur)] = 255;
-                    }
-                }
-            }
+            //? un seul octet libre (entête de longueur impaire): le pixel est coupé en deux
+            unsigned char octets[2];
+            pgm_encoder_16_bits(pixels + k++, octets, 1);
+            if (sortie_ecrire(sortie, octets, 2) != 0)
+                return -1;
+            continue;
         }
+        if (nb > n - k)
+            nb = n - k;
+        pgm_encoder_16_bits(pixels + k, sortie->tampons[sortie->courant] + sortie->rempli, nb);
+        sortie->rempli += 2 * nb;
+        k += nb;
+        if (sortie->rempli == TAMPON_SORTIE && sortie_vider(sortie) != 0)
+            return -1;
     }
-
-    // Construction de l'image finale en sommant l'image originale et l'image droite
-    ImagePGM *imageFinale = somme_images(image1, imageDroite);
-
-    // Libération des ressources intermédiaires
-    liberer_une_image(imageVote);
-    liberer_une_image(imageDroite);
-
-    return imageFinale;
+    return 0;
 }
 
-
-/*-------------------------------------------
-//? FONCTION ZOOM IN (reduction de la taille d'une image)
----------------------------------------------*/
-ImagePGM *zomm_in(ImagePGM *image)
+static void sortie_signaler(const SortiePGM *sortie)
 {
-    float polynome[2][2] = {{1.0 / 4, 1.0 / 4}, {1.0 / 4, 1.0 / 4}};
+    fprintf(stderr, "cannot write %s: %s\n", sortie->chemin, strerror(sortie->erreur));
+}
 
-    //?initialisation des images
-    ImagePGM *small_image = init_image_pgm(image->hauteur / 2, image->largeur / 2, image->max_val);
+//! abandonne l'écriture: le fichier temporaire est supprimé, la cible n'est pas modifiée
+static void sortie_abandonner(SortiePGM *sortie)
+{
+    sortie_attendre(sortie);
+    sortie_terminer(sortie);
+    if (sortie->erreur)
+        sortie_signaler(sortie);
+    if (sortie->temporaire)
+        unlink(sortie->temporaire);
+    free(sortie->temporaire);
+    sortie->temporaire = NULL;
+}
 
-    for (int n = 0; n < small_image->largeur * small_image->hauteur; n++)
+//! écrit le reste, vérifie la taille du fichier puis le renomme; retourne 0 si l'image est en place
+static int sortie_valider(SortiePGM *sortie)
+{
+    sortie_attendre(sortie);
+    if (sortie->rempli > 0 && !sortie->erreur)
     {
-        int j = get_numero_colonne(n, small_image->largeur);
-        int i = get_numero_ligne(n, small_image->largeur);
-
-        if (2 * i < image->hauteur && 2 * i + 1 < image->hauteur && 2 * j < image->largeur && 2 * j + 1 < image->largeur)
-        {
-            int a = get_position(2 * i, 2 * j, image->largeur);
-            ;
-            int b = get_position(2 * i, 2 * j + 1, image->largeur);
-            int c = get_position(2 * i + 1, 2 * j, image->largeur);
-            int d = get_position(2 * i + 1, 2 * j + 1, image->largeur);
-
-            small_image->data[n] = abs(image->data[a] * polynome[0][0] + image->data[b] * polynome[0][1] + image->data[c] * polynome[1][0] + image->data[d] * polynome[1][1]);
-        }
+#ifdef O_DIRECT
+        //? le dernier bloc n'a pas la taille d'un bloc du périphérique: O_DIRECT retiré pour lui
+        if (sortie->direct && sortie->rempli % BLOC_DIRECT != 0)
+            fcntl(sortie->fd, F_SETFL, fcntl(sortie->fd, F_GETFL) & ~O_DIRECT);
+#endif
+        if (ecrire_tout(sortie->fd, sortie->tampons[sortie->courant], sortie->rempli) != 0)
+            sortie->erreur = errno;
+        sortie->ecrits += sortie->rempli;
+        sortie->rempli = 0;
     }
-
-    return small_image;
+    struct stat etat;
+    if (!sortie->erreur && sortie->temporaire)
+    {
+        if (fstat(sortie->fd, &etat) != 0)
+            sortie->erreur = errno;
+        else if (etat.st_size != sortie->ecrits)
+            sortie->erreur = EIO;
+    }
+    sortie_terminer(sortie);
+    if (!sortie->erreur && sortie->temporaire && rename(sortie->temporaire, sortie->chemin) != 0)
+        sortie->erreur = errno;
+    if (!sortie->erreur)
+    {
+        free(sortie->temporaire);
+        sortie->temporaire = NULL;
+        return 0;
+    }
+    sortie_abandonner(sortie);
+    return -1;
 }
 
 /*-------------------------------------------
-//? FONCTION ZOOM OUT (augmentation de la taille d'une image)
+//? FORMATS D'IMAGE
+//? le format d'un fichier lu est reconnu à ses deux premiers octets; celui d'un fichier écrit
+//? est donné par --format, sinon par l'extension du fichier (.pgmz), sinon P5.
+//?   p5    PGM binaire, lu par projection sans copie (voir lecture_descripteur)
+//?   p2    PGM ASCII: valeurs décimales séparées par des blancs, lignes de 70 caractères au plus
+//?   pgmz  PGM compressé par blocs de lignes (magique PZ, voir plus bas), sans dépendance
+//? Le décodage et l'encodage de p2 et pgmz sont répartis sur le pool de threads.
 ---------------------------------------------*/
-ImagePGM *zomm_out(ImagePGM *image)
+typedef struct
 {
-    float polynome[2][2] = {{1.0 / 4, 1.0 / 4}, {1.0 / 4, 1.0 / 4}};
+    const char *nom;       //! valeur de --format
+    const char *magique;   //! deux premiers octets du fichier
+    const char *extension; //! format choisi pour les fichiers de sortie qui portent cette extension
+    //! remplit image (taille, valeur maximale, pixels du pool); NULL: P5, projeté par lecture_descripteur
+    int (*decoder)(const unsigned char *octets, size_t taille, ImagePGM *image);
+    int (*encoder)(SortiePGM *sortie, const ImagePGM *image);
+} CodecPGM;
 
-    //?initialisation des images
-    ImagePGM *big_image = init_image_pgm(image->hauteur * 2, image->largeur * 2, image->max_val);
+static int encoder_p5(SortiePGM *sortie, const ImagePGM *image)
+{
+    if (sortie_entete_pgm(sortie, "P5", image->largeur, image->hauteur, image->max_val) != 0)
+        return -1;
+    return sortie_pixels(sortie, image->data, (size_t)image->largeur * image->hauteur, image_16_bits(image));
+}
 
-    for (int n = 0; n < image->largeur * image->hauteur; n++)
+//! pixels du pool pour image, dont la taille vient d'être lue
+static int allouer_pixels_decodes(ImagePGM *image)
+{
+    image->data = obtenir_tampon(image->largeur, image->hauteur, octets_par_pixel(image));
+    if (!image->data)
     {
-        int j = get_numero_colonne(n, image->largeur);
-        int i = get_numero_ligne(n, image->largeur);
-
-        if (2 * i < big_image->hauteur && 2 * i + 1 < big_image->hauteur && 2 * j < big_image->largeur && 2 * j + 1 < big_image->largeur)
-        {
-            int a = get_position(2 * i, 2 * j, big_image->largeur);
-            ;
-            int b = get_position(2 * i, 2 * j + 1, big_image->largeur);
-            int c = get_position(2 * i + 1, 2 * j, big_image->largeur);
-            int d = get_position(2 * i + 1, 2 * j + 1, big_image->largeur);
-
-            big_image->data[a] = image->data[n];
-            big_image->data[b] = image->data[n];
-            big_image->data[c] = image->data[n];
-            big_image->data[d] = image->data[n];
-        }
+        perror("ne peut pas allouer la mémoire à l'image");
+        return -1;
     }
-
-    return big_image;
+    return 0;
 }
 
 /*-------------------------------------------
-//? FONCTION D'IMPLÉMENTATION DE LA MÉTHODE DE OTSU
+//? P2: DÉCODAGE EN DEUX PASSES PAR MORCEAUX DE OCTETS_MORCEAU_P2
+//? chaque morceau compte les valeurs qui y commencent; la somme des comptes précédents
+//? donne l'indice de sa première valeur, puis chaque morceau convertit les siennes.
 ---------------------------------------------*/
-ImagePGM *binaire_otsu(ImagePGM *image)
-{
-    int seuil = 1;
-    float *var_intra_classe = malloc(256 * sizeof(float));
-    int *h = histogramme(image);
-
-    for (int i = 1; i <= image->max_val; i++)
-    {
-        float m1 = 0.0;
-        float p1 = 0.0;
-        float m2 = 0.0;
-        float p2 = 0.0;
-        float var1 = 0.0;
-        float var2 = 0.0;
+#define OCTETS_MORCEAU_P2 4096
+#define COLONNES_MAX_P2 70
 
-        int aux = 0.0;
-        for (int j = 0; j <= i - 1; j++)
-        {
-            aux += h[j];
-        }
-
-        p1 = aux * 1.0 / (image->largeur * image->hauteur);
-        m1 = aux * 1.0 / (i);
+typedef struct
+{
+    const unsigned char *texte;
+    size_t taille;
+    size_t *comptes; //! valeurs commençant dans chaque morceau, puis indice de la première
+    ImagePGM *image;
+    size_t nb_pixels;
+    int invalide; //! caractère inattendu ou valeur supérieure à max_val
+} DecodageP2;
 
-        aux = 0.0;
-        for (int j = i; j <= 255; j++)
-        {
-            aux += h[j];
-        }
-        p2 = aux * 1.0 / (image->largeur * image->hauteur * 1.0);
-        m2 = aux * 1.0 / (256 - i);
+static inline int est_chiffre(unsigned char c)
+{
+    return c >= '0' && c <= '9';
+}
 
-        for (int j = 0; j <= i - 1; j++)
-        {
-            var1 += ((h[j] - m1) * (h[j] - m1));
-        }
+static inline int est_blanc(unsigned char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
 
-        for (int j = i; j <= 255; j++)
+static void p2_compter(void *contexte, int debut, int fin)
+{
+    DecodageP2 *decodage = contexte;
+    const unsigned char *texte = decodage->texte;
+    for (int m = debut; m < fin; m++)
+    {
+        size_t p = (size_t)m * OCTETS_MORCEAU_P2;
+        size_t limite = (p + OCTETS_MORCEAU_P2 < decodage->taille) ? p + OCTETS_MORCEAU_P2 : decodage->taille;
+        size_t compte = 0;
+        for (; p < limite; p++)
         {
-            var2 += ((h[j] - m2) * (h[j] - m2));
+            if (est_chiffre(texte[p]))
+                compte += (p == 0 || !est_chiffre(texte[p - 1]));
+            else if (!est_blanc(texte[p]))
+                __atomic_store_n(&decodage->invalide, 1, __ATOMIC_RELAXED);
         }
-        var1 /= i;
-        var2 /= (256.0 - i);
-        var_intra_classe[i] = p1 * var1 + p2 * var2;
+        decodage->comptes[m] = compte;
     }
+}
 
-    for (int i = 0; i <= 255; i++)
+SPECIALISE void p2_convertir(void *contexte, int debut, int fin, int seize)
+{
+    DecodageP2 *decodage = contexte;
+    const unsigned char *texte = decodage->texte;
+    int max_val = decodage->image->max_val;
+    for (int m = debut; m < fin; m++)
     {
-        if (var_intra_classe[i] > var_intra_classe[seuil])
+        size_t indice = decodage->comptes[m];
+        size_t p = (size_t)m * OCTETS_MORCEAU_P2;
+        size_t limite = (p + OCTETS_MORCEAU_P2 < decodage->taille) ? p + OCTETS_MORCEAU_P2 : decodage->taille;
+        for (; p < limite && indice < decodage->nb_pixels; p++)
         {
-            seuil = i;
+            if (!est_chiffre(texte[p]) || (p > 0 && est_chiffre(texte[p - 1])))
+                continue;
+            //? une valeur qui commence dans le morceau est lue jusqu'au bout, même au-delà
+            long valeur = 0;
+            for (size_t q = p; q < decodage->taille && est_chiffre(texte[q]) && valeur <= max_val; q++)
+                valeur = valeur * 10 + (texte[q] - '0');
+            if (valeur > max_val)
+            {
+                __atomic_store_n(&decodage->invalide, 1, __ATOMIC_RELAXED);
+                return;
+            }
+            PIXEL_ECRIRE(decodage->image->data, indice, valeur, seize);
+            indice++;
         }
     }
-
-    return seuillage(image, seuil);
 }
+SPECIALISER_BANDE(p2_convertir)
 
-int to_int(const char * word){
-    char *str = "123";
-    int num;
-    sscanf(str, "%d", &num);
-    return num;
-}
-
-int main(int argc, char **argv)
+static int decoder_p2(const unsigned char *octets, size_t taille, ImagePGM *image)
 {
-    int seuil;
-
-    ImagePGM *image = lecture(argv[2]);
-    if(strcmp(argv[1], "addition") == 0 || strcmp(argv[1], "soustraction") == 0)
+    size_t debut = pgm_analyser_champs(octets, taille, &image->largeur, &image->hauteur, &image->max_val);
+    if (!debut)
+        return -1;
+    DecodageP2 decodage = {octets + debut, (debut < taille) ? taille - debut : 0, NULL, image, (size_t)image->largeur * image->hauteur, 0};
+    size_t nb_morceaux = (decodage.taille + OCTETS_MORCEAU_P2 - 1) / OCTETS_MORCEAU_P2;
+    if (nb_morceaux > 0x7fffffff)
     {
-        ImagePGM *image2 = lecture(argv[3]);
-        if (strcmp(argv[1], "addition")== 0)
-        {
-            ImagePGM *somme = somme_images(image, image2);
-            const char *somme_img = "somme_img.pgm";
-            enregister_pgm(somme_img, somme);
-        }
-        else{
-            ImagePGM *diff = difference_images(image, image2);
-            const char *diff_img = "diff_img.pgm";
-            enregister_pgm(diff_img, diff);
-        }
-        liberer_une_image(image2);
+        fprintf(stderr, "Fichier P2 trop grand\n");
+        return -1;
     }
-
-    else if (strcmp(argv[1], "contrast") == 0)
+    decodage.comptes = malloc((nb_morceaux + 1) * sizeof(size_t));
+    if (!decodage.comptes || allouer_pixels_decodes(image) != 0)
     {
-        ImagePGM *image_contrast = modification_basique_du_contraste(image);
-        const char *contrast_img = "contrast_img.pgm";
-        enregister_pgm(contrast_img, image_contrast);
+        if (!decodage.comptes)
+            perror("cannot allocate memory");
+        free(decodage.comptes);
+        return -1;
     }
 
-    else if (strcmp(argv[1], "eq_histogramme") == 0)
+    executer_par_bandes((int)nb_morceaux, p2_compter, &decodage);
+    size_t total = 0;
+    for (size_t m = 0; m < nb_morceaux; m++)
     {
-        ImagePGM *image_eq_hist = egaliser_histogramme(image);
-        const char *eq_hist_img = "eq_hist_img.pgm";
-        enregister_pgm(eq_hist_img, image_eq_hist);
+        size_t compte = decodage.comptes[m];
+        decodage.comptes[m] = total;
+        total += compte;
     }
-    else if (strcmp(argv[1], "zoom_in") == 0)
+    if (!decodage.invalide)
+        executer_par_bandes((int)nb_morceaux, image_16_bits(image) ? p2_convertir_16 : p2_convertir_8, &decodage);
+    free(decodage.comptes);
+    if (decodage.invalide)
     {
-        ImagePGM *image_zoom_in = zomm_in(image);
-        const char *zoom_in_img = "zoom_in_img.pgm";
-        enregister_pgm(zoom_in_img, image_zoom_in);
+        fprintf(stderr, "Fichier P2 invalide: caractère inattendu ou valeur supérieure à %d\n", image->max_val);
+        rendre_tampon(image->data, image->largeur, image->hauteur, octets_par_pixel(image));
+        image->data = NULL;
+        return -1;
     }
-    else if (strcmp(argv[1], "zoom_out") == 0)
+    if (total < decodage.nb_pixels)
     {
-        ImagePGM *image_zoom_out = zomm_out(image);
-        const char *zoom_out_img = "zoom_out_img.pgm";
-        enregister_pgm(zoom_out_img, image_zoom_out);
+        fprintf(stderr, "Fichier PGM tronqué: %zu pixels manquants mis à 0\n", decodage.nb_pixels - total);
+        memset(image->data + total * octets_par_pixel(image), 0, (decodage.nb_pixels - total) * octets_par_pixel(image));
     }
-    else if (strcmp(argv[1], "seuillage") == 0)
+    return 0;
+}
+
+/*-------------------------------------------
+//? P2: ENCODAGE PAR GROUPES DE LIGNES_GROUPE_P2 LIGNES
+//? les lignes d'un groupe sont mises en texte en parallèle, chacune dans sa case de
+//? 6 x largeur octets (5 chiffres et un séparateur par valeur), puis écrites dans l'ordre.
+---------------------------------------------*/
+#define LIGNES_GROUPE_P2 256
+
+typedef struct
+{
+    const ImagePGM *image;
+    int premiere;
+    char *texte;
+    size_t pas;
+    size_t *longueurs;
+} EncodageP2;
+
+SPECIALISE void p2_formater(void *contexte, int debut, int fin, int seize)
+{
+    EncodageP2 *encodage = contexte;
+    for (int i = debut; i < fin; i++)
+    {
+        const unsigned char *ligne = ligne_image(encodage->image, encodage->premiere + i);
+        char *texte = encodage->texte + (size_t)i * encodage->pas;
+        size_t n = 0;
+        size_t colonne = 0;
+        for (int j = 0; j < encodage->image->largeur; j++)
+        {
+            char chiffres[5];
+            int nb = 0;
+            unsigned int valeur = PIXEL_LIRE(ligne, j, seize);
+            do
+            {
+                chiffres[nb++] = '0' + valeur % 10;
+                valeur /= 10;
+            } while (valeur);
+            if (j > 0)
+            {
+                int retour = colonne + 1 + nb > COLONNES_MAX_P2;
+                texte[n++] = retour ? '\n' : ' ';
+                colonne = retour ? 0 : colonne + 1;
+            }
+            while (nb > 0)
+                texte[n++] = chiffres[--nb], colonne++;
+        }
+        texte[n++] = '\n';
+        encodage->longueurs[i] = n;
+    }
+}
+SPECIALISER_BANDE(p2_formater)
+
+static int encoder_p2(SortiePGM *sortie, const ImagePGM *image)
+{
+    if (sortie_entete_pgm(sortie, "P2", image->largeur, image->hauteur, image->max_val) != 0)
+        return -1;
+    int groupe = (image->hauteur < LIGNES_GROUPE_P2) ? image->hauteur : LIGNES_GROUPE_P2;
+    EncodageP2 encodage = {image, 0, NULL, (size_t)image->largeur * 6, NULL};
+    encodage.texte = malloc(groupe * encodage.pas);
+    encodage.longueurs = malloc(groupe * sizeof(size_t));
+    int code = 0;
+    if (!encodage.texte || !encodage.longueurs)
+    {
+        perror("cannot allocate memory");
+        code = -1;
+    }
+    for (; !code && encodage.premiere < image->hauteur; encodage.premiere += groupe)
+    {
+        int nb = image->hauteur - encodage.premiere;
+        if (nb > groupe)
+            nb = groupe;
+        executer_par_bandes(nb, image_16_bits(image) ? p2_formater_16 : p2_formater_8, &encodage);
+        for (int i = 0; i < nb && !code; i++)
+            code = sortie_ecrire(sortie, encodage.texte + (size_t)i * encodage.pas, encodage.longueurs[i]);
+    }
+    free(encodage.texte);
+    free(encodage.longueurs);
+    return code;
+}
+
+/*-------------------------------------------
+//? PGMZ: PGM COMPRESSÉ PAR BLOCS INDÉPENDANTS DE LIGNES
+//? entête "PZ\n<largeur> <hauteur>\n<max_val>\n", nombre de lignes par bloc puis taille de
+//? chaque bloc (4 octets big-endian chacun), puis les blocs à la suite.
+//? Un bloc est codé comme un balayage LOCO-I (JPEG-LS sans perte) qui repart de zéro:
+//? prédicteur MED corrigé du biais de son contexte (gradients quantifiés, signes fusionnés),
+//? erreur modulo max_val + 1 codée en Golomb-Rice de paramètre adapté par contexte, et mode
+//? plage (longueurs de répétition du voisin gauche) là où les gradients sont nuls.
+//? Au-dessus de la première ligne du bloc, les voisins valent 0; en début de ligne, les
+//? voisins gauche et haut-gauche sont pris égaux au voisin haut, en fin de ligne le voisin
+//? haut-droit aussi: le bloc n'est donc pas un flux JPEG-LS.
+//? Premier octet d'un bloc: 0 pixels bruts (comme P5), 1 LOCO-I.
+//? Les blocs se décodent et s'encodent en parallèle.
+---------------------------------------------*/
+#define LIGNES_BLOC_PZ 32
+#define NB_CONTEXTES_PZ 405 //! q1 >= 0 après fusion des signes, q2 et q3 dans [-4, 4]
+#define REMISE_PZ 64        //! les statistiques d'un contexte sont divisées par 2 à ce compte
+#define BIAIS_MIN_PZ -128
+#define BIAIS_MAX_PZ 127
+
+//! ordre du code des longueurs de plage, indexé par l'indice de plage
+static const int ordre_plage_pz[32] = {0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                       4, 4, 5, 5, 6, 6, 7, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+
+typedef struct
+{
+    int max_val;
+    int plage;      //! max_val + 1: les erreurs sont réduites modulo plage
+    int qbpp;       //! bits d'une valeur de [0, plage[
+    int limite;     //! longueur maximale d'un code de Golomb
+    int t1, t2, t3; //! seuils de quantification des gradients
+} ParametresPZ;
+
+//? statistiques adaptatives d'un bloc: a somme des |erreurs|, b et c biais, n effectif
+typedef struct
+{
+    int a[NB_CONTEXTES_PZ];
+    int b[NB_CONTEXTES_PZ];
+    int c[NB_CONTEXTES_PZ];
+    int n[NB_CONTEXTES_PZ];
+    int a_plage[2]; //! interruption de plage, gauche différent ou égal au voisin haut
+    int n_plage[2];
+    int negatifs_plage[2];
+    int indice_plage;
+} EtatPZ;
+
+static inline int borner_pz(int valeur, int mini, int maxi)
+{
+    return (valeur < mini) ? mini : (valeur > maxi) ? maxi : valeur;
+}
+
+//! seuils par défaut de JPEG-LS (T.87, C.2.4.1.1) pour une erreur nulle
+static void pz_parametres(int max_val, ParametresPZ *p)
+{
+    p->max_val = max_val;
+    p->plage = max_val + 1;
+    p->qbpp = 1;
+    while ((1 << p->qbpp) < p->plage)
+        p->qbpp++;
+    int bpp = (p->qbpp < 2) ? 2 : p->qbpp;
+    p->limite = 2 * (bpp + ((bpp < 8) ? 8 : bpp));
+    if (max_val >= 128)
+    {
+        int facteur = (((max_val < 4095) ? max_val : 4095) + 128) >> 8;
+        p->t1 = borner_pz(facteur + 2, 1, max_val);
+        p->t2 = borner_pz(facteur * 4 + 3, p->t1, max_val);
+        p->t3 = borner_pz(facteur * 17 + 4, p->t2, max_val);
+    }
+    else
+    {
+        int facteur = 256 / (max_val + 1);
+        p->t1 = borner_pz((3 / facteur > 2) ? 3 / facteur : 2, 1, max_val);
+        p->t2 = borner_pz((7 / facteur > 3) ? 7 / facteur : 3, p->t1, max_val);
+        p->t3 = borner_pz((21 / facteur > 4) ? 21 / facteur : 4, p->t2, max_val);
+    }
+}
+
+static void pz_etat_initial(const ParametresPZ *p, EtatPZ *e)
+{
+    int a = (p->plage + 32) >> 6;
+    if (a < 2)
+        a = 2;
+    for (int q = 0; q < NB_CONTEXTES_PZ; q++)
+    {
+        e->a[q] = a;
+        e->b[q] = 0;
+        e->c[q] = 0;
+        e->n[q] = 1;
+    }
+    for (int r = 0; r < 2; r++)
+    {
+        e->a_plage[r] = a;
+        e->n_plage[r] = 1;
+        e->negatifs_plage[r] = 0;
+    }
+    e->indice_plage = 0;
+}
+
+static inline int pz_quantifier(int d, const ParametresPZ *p)
+{
+    if (d <= -p->t3)
+        return -4;
+    if (d <= -p->t2)
+        return -3;
+    if (d <= -p->t1)
+        return -2;
+    if (d < 0)
+        return -1;
+    if (d == 0)
+        return 0;
+    if (d < p->t1)
+        return 1;
+    if (d < p->t2)
+        return 2;
+    if (d < p->t3)
+        return 3;
+    return 4;
+}
+
+//! contexte des gradients haut-droit - haut, haut - haut-gauche, haut-gauche - gauche;
+//! -1 si tous sont nuls (mode plage)
+static inline int pz_contexte(const ParametresPZ *p, int a, int b, int c, int d, int *signe)
+{
+    int q1 = pz_quantifier(d - b, p);
+    int q2 = pz_quantifier(b - c, p);
+    int q3 = pz_quantifier(c - a, p);
+    if (q1 == 0 && q2 == 0 && q3 == 0)
+        return -1;
+    *signe = 1;
+    if (q1 < 0 || (q1 == 0 && (q2 < 0 || (q2 == 0 && q3 < 0))))
+    {
+        q1 = -q1;
+        q2 = -q2;
+        q3 = -q3;
+        *signe = -1;
+    }
+    return (q1 * 9 + q2 + 4) * 9 + q3 + 4;
+}
+
+static inline int prediction_med(int gauche, int haut, int diagonale)
+{
+    int mini = (gauche < haut) ? gauche : haut;
+    int maxi = (gauche < haut) ? haut : gauche;
+    if (diagonale >= maxi)
+        return mini;
+    if (diagonale <= mini)
+        return maxi;
+    return gauche + haut - diagonale;
+}
+
+//! prédiction MED corrigée du biais du contexte q
+static inline int pz_prediction(const ParametresPZ *p, const EtatPZ *e, int q, int signe, int a, int b, int c)
+{
+    return borner_pz(prediction_med(a, b, c) + signe * e->c[q], 0, p->max_val);
+}
+
+//! erreur ramenée dans [-plage/2, plage/2[
+static inline int pz_reduire(int erreur, const ParametresPZ *p)
+{
+    if (erreur < 0)
+        erreur += p->plage;
+    if (erreur >= (p->plage + 1) / 2)
+        erreur -= p->plage;
+    return erreur;
+}
+
+static inline int pz_reconstruire(int valeur, const ParametresPZ *p)
+{
+    if (valeur < 0)
+        return valeur + p->plage;
+    if (valeur > p->max_val)
+        return valeur - p->plage;
+    return valeur;
+}
+
+static inline int pz_ordre_golomb(int a, int n)
+{
+    int k = 0;
+    while ((n << k) < a)
+        k++;
+    return k;
+}
+
+static inline void pz_mettre_a_jour(EtatPZ *e, int q, int erreur)
+{
+    e->b[q] += erreur;
+    e->a[q] += (erreur < 0) ? -erreur : erreur;
+    if (e->n[q] == REMISE_PZ)
+    {
+        e->a[q] >>= 1;
+        e->b[q] = (e->b[q] >= 0) ? e->b[q] >> 1 : -((1 - e->b[q]) >> 1);
+        e->n[q] >>= 1;
+    }
+    e->n[q]++;
+    if (e->b[q] <= -e->n[q])
+    {
+        e->b[q] += e->n[q];
+        if (e->c[q] > BIAIS_MIN_PZ)
+            e->c[q]--;
+        if (e->b[q] <= -e->n[q])
+            e->b[q] = -e->n[q] + 1;
+    }
+    else if (e->b[q] > 0)
+    {
+        e->b[q] -= e->n[q];
+        if (e->c[q] < BIAIS_MAX_PZ)
+            e->c[q]++;
+        if (e->b[q] > 0)
+            e->b[q] = 0;
+    }
+}
+
+//! type r d'interruption de plage: ajuste les statistiques après l'erreur codée par valeur
+static inline void pz_mettre_a_jour_plage(EtatPZ *e, int r, int erreur, int valeur)
+{
+    if (erreur < 0)
+        e->negatifs_plage[r]++;
+    e->a_plage[r] += (valeur + 1 - r) >> 1;
+    if (e->n_plage[r] == REMISE_PZ)
+    {
+        e->a_plage[r] >>= 1;
+        e->n_plage[r] >>= 1;
+        e->negatifs_plage[r] >>= 1;
+    }
+    e->n_plage[r]++;
+}
+
+//! inversion du signe des erreurs d'interruption de plage (T.87, A.7.2)
+static inline int pz_inverser_plage(const EtatPZ *e, int r, int k, int erreur)
+{
+    return (k == 0 && erreur > 0 && 2 * e->negatifs_plage[r] < e->n_plage[r]) ||
+           (erreur < 0 && (2 * e->negatifs_plage[r] >= e->n_plage[r] || k != 0));
+}
+
+//? écriture de bits, poids fort d'abord; plein passe à 1 si la capacité est dépassée
+typedef struct
+{
+    unsigned char *octets;
+    size_t capacite;
+    size_t position;
+    uint64_t accumulateur;
+    int nb_bits;
+    int plein;
+} EcrivainBits;
+
+//! nb <= 32 bits de valeur
+static inline void bits_ecrire(EcrivainBits *e, uint32_t valeur, int nb)
+{
+    e->accumulateur = e->accumulateur << nb | valeur;
+    e->nb_bits += nb;
+    while (e->nb_bits >= 8)
+    {
+        e->nb_bits -= 8;
+        if (e->position < e->capacite)
+            e->octets[e->position++] = (unsigned char)(e->accumulateur >> e->nb_bits);
+        else
+            e->plein = 1;
+    }
+}
+
+static inline void bits_zeros_puis_un(EcrivainBits *e, int zeros)
+{
+    for (; zeros > 24; zeros -= 24)
+        bits_ecrire(e, 0, 24);
+    bits_ecrire(e, 1, zeros + 1);
+}
+
+//! code de Golomb d'ordre k, au plus limite bits: au-delà, échappement puis valeur - 1 sur qbpp bits
+static inline void pz_ecrire_golomb(EcrivainBits *e, int valeur, int k, int limite, int qbpp)
+{
+    int seuil = limite - qbpp - 1;
+    if ((valeur >> k) < seuil)
+    {
+        bits_zeros_puis_un(e, valeur >> k);
+        if (k)
+            bits_ecrire(e, valeur & ((1u << k) - 1), k);
+    }
+    else
+    {
+        bits_zeros_puis_un(e, seuil);
+        bits_ecrire(e, valeur - 1, qbpp);
+    }
+}
+
+//? lecture de bits: l'accumulateur est aligné à gauche, des zéros suivent la fin des données
+typedef struct
+{
+    const unsigned char *octets;
+    size_t taille;
+    size_t position;
+    uint64_t accumulateur;
+    int nb_bits;
+} LecteurBits;
+
+static inline void bits_remplir(LecteurBits *l)
+{
+    for (; l->nb_bits <= 56; l->nb_bits += 8, l->position++)
+    {
+        if (l->position < l->taille)
+            l->accumulateur |= (uint64_t)l->octets[l->position] << (56 - l->nb_bits);
+    }
+}
+
+//! 1 <= nb <= 32
+static inline uint32_t bits_lire(LecteurBits *l, int nb)
+{
+    bits_remplir(l);
+    uint32_t valeur = (uint32_t)(l->accumulateur >> (64 - nb));
+    l->accumulateur <<= nb;
+    l->nb_bits -= nb;
+    return valeur;
+}
+
+//! nombre de zéros avant le prochain 1 (consommé), -1 au-delà de maxi (maxi <= 55)
+static inline int bits_zeros(LecteurBits *l, int maxi)
+{
+    bits_remplir(l);
+    if (l->accumulateur == 0)
+        return -1;
+    int zeros = __builtin_clzll(l->accumulateur);
+    if (zeros > maxi)
+        return -1;
+    l->accumulateur <<= zeros + 1;
+    l->nb_bits -= zeros + 1;
+    return zeros;
+}
+
+//! vrai si la lecture n'a pas dépassé la fin des données
+static inline int bits_complets(const LecteurBits *l)
+{
+    return l->position * 8 - l->nb_bits <= l->taille * 8;
+}
+
+//! -1 si le code est invalide ou si la valeur dépasse 2 * plage
+static inline int pz_lire_golomb(LecteurBits *l, int k, int limite, const ParametresPZ *p)
+{
+    int seuil = limite - p->qbpp - 1;
+    int q = bits_zeros(l, seuil);
+    if (q < 0)
+        return -1;
+    int valeur = (q < seuil) ? (q << k | (k ? (int)bits_lire(l, k) : 0)) : (int)bits_lire(l, p->qbpp) + 1;
+    return (valeur <= 2 * p->plage) ? valeur : -1;
+}
+
+//! voisins du pixel j: gauche, haut, haut-gauche, haut-droit (haut NULL sur la première ligne du bloc)
+#define PZ_VOISINS(ligne, haut, j, largeur, seize, a, b, c, d)                                         \
+    int b = (haut) ? PIXEL_LIRE(haut, j, seize) : 0;                                                   \
+    int a = ((j) > 0) ? PIXEL_LIRE(ligne, (j) - 1, seize) : b;                                         \
+    int c = ((j) > 0) ? ((haut) ? PIXEL_LIRE(haut, (j) - 1, seize) : 0) : b;                           \
+    int d = ((j) + 1 < (largeur)) ? ((haut) ? PIXEL_LIRE(haut, (j) + 1, seize) : 0) : b
+
+//! code les lignes [premiere, derniere[ dans e; 0 si un pixel dépasse max_val
+SPECIALISE int pz_coder_bloc(const ImagePGM *image, int premiere, int derniere, const ParametresPZ *p, EcrivainBits *ecrivain, int seize)
+{
+    EtatPZ etat;
+    EtatPZ *e = &etat;
+    pz_etat_initial(p, e);
+    int largeur = image->largeur;
+    for (int i = premiere; i < derniere && !ecrivain->plein; i++)
+    {
+        const unsigned char *ligne = ligne_image(image, i);
+        const unsigned char *haut = (i > premiere) ? ligne_image(image, i - 1) : NULL;
+        int j = 0;
+        while (j < largeur)
+        {
+            PZ_VOISINS(ligne, haut, j, largeur, seize, a, b, c, d);
+            int x = PIXEL_LIRE(ligne, j, seize);
+            if (x > p->max_val)
+                return 0;
+            int signe;
+            int q = pz_contexte(p, a, b, c, d, &signe);
+            if (q >= 0)
+            {
+                int erreur = x - pz_prediction(p, e, q, signe, a, b, c);
+                erreur = pz_reduire(signe * erreur, p);
+                int k = pz_ordre_golomb(e->a[q], e->n[q]);
+                int valeur;
+                if (k == 0 && 2 * e->b[q] <= -e->n[q])
+                    valeur = (erreur >= 0) ? 2 * erreur + 1 : -2 * (erreur + 1);
+                else
+                    valeur = (erreur >= 0) ? 2 * erreur : -2 * erreur - 1;
+                pz_ecrire_golomb(ecrivain, valeur, k, p->limite, p->qbpp);
+                pz_mettre_a_jour(e, q, erreur);
+                j++;
+                continue;
+            }
+
+            //? mode plage: répétitions de a codées par segments de 2^ordre
+            int longueur = 0;
+            while (j + longueur < largeur && PIXEL_LIRE(ligne, j + longueur, seize) == a)
+                longueur++;
+            int reste = longueur;
+            while (reste >= 1 << ordre_plage_pz[e->indice_plage])
+            {
+                bits_ecrire(ecrivain, 1, 1);
+                reste -= 1 << ordre_plage_pz[e->indice_plage];
+                if (e->indice_plage < 31)
+                    e->indice_plage++;
+            }
+            j += longueur;
+            if (j == largeur)
+            {
+                if (reste > 0)
+                    bits_ecrire(ecrivain, 1, 1);
+                break;
+            }
+            bits_ecrire(ecrivain, 0, 1);
+            int ordre = ordre_plage_pz[e->indice_plage];
+            if (ordre)
+                bits_ecrire(ecrivain, reste, ordre);
+
+            //? interruption: le pixel j diffère de a
+            x = PIXEL_LIRE(ligne, j, seize);
+            if (x > p->max_val)
+                return 0;
+            int b_j = haut ? PIXEL_LIRE(haut, j, seize) : 0;
+            int r = (a == b_j);
+            int erreur = x - (r ? a : b_j);
+            if (!r && a > b_j)
+                erreur = -erreur;
+            erreur = pz_reduire(erreur, p);
+            int k = pz_ordre_golomb(e->a_plage[r] + (r ? e->n_plage[r] >> 1 : 0), e->n_plage[r]);
+            int valeur = 2 * ((erreur < 0) ? -erreur : erreur) - r - pz_inverser_plage(e, r, k, erreur);
+            pz_ecrire_golomb(ecrivain, valeur, k, p->limite - ordre - 1, p->qbpp);
+            pz_mettre_a_jour_plage(e, r, erreur, valeur);
+            if (e->indice_plage > 0)
+                e->indice_plage--;
+            j++;
+        }
+    }
+    return 1;
+}
+
+//! décode les lignes [premiere, derniere[; -1 si le bloc est corrompu
+SPECIALISE int pz_decoder_bloc(ImagePGM *image, int premiere, int derniere, const ParametresPZ *p, LecteurBits *lecteur, int seize)
+{
+    EtatPZ etat;
+    EtatPZ *e = &etat;
+    pz_etat_initial(p, e);
+    int largeur = image->largeur;
+    for (int i = premiere; i < derniere; i++)
+    {
+        unsigned char *ligne = ligne_image(image, i);
+        const unsigned char *haut = (i > premiere) ? ligne_image(image, i - 1) : NULL;
+        int j = 0;
+        while (j < largeur)
+        {
+            PZ_VOISINS(ligne, haut, j, largeur, seize, a, b, c, d);
+            int signe;
+            int q = pz_contexte(p, a, b, c, d, &signe);
+            if (q >= 0)
+            {
+                int k = pz_ordre_golomb(e->a[q], e->n[q]);
+                int valeur = pz_lire_golomb(lecteur, k, p->limite, p);
+                if (valeur < 0)
+                    return -1;
+                int erreur;
+                if (k == 0 && 2 * e->b[q] <= -e->n[q])
+                    erreur = (valeur & 1) ? (valeur - 1) / 2 : -(valeur / 2) - 1;
+                else
+                    erreur = (valeur & 1) ? -(valeur + 1) / 2 : valeur / 2;
+                int x = pz_reconstruire(pz_prediction(p, e, q, signe, a, b, c) + signe * erreur, p);
+                pz_mettre_a_jour(e, q, erreur);
+                if (x < 0 || x > p->max_val)
+                    return -1;
+                PIXEL_ECRIRE(ligne, j, x, seize);
+                j++;
+                continue;
+            }
+
+            int fin_plage = 0;
+            while (!fin_plage)
+            {
+                int ordre = ordre_plage_pz[e->indice_plage];
+                if (bits_lire(lecteur, 1))
+                {
+                    int longueur = (largeur - j < 1 << ordre) ? largeur - j : 1 << ordre;
+                    for (int t = 0; t < longueur; t++)
+                        PIXEL_ECRIRE(ligne, j + t, a, seize);
+                    j += longueur;
+                    if (longueur == 1 << ordre && e->indice_plage < 31)
+                        e->indice_plage++;
+                    fin_plage = (j == largeur);
+                    continue;
+                }
+                int longueur = ordre ? (int)bits_lire(lecteur, ordre) : 0;
+                if (longueur >= largeur - j)
+                    return -1;
+                for (int t = 0; t < longueur; t++)
+                    PIXEL_ECRIRE(ligne, j + t, a, seize);
+                j += longueur;
+
+                int b_j = haut ? PIXEL_LIRE(haut, j, seize) : 0;
+                int r = (a == b_j);
+                int k = pz_ordre_golomb(e->a_plage[r] + (r ? e->n_plage[r] >> 1 : 0), e->n_plage[r]);
+                int valeur = pz_lire_golomb(lecteur, k, p->limite - ordre - 1, p);
+                if (valeur < 0)
+                    return -1;
+                int impair = (valeur + r) & 1;
+                int erreur = (valeur + r + impair) / 2;
+                if ((k != 0 || 2 * e->negatifs_plage[r] >= e->n_plage[r]) == impair)
+                    erreur = -erreur;
+                pz_mettre_a_jour_plage(e, r, erreur, valeur);
+                if (!r && a > b_j)
+                    erreur = -erreur;
+                int x = pz_reconstruire((r ? a : b_j) + erreur, p);
+                if (x < 0 || x > p->max_val)
+                    return -1;
+                PIXEL_ECRIRE(ligne, j, x, seize);
+                if (e->indice_plage > 0)
+                    e->indice_plage--;
+                j++;
+                fin_plage = 1;
+            }
+        }
+    }
+    return bits_complets(lecteur) ? 0 : -1;
+}
+
+typedef struct
+{
+    ImagePGM *image;
+    int lignes_bloc;
+    int nb_blocs;
+    const unsigned char *donnees; //! décodage: premier bloc du fichier
+    size_t *positions;            //! décodage: position de chaque bloc dans donnees
+    unsigned char **blocs;        //! encodage: blocs compressés
+    size_t *tailles;
+    int erreur;
+} BlocsPZ;
+
+//! traite les blocs dont la première ligne est dans [debut, fin[
+#define POUR_CHAQUE_BLOC_PZ(blocs, b, debut, fin) \
+    for (int b = ((debut) + (blocs)->lignes_bloc - 1) / (blocs)->lignes_bloc; b < (blocs)->nb_blocs && (long)b * (blocs)->lignes_bloc < (fin); b++)
+
+//! un bloc LOCO-I plus grand que les pixels bruts est remplacé par eux
+SPECIALISE void pz_encoder_blocs(void *contexte, int debut, int fin, int seize)
+{
+    BlocsPZ *blocs = contexte;
+    const ImagePGM *image = blocs->image;
+    ParametresPZ parametres;
+    pz_parametres(image->max_val, &parametres);
+    size_t octets_ligne = (size_t)image->largeur * octets_par_pixel(image);
+    POUR_CHAQUE_BLOC_PZ(blocs, b, debut, fin)
+    {
+        int premiere = b * blocs->lignes_bloc;
+        int derniere = (premiere + blocs->lignes_bloc < image->hauteur) ? premiere + blocs->lignes_bloc : image->hauteur;
+        size_t n = (derniere - premiere) * octets_ligne;
+        unsigned char *bloc = malloc(1 + n);
+        if (!bloc)
+        {
+            __atomic_store_n(&blocs->erreur, 1, __ATOMIC_RELAXED);
+            return;
+        }
+        EcrivainBits ecrivain = {bloc + 1, n, 0, 0, 0, 0};
+        bloc[0] = 1;
+        if (pz_coder_bloc(image, premiere, derniere, &parametres, &ecrivain, seize))
+        {
+            if (ecrivain.nb_bits > 0)
+                bits_ecrire(&ecrivain, 0, 8 - ecrivain.nb_bits);
+        }
+        else
+            ecrivain.plein = 1;
+        if (ecrivain.plein || ecrivain.position >= n)
+        {
+            bloc[0] = 0;
+            for (int i = premiere; i < derniere; i++)
+            {
+                const unsigned char *ligne = ligne_image(image, i);
+                unsigned char *brut = bloc + 1 + (i - premiere) * octets_ligne;
+                for (int j = 0; j < image->largeur; j++)
+                {
+                    int x = PIXEL_LIRE(ligne, j, seize);
+                    if (seize)
+                    {
+                        brut[2 * j] = x >> 8;
+                        brut[2 * j + 1] = x & 0xff;
+                    }
+                    else
+                        brut[j] = x;
+                }
+            }
+            ecrivain.position = n;
+        }
+        blocs->blocs[b] = bloc;
+        blocs->tailles[b] = 1 + ecrivain.position;
+    }
+}
+SPECIALISER_BANDE(pz_encoder_blocs)
+
+SPECIALISE void pz_decoder_blocs(void *contexte, int debut, int fin, int seize)
+{
+    BlocsPZ *blocs = contexte;
+    ImagePGM *image = blocs->image;
+    ParametresPZ parametres;
+    pz_parametres(image->max_val, &parametres);
+    size_t octets_ligne = (size_t)image->largeur * octets_par_pixel(image);
+    POUR_CHAQUE_BLOC_PZ(blocs, b, debut, fin)
+    {
+        int premiere = b * blocs->lignes_bloc;
+        int derniere = (premiere + blocs->lignes_bloc < image->hauteur) ? premiere + blocs->lignes_bloc : image->hauteur;
+        size_t n = (derniere - premiere) * octets_ligne;
+        const unsigned char *bloc = blocs->donnees + blocs->positions[b];
+        size_t taille = blocs->tailles[b] - 1;
+        int valide;
+        if (bloc[0] == 0)
+        {
+            valide = taille == n;
+            for (int i = premiere; i < derniere && valide; i++)
+            {
+                unsigned char *ligne = ligne_image(image, i);
+                const unsigned char *brut = bloc + 1 + (i - premiere) * octets_ligne;
+                for (int j = 0; j < image->largeur; j++)
+                    PIXEL_ECRIRE(ligne, j, seize ? (brut[2 * j] << 8 | brut[2 * j + 1]) : brut[j], seize);
+            }
+        }
+        else
+        {
+            LecteurBits lecteur = {bloc + 1, taille, 0, 0, 0};
+            valide = bloc[0] == 1 && pz_decoder_bloc(image, premiere, derniere, &parametres, &lecteur, seize) == 0;
+        }
+        if (!valide)
+        {
+            __atomic_store_n(&blocs->erreur, 1, __ATOMIC_RELAXED);
+            return;
+        }
+    }
+}
+SPECIALISER_BANDE(pz_decoder_blocs)
+
+static inline uint32_t lire_32_bits(const unsigned char *octets)
+{
+    return (uint32_t)octets[0] << 24 | (uint32_t)octets[1] << 16 | (uint32_t)octets[2] << 8 | octets[3];
+}
+
+static inline void ecrire_32_bits(unsigned char *octets, uint32_t valeur)
+{
+    octets[0] = valeur >> 24;
+    octets[1] = valeur >> 16;
+    octets[2] = valeur >> 8;
+    octets[3] = valeur;
+}
+
+static int decoder_pgmz(const unsigned char *octets, size_t taille, ImagePGM *image)
+{
+    size_t debut = pgm_analyser_champs(octets, taille, &image->largeur, &image->hauteur, &image->max_val);
+    if (!debut)
+        return -1;
+    BlocsPZ blocs = {image, 0, 0, NULL, NULL, NULL, NULL, 0};
+    //? lignes par bloc validées avant tout calcul: hors de [1, hauteur], la division déborde
+    uint32_t lignes_bloc = (taille - debut >= 4) ? lire_32_bits(octets + debut) : 0;
+    if (lignes_bloc >= 1 && lignes_bloc <= (uint32_t)image->hauteur)
+    {
+        blocs.lignes_bloc = (int)lignes_bloc;
+        blocs.nb_blocs = (image->hauteur + blocs.lignes_bloc - 1) / blocs.lignes_bloc;
+    }
+    size_t position = debut + 4 + 4 * (size_t)blocs.nb_blocs;
+    if (blocs.nb_blocs == 0 || position > taille)
+    {
+        fprintf(stderr, "Fichier PGMZ tronqué ou invalide\n");
+        return -1;
+    }
+    blocs.donnees = octets + position;
+    blocs.positions = malloc(blocs.nb_blocs * sizeof(size_t));
+    blocs.tailles = malloc(blocs.nb_blocs * sizeof(size_t));
+    if (!blocs.positions || !blocs.tailles)
+    {
+        perror("cannot allocate memory");
+        blocs.erreur = 1;
+    }
+    size_t total = 0;
+    for (int b = 0; b < blocs.nb_blocs && !blocs.erreur; b++)
+    {
+        blocs.positions[b] = total;
+        blocs.tailles[b] = lire_32_bits(octets + debut + 4 + 4 * (size_t)b);
+        total += blocs.tailles[b];
+        if (blocs.tailles[b] == 0 || total > taille - position)
+        {
+            fprintf(stderr, "Fichier PGMZ tronqué ou invalide\n");
+            blocs.erreur = 1;
+        }
+    }
+    if (!blocs.erreur && allouer_pixels_decodes(image) == 0)
+    {
+        executer_par_bandes(image->hauteur, image_16_bits(image) ? pz_decoder_blocs_16 : pz_decoder_blocs_8, &blocs);
+        if (blocs.erreur)
+        {
+            fprintf(stderr, "Fichier PGMZ corrompu\n");
+            rendre_tampon(image->data, image->largeur, image->hauteur, octets_par_pixel(image));
+            image->data = NULL;
+        }
+    }
+    free(blocs.positions);
+    free(blocs.tailles);
+    return image->data ? 0 : -1;
+}
+
+static int encoder_pgmz(SortiePGM *sortie, const ImagePGM *image)
+{
+    int lignes_bloc = (image->hauteur < LIGNES_BLOC_PZ) ? image->hauteur : LIGNES_BLOC_PZ; //! dans [1, hauteur] comme l'exige decoder_pgmz
+    BlocsPZ blocs = {(ImagePGM *)image, lignes_bloc, (image->hauteur + lignes_bloc - 1) / lignes_bloc, NULL, NULL, NULL, NULL, 0};
+    blocs.blocs = calloc(blocs.nb_blocs, sizeof(unsigned char *));
+    blocs.tailles = malloc(blocs.nb_blocs * sizeof(size_t));
+    unsigned char *table = malloc(4 + 4 * (size_t)blocs.nb_blocs);
+    int code = 0;
+    if (!blocs.blocs || !blocs.tailles || !table)
+        blocs.erreur = 1;
+    else
+        executer_par_bandes(image->hauteur, image_16_bits(image) ? pz_encoder_blocs_16 : pz_encoder_blocs_8, &blocs);
+    if (blocs.erreur)
+    {
+        perror("cannot allocate memory");
+        code = -1;
+    }
+    else
+    {
+        ecrire_32_bits(table, blocs.lignes_bloc);
+        for (int b = 0; b < blocs.nb_blocs; b++)
+            ecrire_32_bits(table + 4 + 4 * (size_t)b, (uint32_t)blocs.tailles[b]);
+        code = (sortie_entete_pgm(sortie, "PZ", image->largeur, image->hauteur, image->max_val) != 0 ||
+                sortie_ecrire(sortie, table, 4 + 4 * (size_t)blocs.nb_blocs) != 0) ? -1 : 0;
+        for (int b = 0; b < blocs.nb_blocs && !code; b++)
+            code = sortie_ecrire(sortie, blocs.blocs[b], blocs.tailles[b]);
+    }
+    for (int b = 0; blocs.blocs && b < blocs.nb_blocs; b++)
+        free(blocs.blocs[b]);
+    free(blocs.blocs);
+    free(blocs.tailles);
+    free(table);
+    return code;
+}
+
+/*-------------------------------------------
+//? TABLE DES FORMATS
+---------------------------------------------*/
+static const CodecPGM codecs[] = {
+    {"p5", "P5", ".pgm", NULL, encoder_p5},
+    {"p2", "P2", NULL, decoder_p2, encoder_p2},
+    {"pgmz", "PZ", ".pgmz", decoder_pgmz, encoder_pgmz},
+};
+#define NB_CODECS (sizeof(codecs) / sizeof(codecs[0]))
+
+static const CodecPGM *format_sortie = NULL; //! --format
+
+static const CodecPGM *trouver_codec(const char *nom)
+{
+    for (size_t k = 0; k < NB_CODECS; k++)
+    {
+        if (strcmp(codecs[k].nom, nom) == 0)
+            return &codecs[k];
+    }
+    return NULL;
+}
+
+//! format d'un fichier d'après ses deux premiers octets; NULL si inconnu
+static const CodecPGM *codec_du_contenu(const unsigned char *octets, size_t taille)
+{
+    for (size_t k = 0; taille >= 2 && k < NB_CODECS; k++)
+    {
+        if (memcmp(octets, codecs[k].magique, 2) == 0)
+            return &codecs[k];
+    }
+    return NULL;
+}
+
+//! format d'un fichier à écrire: --format, sinon l'extension, sinon P5
+static const CodecPGM *codec_de_sortie(const char *chemin)
+{
+    if (format_sortie)
+        return format_sortie;
+    size_t longueur = strlen(chemin);
+    for (size_t k = 0; k < NB_CODECS; k++)
+    {
+        const char *extension = codecs[k].extension;
+        if (extension && longueur >= strlen(extension) && strcasecmp(chemin + longueur - strlen(extension), extension) == 0)
+            return &codecs[k];
+    }
+    return &codecs[0];
+}
+
+/*-------------------------------------------
+//? FONCTIONS DE LECTURE DE L'IMAGE
+//? le fichier est projeté en mémoire (mmap) et data pointe directement sur les pixels:
+//? aucune copie. L'image lue est en lecture seule, les opérateurs écrivent dans une nouvelle image.
+//? Si la projection est impossible (tube, ...), le fichier est lu dans un tampon.
+//? Les pixels de 16 bits sont convertis dans l'ordre natif: ils sont toujours copiés.
+//? Les autres formats (P2, PZ) sont décodés dans une image du pool (voir FORMATS D'IMAGE).
+---------------------------------------------*/
+//! image d'un descripteur ouvert en lecture (fichier, tube, mémoire partagée); ferme fd
+static ImagePGM *lecture_descripteur(int fd)
+{
+    /*-------------------------------------------
+    //? LIBERATION DE L'ESPACE MEMOIRE POUR CONTENIR LES INFOS DE L'IMAGE
+    ---------------------------------------------*/
+    ImagePGM *image = calloc(1, sizeof(ImagePGM));
+    if (!image)
+    {
+        close(fd);
+        perror("cannot allocate memory");
+        return NULL;
+    }
+
+    /*-------------------------------------------
+    //? PROJECTION DU FICHIER EN MÉMOIRE
+    ---------------------------------------------*/
+    struct stat infos;
+    unsigned char *octets = NULL;
+    size_t taille = 0;
+    if (fstat(fd, &infos) == 0 && S_ISREG(infos.st_mode) && infos.st_size > 0)
+    {
+        taille = infos.st_size;
+        octets = mmap(NULL, taille, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (octets == MAP_FAILED)
+            octets = NULL;
+        else
+            madvise(octets, taille, MADV_SEQUENTIAL | MADV_WILLNEED);
+    }
+
+    if (octets)
+    {
+        const CodecPGM *codec = codec_du_contenu(octets, taille);
+        if (codec && codec->decoder)
+        {
+            close(fd);
+            int code = codec->decoder(octets, taille, image);
+            munmap(octets, taille);
+            if (code != 0)
+            {
+                free(image);
+                return NULL;
+            }
+            image->depuis_pool = 1;
+            return image;
+        }
+        size_t debut = analyser_entete_pgm(octets, taille, &image->largeur, &image->hauteur, &image->max_val);
+        close(fd);
+        if (!debut)
+        {
+            munmap(octets, taille);
+            free(image);
+            return NULL;
+        }
+        if (image_16_bits(image))
+        {
+            image->data = pgm_decoder_16_bits(octets + debut, taille - debut, image);
+            munmap(octets, taille);
+            if (!image->data)
+            {
+                free(image);
+                return NULL;
+            }
+            image->depuis_pool = 1;
+            return image;
+        }
+        if (taille - debut >= (size_t)image->largeur * image->hauteur)
+        {
+            image->data = octets + debut;
+            image->projection = octets;
+            image->taille_projection = taille;
+            return image;
+        }
+        //? fichier tronqué: copie complétée par des pixels noirs
+        image->data = pgm_copier_pixels_tronques(octets + debut, taille - debut, image);
+        munmap(octets, taille);
+        if (!image->data)
+        {
+            free(image);
+            return NULL;
+        }
+        image->depuis_pool = 1;
+        return image;
+    }
+
+    /*-------------------------------------------
+    //? LECTURE COMPLÈTE DANS UN TAMPON (fichiers non projetables)
+    ---------------------------------------------*/
+    size_t capacite = 1 << 20;
+    octets = malloc(capacite);
+    ssize_t lu;
+    while (octets && (lu = read(fd, octets + taille, capacite - taille)) > 0)
+    {
+        taille += lu;
+        if (taille == capacite)
+        {
+            unsigned char *plus_grand = realloc(octets, capacite * 2);
+            if (!plus_grand)
+            {
+                free(octets);
+                octets = NULL;
+                break;
+            }
+            octets = plus_grand;
+            capacite *= 2;
+        }
+    }
+    close(fd);
+    if (!octets)
+    {
+        free(image);
+        perror("ne peut pas allouer la mémoire à l'image");
+        return NULL;
+    }
+
+    const CodecPGM *codec = codec_du_contenu(octets, taille);
+    if (codec && codec->decoder)
+    {
+        int code = codec->decoder(octets, taille, image);
+        free(octets);
+        if (code != 0)
+        {
+            free(image);
+            return NULL;
+        }
+        image->depuis_pool = 1;
+        return image;
+    }
+    size_t debut = analyser_entete_pgm(octets, taille, &image->largeur, &image->hauteur, &image->max_val);
+    if (!debut)
+    {
+        free(octets);
+        free(image);
+        return NULL;
+    }
+    if (image_16_bits(image))
+    {
+        image->data = pgm_decoder_16_bits(octets + debut, taille - debut, image);
+        free(octets);
+        if (!image->data)
+        {
+            free(image);
+            return NULL;
+        }
+        image->depuis_pool = 1;
+        return image;
+    }
+    size_t nb_pixels = (size_t)image->largeur * image->hauteur;
+    if (taille - debut < nb_pixels)
+    {
+        image->data = pgm_copier_pixels_tronques(octets + debut, taille - debut, image);
+        free(octets);
+        if (!image->data)
+        {
+            free(image);
+            return NULL;
+        }
+        image->depuis_pool = 1;
+        return image;
+    }
+    memmove(octets, octets + debut, nb_pixels);
+    image->data = octets;
+    return image;
+}
+
+static ImagePGM *lecture_pgm(const char *nom_fichier)
+{
+    /*-------------------------------------------
+    //? OUVERTURE DU FICHIER QUI CONTIENT L'IMAGE
+    ---------------------------------------------*/
+    int fd = open(nom_fichier, O_RDONLY);
+    if (fd < 0)
+    {
+        perror("cannot open");
+        return NULL;
+    }
+    return lecture_descripteur(fd);
+}
+
+ImagePGM *lecture(const char *nom_fichier)
+{
+    MesureProfil mesure;
+    PROFIL_DEBUT(mesure);
+    ImagePGM *image = lecture_pgm(nom_fichier);
+    PROFIL_FIN(mesure, "lecture");
+    return image;
+}
+
+/*-------------------------------------------
+//? FONCTION D'ENREGISTREMENT DE L'IMAGE MODIFIÉE
+---------------------------------------------*/
+//! retourne 0 si le fichier est entièrement écrit et en place
+int enregister_pgm(const char *nom_fichier, ImagePGM *image)
+{
+    MesureProfil mesure;
+    PROFIL_DEBUT(mesure);
+    SortiePGM sortie;
+    int code = sortie_ouvrir(&sortie, nom_fichier, 0);
+    if (code == 0)
+    {
+        if (codec_de_sortie(nom_fichier)->encoder(&sortie, image) != 0)
+        {
+            sortie_abandonner(&sortie);
+            code = -1;
+        }
+        else
+            code = sortie_valider(&sortie);
+    }
+    PROFIL_FIN(mesure, "enregister_pgm");
+    return code;
+}
+
+/*-------------------------------------------
+//? CADRES EN MÉMOIRE PARTAGÉE POSIX (voir traitement_image.h)
+//? EnTeteCadre de 64 octets puis les pixels dans l'ordre natif, lignes contiguës:
+//? une image lue depuis un cadre est une vue sur la projection, sans copie.
+//? Un objet qui contient un fichier P5 complet est aussi accepté en lecture.
+---------------------------------------------*/
+struct TiCadre
+{
+    EnTeteCadre *entete; //! début de la projection
+    size_t taille;
+};
+
+//! taille totale d'un cadre valide, 0 si l'entête ne correspond pas à un objet de taille taille
+static size_t taille_cadre(const EnTeteCadre *entete, size_t taille)
+{
+    if (taille < TI_ENTETE_CADRE || memcmp(entete->magique, TI_MAGIQUE_CADRE, sizeof(entete->magique)) != 0)
+        return 0;
+    if (entete->largeur == 0 || entete->hauteur == 0 || entete->largeur > 0x7fffffff || entete->hauteur > 0x7fffffff ||
+        entete->max_val == 0 || entete->max_val > 65535 || entete->octets_pixel != (entete->max_val > 255 ? 2u : 1u) ||
+        entete->pas != (uint64_t)entete->largeur * entete->octets_pixel)
+        return 0;
+    size_t attendue = TI_ENTETE_CADRE + (size_t)entete->pas * entete->hauteur;
+    return (attendue <= taille) ? attendue : 0;
+}
+
+static TiCadre *projeter_cadre(int fd, int ecriture)
+{
+    struct stat infos;
+    TiCadre *cadre = calloc(1, sizeof(TiCadre));
+    if (!cadre || fstat(fd, &infos) != 0 || infos.st_size < TI_ENTETE_CADRE)
+    {
+        free(cadre);
+        return NULL;
+    }
+    cadre->taille = infos.st_size;
+    cadre->entete = mmap(NULL, cadre->taille, ecriture ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    if (cadre->entete == MAP_FAILED || !taille_cadre(cadre->entete, cadre->taille))
+    {
+        if (cadre->entete != MAP_FAILED)
+            munmap(cadre->entete, cadre->taille);
+        free(cadre);
+        return NULL;
+    }
+    return cadre;
+}
+
+TiCadre *ti_cadre_creer(const char *nom, int largeur, int hauteur, int max_val)
+{
+    if (!nom || largeur <= 0 || hauteur <= 0 || max_val <= 0 || max_val > 65535)
+        return NULL;
+    uint32_t octets_pixel = (max_val > 255) ? 2 : 1;
+    size_t taille = TI_ENTETE_CADRE + (size_t)largeur * hauteur * octets_pixel;
+    int fd = shm_open(nom, O_RDWR | O_CREAT, 0600);
+    if (fd < 0)
+        return NULL;
+    TiCadre *cadre = NULL;
+    if (ftruncate(fd, taille) == 0)
+    {
+        EnTeteCadre *entete = mmap(NULL, taille, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (entete != MAP_FAILED)
+        {
+            memset(entete, 0, TI_ENTETE_CADRE);
+            memcpy(entete->magique, TI_MAGIQUE_CADRE, sizeof(entete->magique));
+            entete->largeur = largeur;
+            entete->hauteur = hauteur;
+            entete->max_val = max_val;
+            entete->octets_pixel = octets_pixel;
+            entete->pas = (uint64_t)largeur * octets_pixel;
+            cadre = malloc(sizeof(TiCadre));
+            if (cadre)
+                *cadre = (TiCadre){entete, taille};
+            else
+                munmap(entete, taille);
+        }
+    }
+    close(fd);
+    return cadre;
+}
+
+TiCadre *ti_cadre_ouvrir(const char *nom, int ecriture)
+{
+    int fd = nom ? shm_open(nom, ecriture ? O_RDWR : O_RDONLY, 0) : -1;
+    if (fd < 0)
+        return NULL;
+    TiCadre *cadre = projeter_cadre(fd, ecriture);
+    close(fd);
+    return cadre;
+}
+
+TiImage ti_cadre_image(const TiCadre *cadre)
+{
+    const EnTeteCadre *e = cadre->entete;
+    return (TiImage){(int)e->largeur, (int)e->hauteur, (int)e->max_val, (size_t)e->pas, (unsigned char *)cadre->entete + TI_ENTETE_CADRE};
+}
+
+uint64_t ti_cadre_sequence(const TiCadre *cadre)
+{
+    return __atomic_load_n(&cadre->entete->sequence, __ATOMIC_ACQUIRE);
+}
+
+uint64_t ti_cadre_publier(TiCadre *cadre)
+{
+    return __atomic_add_fetch(&cadre->entete->sequence, 1, __ATOMIC_RELEASE);
+}
+
+void ti_cadre_fermer(TiCadre *cadre)
+{
+    if (cadre)
+    {
+        munmap(cadre->entete, cadre->taille);
+        free(cadre);
+    }
+}
+
+int ti_cadre_supprimer(const char *nom)
+{
+    return shm_unlink(nom) == 0 ? TI_OK : TI_ERREUR_SYSTEME;
+}
+
+//! image d'un objet partagé: vue sur un cadre, ou lecture d'un fichier P5 complet
+ImagePGM *lecture_partagee(const char *nom)
+{
+    int fd = shm_open(nom, O_RDONLY, 0);
+    if (fd < 0)
+    {
+        perror("shm_open");
+        return NULL;
+    }
+    MesureProfil mesure;
+    PROFIL_DEBUT(mesure);
+    ImagePGM *image = NULL;
+    TiCadre *cadre = projeter_cadre(fd, 0);
+    if (!cadre)
+    {
+        image = lecture_descripteur(fd);
+    }
+    else
+    {
+        close(fd);
+        image = calloc(1, sizeof(ImagePGM));
+        if (image)
+        {
+            image->largeur = cadre->entete->largeur;
+            image->hauteur = cadre->entete->hauteur;
+            image->max_val = cadre->entete->max_val;
+            image->data = (unsigned char *)cadre->entete + TI_ENTETE_CADRE;
+            image->projection = cadre->entete;
+            image->taille_projection = cadre->taille;
+        }
+        else
+        {
+            munmap(cadre->entete, cadre->taille);
+        }
+        free(cadre);
+    }
+    PROFIL_FIN(mesure, "lecture");
+    return image;
+}
+
+//! crée ou remplace le cadre nom; retourne 0 si l'image y est entièrement écrite
+int enregister_partagee(const char *nom, ImagePGM *image)
+{
+    MesureProfil mesure;
+    PROFIL_DEBUT(mesure);
+    TiCadre *cadre = ti_cadre_creer(nom, image->largeur, image->hauteur, image->max_val);
+    if (!cadre)
+    {
+        perror("shm");
+        return -1;
+    }
+    memcpy((unsigned char *)cadre->entete + TI_ENTETE_CADRE, image->data, (size_t)image->largeur * image->hauteur * octets_par_pixel(image));
+    ti_cadre_publier(cadre);
+    ti_cadre_fermer(cadre);
+    PROFIL_FIN(mesure, "enregister_pgm");
+    return 0;
+}
+/*-------------------------------------------
+//? FONCTION DE CRÉATION D'IMAGE
+//? creer_image_pgm: pixels non initialisés, pour les opérations qui écrivent chaque pixel
+//? init_image_pgm: image noire
+---------------------------------------------*/
+ImagePGM *creer_image_pgm(int hauteur, int largeur, int max_val)
+{
+    MesureProfil mesure;
+    PROFIL_DEBUT(mesure);
+    /*-------------------------------------------
+    //? LIBERATION DE L'ESPACE MEMOIRE POUR CONTENIR LES INFOS DE L'IMAGE
+    ---------------------------------------------*/
+    ImagePGM *image = calloc(1, sizeof(ImagePGM));
+    if (!image)
+    {
+        perror("cannot allocate memory");
+        return NULL;
+    }
+    //? RÉCUPÉRATION DES PARAMÈTRES DE L'IMAGE
+    image->hauteur = hauteur;
+    image->largeur = largeur;
+    image->max_val = max_val;
+
+    /*-------------------------------------------
+    //? TAMPON DES DONNEES DE L'IMAGE, RECYCLÉ PAR LE POOL
+    ---------------------------------------------*/
+    image->data = obtenir_tampon(largeur, hauteur, octets_par_pixel(image));
+    if (!image->data)
+    {
+        free(image);
+        perror("ne peut pas allouer la mémoire à l'image");
+        return NULL;
+    }
+    image->depuis_pool = 1;
+    PROFIL_FIN(mesure, "allocation");
+    return image;
+}
+
+ImagePGM *init_image_pgm(int hauteur, int largeur, int max_val)
+{
+    ImagePGM *image_noir = creer_image_pgm(hauteur, largeur, max_val);
+    if (image_noir)
+    {
+        MesureProfil mesure;
+        PROFIL_DEBUT(mesure);
+        memset(image_noir->data, 0, taille_tampon(largeur, hauteur, octets_par_pixel(image_noir)));
+        PROFIL_FIN(mesure, "mise_a_zero");
+    }
+    return image_noir;
+}
+
+/*-------------------------------------------
+//? FONCTION DE LIBÉRATION DE L'ESPACE MÉMOIRE UTILISÉ POUR MANIPULER L'IMAGE
+---------------------------------------------*/
+void liberer_une_image(ImagePGM *image)
+{
+    if (image)
+    {
+        if (image->projection)
+            munmap(image->projection, image->taille_projection);
+        else if (image->depuis_pool)
+            rendre_tampon(image->data, image->largeur, image->hauteur, octets_par_pixel(image));
+        else
+            free(image->data);
+        free(image);
+    }
+}
+/*-------------------------------------------
+//? NOYAUX VECTORIELS DES OPÉRATIONS PONCTUELLES
+//? une version scalaire, SSE2 (16 pixels) et AVX2 (32 pixels) de chaque noyau;
+//? la meilleure version supportée par le processeur est choisie au démarrage (CPUID).
+---------------------------------------------*/
+typedef struct
+{
+    const char *nom;
+    void (*somme)(const unsigned char *a, const unsigned char *b, unsigned char *dst, size_t n, unsigned char max_val);
+    void (*difference)(const unsigned char *a, const unsigned char *b, unsigned char *dst, size_t n);
+    void (*luminosite)(const unsigned char *src, unsigned char *dst, size_t n, int facteur, unsigned char max_val);
+    void (*seuil)(const unsigned char *src, unsigned char *dst, size_t n, unsigned char seuil, unsigned char max_val);
+    void (*min_max)(const unsigned char *src, size_t n, unsigned char *min, unsigned char *max);
+    void (*table)(const unsigned char *src, unsigned char *dst, size_t n, const unsigned char *table);
+} NoyauxPonctuels;
+
+//! versions scalaires (aussi utilisées pour la fin des tableaux vectorisés), définies pour
+//! un type de pixel: _scalaire sur 8 bits, _16 sur 16 bits (vectorisées par le compilateur)
+#define DEFINIR_NOYAUX_SCALAIRES(suffixe, pixel)                                                            \
+    static void somme_##suffixe(const pixel *a, const pixel *b, pixel *dst, size_t n, pixel max_val)       \
+    {                                                                                                       \
+        for (size_t i = 0; i < n; i++)                                                                      \
+        {                                                                                                   \
+            int v = a[i] + b[i];                                                                            \
+            dst[i] = (v > max_val) ? max_val : v;                                                           \
+        }                                                                                                   \
+    }                                                                                                       \
+                                                                                                            \
+    static void difference_##suffixe(const pixel *a, const pixel *b, pixel *dst, size_t n)                 \
+    {                                                                                                       \
+        for (size_t i = 0; i < n; i++)                                                                      \
+        {                                                                                                   \
+            int v = a[i] - b[i];                                                                            \
+            dst[i] = (v < 0) ? 0 : v;                                                                       \
+        }                                                                                                   \
+    }                                                                                                       \
+                                                                                                            \
+    static void luminosite_##suffixe(const pixel *src, pixel *dst, size_t n, int facteur, pixel max_val)   \
+    {                                                                                                       \
+        for (size_t i = 0; i < n; i++)                                                                      \
+        {                                                                                                   \
+            int v = src[i] + facteur;                                                                       \
+            if (v > max_val)                                                                                \
+                v = max_val;                                                                                \
+            if (v < 0)                                                                                      \
+                v = 0;                                                                                      \
+            dst[i] = v;                                                                                     \
+        }                                                                                                   \
+    }                                                                                                       \
+                                                                                                            \
+    static void seuil_##suffixe(const pixel *src, pixel *dst, size_t n, pixel seuil, pixel max_val)        \
+    {                                                                                                       \
+        for (size_t i = 0; i < n; i++)                                                                      \
+        {                                                                                                   \
+            dst[i] = (src[i] < seuil) ? 0 : max_val;                                                        \
+        }                                                                                                   \
+    }                                                                                                       \
+                                                                                                            \
+    static void min_max_##suffixe(const pixel *src, size_t n, pixel *min, pixel *max)                      \
+    {                                                                                                       \
+        for (size_t i = 0; i < n; i++)                                                                      \
+        {                                                                                                   \
+            if (src[i] < *min)                                                                              \
+                *min = src[i];                                                                              \
+            if (src[i] > *max)                                                                              \
+                *max = src[i];                                                                              \
+        }                                                                                                   \
+    }                                                                                                       \
+                                                                                                            \
+    static void table_##suffixe(const pixel *src, pixel *dst, size_t n, const pixel *table)                \
+    {                                                                                                       \
+        size_t i = 0;                                                                                       \
+        for (; i + 4 <= n; i += 4)                                                                          \
+        {                                                                                                   \
+            pixel v0 = table[src[i]], v1 = table[src[i + 1]];                                               \
+            pixel v2 = table[src[i + 2]], v3 = table[src[i + 3]];                                           \
+            dst[i] = v0;                                                                                    \
+            dst[i + 1] = v1;                                                                                \
+            dst[i + 2] = v2;                                                                                \
+            dst[i + 3] = v3;                                                                                \
+        }                                                                                                   \
+        for (; i < n; i++)                                                                                  \
+        {                                                                                                   \
+            dst[i] = table[src[i]];                                                                         \
+        }                                                                                                   \
+    }
+
+DEFINIR_NOYAUX_SCALAIRES(scalaire, unsigned char)
+DEFINIR_NOYAUX_SCALAIRES(16, unsigned short)
+
+const NoyauxPonctuels NOYAUX_SCALAIRES = {"scalaire", somme_scalaire, difference_scalaire, luminosite_scalaire, seuil_scalaire, min_max_scalaire, table_scalaire};
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+//! SSE2: 16 pixels par instruction
+__attribute__((target("sse2"))) static void somme_sse2(const unsigned char *a, const unsigned char *b, unsigned char *dst, size_t n, unsigned char max_val)
+{
+    __m128i vmax = _mm_set1_epi8((char)max_val);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i v = _mm_adds_epu8(_mm_loadu_si128((const __m128i *)(a + i)), _mm_loadu_si128((const __m128i *)(b + i)));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_min_epu8(v, vmax));
+    }
+    somme_scalaire(a + i, b + i, dst + i, n - i, max_val);
+}
+
+__attribute__((target("sse2"))) static void difference_sse2(const unsigned char *a, const unsigned char *b, unsigned char *dst, size_t n)
+{
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i v = _mm_subs_epu8(_mm_loadu_si128((const __m128i *)(a + i)), _mm_loadu_si128((const __m128i *)(b + i)));
+        _mm_storeu_si128((__m128i *)(dst + i), v);
+    }
+    difference_scalaire(a + i, b + i, dst + i, n - i);
+}
+
+__attribute__((target("sse2"))) static void luminosite_sse2(const unsigned char *src, unsigned char *dst, size_t n, int facteur, unsigned char max_val)
+{
+    int amplitude = abs(facteur) > 255 ? 255 : abs(facteur);
+    __m128i vfacteur = _mm_set1_epi8((char)amplitude);
+    __m128i vmax = _mm_set1_epi8((char)max_val);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        v = (facteur >= 0) ? _mm_adds_epu8(v, vfacteur) : _mm_subs_epu8(v, vfacteur);
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_min_epu8(v, vmax));
+    }
+    luminosite_scalaire(src + i, dst + i, n - i, facteur, max_val);
+}
+
+__attribute__((target("sse2"))) static void seuil_sse2(const unsigned char *src, unsigned char *dst, size_t n, unsigned char seuil, unsigned char max_val)
+{
+    //? x >= seuil  <=>  max(x, seuil) == x  (comparaison non signée)
+    __m128i vseuil = _mm_set1_epi8((char)seuil);
+    __m128i vmax = _mm_set1_epi8((char)max_val);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i masque = _mm_cmpeq_epi8(_mm_max_epu8(v, vseuil), v);
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_and_si128(masque, vmax));
+    }
+    seuil_scalaire(src + i, dst + i, n - i, seuil, max_val);
+}
+
+__attribute__((target("sse2"))) static void min_max_sse2(const unsigned char *src, size_t n, unsigned char *min, unsigned char *max)
+{
+    size_t i = 0;
+    if (n >= 16)
+    {
+        __m128i vmin = _mm_set1_epi8((char)*min);
+        __m128i vmax = _mm_set1_epi8((char)*max);
+        for (; i + 16 <= n; i += 16)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+            vmin = _mm_min_epu8(vmin, v);
+            vmax = _mm_max_epu8(vmax, v);
+        }
+        unsigned char lmin[16], lmax[16];
+        _mm_storeu_si128((__m128i *)lmin, vmin);
+        _mm_storeu_si128((__m128i *)lmax, vmax);
+        min_max_scalaire(lmin, 16, min, max);
+        min_max_scalaire(lmax, 16, min, max);
+    }
+    min_max_scalaire(src + i, n - i, min, max);
+}
+
+//? pas de pshufb en SSE2 (SSSE3): la table reste scalaire
+const NoyauxPonctuels NOYAUX_SSE2 = {"sse2", somme_sse2, difference_sse2, luminosite_sse2, seuil_sse2, min_max_sse2, table_scalaire};
+
+//! AVX2: 32 pixels par instruction
+__attribute__((target("avx2"))) static void somme_avx2(const unsigned char *a, const unsigned char *b, unsigned char *dst, size_t n, unsigned char max_val)
+{
+    __m256i vmax = _mm256_set1_epi8((char)max_val);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        __m256i v = _mm256_adds_epu8(_mm256_loadu_si256((const __m256i *)(a + i)), _mm256_loadu_si256((const __m256i *)(b + i)));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_min_epu8(v, vmax));
+    }
+    somme_scalaire(a + i, b + i, dst + i, n - i, max_val);
+}
+
+__attribute__((target("avx2"))) static void difference_avx2(const unsigned char *a, const unsigned char *b, unsigned char *dst, size_t n)
+{
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        __m256i v = _mm256_subs_epu8(_mm256_loadu_si256((const __m256i *)(a + i)), _mm256_loadu_si256((const __m256i *)(b + i)));
+        _mm256_storeu_si256((__m256i *)(dst + i), v);
+    }
+    difference_scalaire(a + i, b + i, dst + i, n - i);
+}
+
+__attribute__((target("avx2"))) static void luminosite_avx2(const unsigned char *src, unsigned char *dst, size_t n, int facteur, unsigned char max_val)
+{
+    int amplitude = abs(facteur) > 255 ? 255 : abs(facteur);
+    __m256i vfacteur = _mm256_set1_epi8((char)amplitude);
+    __m256i vmax = _mm256_set1_epi8((char)max_val);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+        v = (facteur >= 0) ? _mm256_adds_epu8(v, vfacteur) : _mm256_subs_epu8(v, vfacteur);
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_min_epu8(v, vmax));
+    }
+    luminosite_scalaire(src + i, dst + i, n - i, facteur, max_val);
+}
+
+__attribute__((target("avx2"))) static void seuil_avx2(const unsigned char *src, unsigned char *dst, size_t n, unsigned char seuil, unsigned char max_val)
+{
+    __m256i vseuil = _mm256_set1_epi8((char)seuil);
+    __m256i vmax = _mm256_set1_epi8((char)max_val);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+        __m256i masque = _mm256_cmpeq_epi8(_mm256_max_epu8(v, vseuil), v);
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_and_si256(masque, vmax));
+    }
+    seuil_scalaire(src + i, dst + i, n - i, seuil, max_val);
+}
+
+__attribute__((target("avx2"))) static void min_max_avx2(const unsigned char *src, size_t n, unsigned char *min, unsigned char *max)
+{
+    size_t i = 0;
+    if (n >= 32)
+    {
+        __m256i vmin = _mm256_set1_epi8((char)*min);
+        __m256i vmax = _mm256_set1_epi8((char)*max);
+        for (; i + 32 <= n; i += 32)
+        {
+            __m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+            vmin = _mm256_min_epu8(vmin, v);
+            vmax = _mm256_max_epu8(vmax, v);
+        }
+        unsigned char lmin[32], lmax[32];
+        _mm256_storeu_si256((__m256i *)lmin, vmin);
+        _mm256_storeu_si256((__m256i *)lmax, vmax);
+        min_max_scalaire(lmin, 32, min, max);
+        min_max_scalaire(lmax, 32, min, max);
+    }
+    min_max_scalaire(src + i, n - i, min, max);
+}
+
+//! table de 256 entrées: 16 sous-tables de 16 octets indexées par le quartet bas (vpshufb).
+//! pour la sous-table h, l'index x - 16h est saturé à +0x70: il garde son quartet bas si le
+//! quartet haut de x vaut h, sinon son bit 7 est levé et vpshufb écrit 0
+__attribute__((target("avx2"))) static void table_avx2(const unsigned char *src, unsigned char *dst, size_t n, const unsigned char *table)
+{
+    __m256i sous_tables[16];
+    for (int h = 0; h < 16; h++)
+    {
+        sous_tables[h] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)(table + 16 * h)));
+    }
+    __m256i decalage = _mm256_set1_epi8(0x70);
+    __m256i seize = _mm256_set1_epi8(16);
+    size_t i = 0;
+    //? deux vecteurs entrelacés pour masquer la latence des chaînes sub/or
+    for (; i + 64 <= n; i += 64)
+    {
+        __m256i v0 = _mm256_loadu_si256((const __m256i *)(src + i));
+        __m256i v1 = _mm256_loadu_si256((const __m256i *)(src + i + 32));
+        __m256i r0 = _mm256_setzero_si256(), r1 = _mm256_setzero_si256();
+#pragma GCC unroll 16
+        for (int h = 0; h < 16; h++)
+        {
+            r0 = _mm256_or_si256(r0, _mm256_shuffle_epi8(sous_tables[h], _mm256_adds_epu8(v0, decalage)));
+            r1 = _mm256_or_si256(r1, _mm256_shuffle_epi8(sous_tables[h], _mm256_adds_epu8(v1, decalage)));
+            v0 = _mm256_sub_epi8(v0, seize);
+            v1 = _mm256_sub_epi8(v1, seize);
+        }
+        _mm256_storeu_si256((__m256i *)(dst + i), r0);
+        _mm256_storeu_si256((__m256i *)(dst + i + 32), r1);
+    }
+    table_scalaire(src + i, dst + i, n - i, table);
+}
+
+const NoyauxPonctuels NOYAUX_AVX2 = {"avx2", somme_avx2, difference_avx2, luminosite_avx2, seuil_avx2, min_max_avx2, table_avx2};
+#endif
+
+/*-------------------------------------------
+//? CHOIX DES NOYAUX SELON LE PROCESSEUR (CPUID)
+//? la variable d'environnement PGM_SIMD=scalaire|sse2|avx2 force une version
+---------------------------------------------*/
+const NoyauxPonctuels *noyaux_ponctuels(void)
+{
+    static const NoyauxPonctuels *choisis = NULL;
+    if (choisis)
+        return choisis;
+
+    const char *force = getenv("PGM_SIMD");
+    choisis = &NOYAUX_SCALAIRES;
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && (!force || strcmp(force, "avx2") == 0))
+        choisis = &NOYAUX_AVX2;
+    else if (__builtin_cpu_supports("sse2") && (!force || strcmp(force, "scalaire") != 0))
+        choisis = &NOYAUX_SSE2;
+#endif
+    if (force && strcmp(force, "scalaire") == 0)
+        choisis = &NOYAUX_SCALAIRES;
+    return choisis;
+}
+
+/*-------------------------------------------
+//? APPLICATION D'UN NOYAU PONCTUEL PAR BANDES DE LIGNES
+---------------------------------------------*/
+typedef enum
+{
+    PONCTUEL_SOMME,
+    PONCTUEL_DIFFERENCE,
+    PONCTUEL_LUMINOSITE,
+    PONCTUEL_SEUIL,
+    PONCTUEL_TABLE,
+    PONCTUEL_MIN_MAX,
+    PONCTUEL_CONTRASTE,   //* étapes dont la table dépend de l'histogramme de leur entrée
+    PONCTUEL_EGALISATION,
+    PONCTUEL_OTSU,
+    PONCTUEL_AUCUNE
+} OperationPonctuelle;
+
+typedef struct
+{
+    OperationPonctuelle operation;
+    const unsigned char *a;
+    const unsigned char *b;
+    unsigned char *dst;
+    int largeur;
+    int parametre;
+    int max_val;
+    const void *table; //! niveaux du type de pixel
+    int seize;         //! pixels de 16 bits: noyaux scalaires _16
+    //? réduction min/max: résultats partiels fusionnés sous verrou
+    pthread_mutex_t verrou;
+    int min;
+    int max;
+} ContextePonctuel;
+
+//! 16 bits: mêmes opérations sur des unsigned short
+static void ponctuel_bande_16(ContextePonctuel *c, size_t premier, size_t n)
+{
+    const unsigned short *a = (const unsigned short *)c->a + premier;
+    const unsigned short *b = (const unsigned short *)c->b + premier;
+    unsigned short *dst = (unsigned short *)c->dst + premier;
+
+    switch (c->operation)
+    {
+    case PONCTUEL_SOMME:
+        somme_16(a, b, dst, n, c->max_val);
+        break;
+    case PONCTUEL_DIFFERENCE:
+        difference_16(a, b, dst, n);
+        break;
+    case PONCTUEL_LUMINOSITE:
+        luminosite_16(a, dst, n, c->parametre, c->max_val);
+        break;
+    case PONCTUEL_SEUIL:
+        seuil_16(a, dst, n, c->parametre, c->max_val);
+        break;
+    case PONCTUEL_TABLE:
+        table_16(a, dst, n, c->table);
+        break;
+    case PONCTUEL_MIN_MAX:
+    {
+        unsigned short min = a[0];
+        unsigned short max = a[0];
+        min_max_16(a, n, &min, &max);
+        pthread_mutex_lock(&c->verrou);
+        if (min < c->min)
+            c->min = min;
+        if (max > c->max)
+            c->max = max;
+        pthread_mutex_unlock(&c->verrou);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+static void ponctuel_bande(void *contexte, int debut, int fin)
+{
+    ContextePonctuel *c = contexte;
+    const NoyauxPonctuels *noyaux = noyaux_ponctuels();
+    size_t premier = (size_t)debut * c->largeur;
+    size_t n = (size_t)(fin - debut) * c->largeur;
+
+    if (c->seize)
+    {
+        ponctuel_bande_16(c, premier, n);
+        return;
+    }
+    switch (c->operation)
+    {
+    case PONCTUEL_SOMME:
+        noyaux->somme(c->a + premier, c->b + premier, c->dst + premier, n, c->max_val);
+        break;
+    case PONCTUEL_DIFFERENCE:
+        noyaux->difference(c->a + premier, c->b + premier, c->dst + premier, n);
+        break;
+    case PONCTUEL_LUMINOSITE:
+        noyaux->luminosite(c->a + premier, c->dst + premier, n, c->parametre, c->max_val);
+        break;
+    case PONCTUEL_SEUIL:
+        noyaux->seuil(c->a + premier, c->dst + premier, n, c->parametre, c->max_val);
+        break;
+    case PONCTUEL_TABLE:
+        noyaux->table(c->a + premier, c->dst + premier, n, c->table);
+        break;
+    case PONCTUEL_CONTRASTE:
+    case PONCTUEL_EGALISATION:
+    case PONCTUEL_OTSU:
+    case PONCTUEL_AUCUNE:
+        //? étapes de chaîne seulement: elles sont d'abord converties en table
+        break;
+    case PONCTUEL_MIN_MAX:
+    {
+        unsigned char min = c->a[premier];
+        unsigned char max = c->a[premier];
+        noyaux->min_max(c->a + premier, n, &min, &max);
+        pthread_mutex_lock(&c->verrou);
+        if (min < c->min)
+            c->min = min;
+        if (max > c->max)
+            c->max = max;
+        pthread_mutex_unlock(&c->verrou);
+        break;
+    }
+    }
+}
+
+void appliquer_ponctuel(ContextePonctuel *contexte, int hauteur)
+{
+    if (contexte->operation == PONCTUEL_MIN_MAX)
+    {
+        pthread_mutex_init(&contexte->verrou, NULL);
+        contexte->min = contexte->seize ? NIVEAUX_16_BITS - 1 : NIVEAUX_8_BITS - 1;
+        contexte->max = 0;
+    }
+    executer_par_bandes(hauteur, ponctuel_bande, contexte);
+    if (contexte->operation == PONCTUEL_MIN_MAX)
+        pthread_mutex_destroy(&contexte->verrou);
+}
+
+/*-------------------------------------------
+//? TABLES DE CORRESPONDANCE (LUT) DES OPÉRATIONS PONCTUELLES
+//? toute opération ponctuelle est une table d'une entrée par niveau du type de pixel
+//? (256 octets sur 8 bits, 65536 unsigned short sur 16 bits, selon max_val); deux tables
+//? se composent en une seule, et l'application est une recherche vectorisée par pixel
+---------------------------------------------*/
+static inline int niveaux_table(int max_val)
+{
+    return (max_val > 255) ? NIVEAUX_16_BITS : NIVEAUX_8_BITS;
+}
+
+void table_luminosite(void *table, int facteur, int max_val)
+{
+    int seize = max_val > 255;
+    for (int v = 0; v < niveaux_table(max_val); v++)
+    {
+        int l = v + facteur;
+        PIXEL_ECRIRE(table, v, (l > max_val) ? max_val : (l < 0) ? 0 : l, seize);
+    }
+}
+
+void table_seuil(void *table, int seuil, int max_val)
+{
+    int seize = max_val > 255;
+    for (int v = 0; v < niveaux_table(max_val); v++)
+    {
+        PIXEL_ECRIRE(table, v, (v < seuil) ? 0 : max_val, seize);
+    }
+}
+
+//! étirement linéaire de [min, max] sur [0, max_val]; identité si min == max
+void table_contraste(void *table, int min, int max, int max_val)
+{
+    int seize = max_val > 255;
+    for (int v = 0; v < niveaux_table(max_val); v++)
+    {
+        if (max == min)
+            PIXEL_ECRIRE(table, v, v, seize);
+        else
+            PIXEL_ECRIRE(table, v, (v < min || v > max) ? 0 : (int)((long long)max_val * (v - min) / (max - min)), seize);
+    }
+}
+
+//! resultat[v] = seconde[premiere[v]] (resultat peut être la première table)
+void composer_tables(const void *premiere, const void *seconde, void *resultat, int max_val)
+{
+    int seize = max_val > 255;
+    for (int v = 0; v < niveaux_table(max_val); v++)
+    {
+        PIXEL_ECRIRE(resultat, v, PIXEL_LIRE(seconde, PIXEL_LIRE(premiere, v, seize), seize), seize);
+    }
+}
+
+//! table d'une entrée par niveau du type de pixel de max_val (à libérer)
+void *creer_table(int max_val)
+{
+    void *table = malloc((size_t)niveaux_table(max_val) * ((max_val > 255) ? 2 : 1));
+    if (!table)
+        perror("cannot allocate memory");
+    return table;
+}
+
+void appliquer_table(ImagePGM *image, ImagePGM *sortie, const void *table)
+{
+    ContextePonctuel contexte = {.operation = PONCTUEL_TABLE, .a = image->data, .dst = sortie->data, .largeur = image->largeur, .table = table, .seize = image_16_bits(image)};
+    appliquer_ponctuel(&contexte, image->hauteur);
+}
+
+/*-------------------------------------------
+//? FONCTION DE SOMME DE DEUX IMAGES
+---------------------------------------------*/
+ImagePGM *somme_images(ImagePGM *image1, ImagePGM *image2)
+{
+    if (image1->hauteur != image2->hauteur || image1->largeur != image2->largeur)
+    {
+        printf("\nles hauteurs ou les largeurs de vos deux images ne correspondent pas\n");
+        return NULL;
+    }
+    if (image_16_bits(image1) != image_16_bits(image2))
+    {
+        printf("\nvos deux images n'ont pas la même profondeur (8 ou 16 bits)\n");
+        return NULL;
+    }
+    ImagePGM *somme = creer_image_pgm(image1->hauteur, image1->largeur, image1->max_val);
+    if (!somme)
+        return NULL;
+    ContextePonctuel contexte = {.operation = PONCTUEL_SOMME, .a = image1->data, .b = image2->data, .dst = somme->data, .largeur = somme->largeur, .max_val = somme->max_val, .seize = image_16_bits(somme)};
+    appliquer_ponctuel(&contexte, somme->hauteur);
+    return somme;
+}
+
+/*-------------------------------------------
+//? FONCTION DE DIFFÉRENCE DE DEUX IMAGES
+---------------------------------------------*/
+ImagePGM *difference_images(ImagePGM *image1, ImagePGM *image2)
+{
+    if (image1->hauteur != image2->hauteur || image1->largeur != image2->largeur)
+    {
+        printf("\nles hauteurs ou les largeurs de vos deux images ne correspondent pas\n");
+        return NULL;
+    }
+    if (image_16_bits(image1) != image_16_bits(image2))
+    {
+        printf("\nvos deux images n'ont pas la même profondeur (8 ou 16 bits)\n");
+        return NULL;
+    }
+    ImagePGM *somme = creer_image_pgm(image1->hauteur, image1->largeur, image1->max_val);
+    if (!somme)
+        return NULL;
+    ContextePonctuel contexte = {.operation = PONCTUEL_DIFFERENCE, .a = image1->data, .b = image2->data, .dst = somme->data, .largeur = somme->largeur, .seize = image_16_bits(somme)};
+    appliquer_ponctuel(&contexte, somme->hauteur);
+    return somme;
+}
+
+/*-------------------------------------------
+//? FONCTION D'AUGMENTATION DE LA LUMINOSITÉ
+---------------------------------------------*/
+ImagePGM *modifier_luminosite(ImagePGM *image, int facteur)
+{
+    ImagePGM *intensity_image = creer_image_pgm(image->hauteur, image->largeur, image->max_val);
+    if (!intensity_image)
+        return NULL;
+    ContextePonctuel contexte = {.operation = PONCTUEL_LUMINOSITE, .a = image->data, .dst = intensity_image->data, .largeur = image->largeur, .parametre = facteur, .max_val = image->max_val, .seize = image_16_bits(image)};
+    appliquer_ponctuel(&contexte, image->hauteur);
+    return intensity_image;
+}
+
+/*-------------------------------------------
+//? FONCTION D'AMÉLIORATION DU CONTRASTE
+---------------------------------------------*/
+int contraste_dans(ImagePGM *image, ImagePGM *contrast_image)
+{
+    size_t nb_octets = (size_t)image->largeur * image->hauteur * octets_par_pixel(image);
+
+    //! DÉTERMINATION DU MIN ET DU MAX (réduction vectorielle par bandes)
+    ContextePonctuel reduction = {.operation = PONCTUEL_MIN_MAX, .a = image->data, .largeur = image->largeur, .seize = image_16_bits(image)};
+    appliquer_ponctuel(&reduction, image->hauteur);
+    int min = reduction.min;
+    int max = reduction.max;
+    if (max == min)
+    {
+        //? image uniforme: pas d'étirement possible
+        memcpy(contrast_image->data, image->data, nb_octets);
+        return 0;
+    }
+
+    //! APPLICATION DE LA FONCTION DE MODIFICATION DU CONTRAST (une division par niveau, pas par pixel)
+    void *table = creer_table(image->max_val);
+    if (!table)
+        return -1;
+    table_contraste(table, min, max, image->max_val);
+    appliquer_table(image, contrast_image, table);
+    free(table);
+    return 0;
+}
+
+ImagePGM *modification_basique_du_contraste(ImagePGM *image)
+{
+    ImagePGM *contrast_image = creer_image_pgm(image->hauteur, image->largeur, image->max_val);
+    if (!contrast_image)
+        return NULL;
+    if (contraste_dans(image, contrast_image) != 0)
+    {
+        liberer_une_image(contrast_image);
+        return NULL;
+    }
+    return contrast_image;
+}
+
+/*-------------------------------------------
+//? HISTOGRAMME D'UNE IMAGE
+//? chaque bande compte dans ses propres sous-histogrammes, fusionnés à la fin sous verrou.
+//? les pixels consécutifs vont dans NB_COMPTEURS_HISTOGRAMME tables différentes: deux
+//? pixels égaux qui se suivent n'incrémentent pas la même case (pas de dépendance
+//? écriture puis lecture entre itérations). Sur 16 bits, 65536 cases: un seul
+//? histogramme privé par bande, les collisions entre pixels voisins y sont rares.
+---------------------------------------------*/
+#define NB_COMPTEURS_HISTOGRAMME 4
+
+typedef struct
+{
+    ImagePGM *image;
+    unsigned int *hist; //! une case par niveau du type de pixel
+    pthread_mutex_t verrou;
+    int echec; //! une bande n'a pas pu compter ses pixels: l'histogramme est partiel
+} ContexteHistogramme;
+
+static void histogramme_bande_8(void *contexte, int debut, int fin)
+{
+    ContexteHistogramme *c = contexte;
+    unsigned int compteurs[NB_COMPTEURS_HISTOGRAMME][256];
+    memset(compteurs, 0, sizeof(compteurs));
+
+    const unsigned char *p = c->image->data + get_position(debut, 0, c->image->largeur);
+    size_t n = (size_t)(fin - debut) * c->image->largeur;
+    size_t k = 0;
+    for (; k + NB_COMPTEURS_HISTOGRAMME <= n; k += NB_COMPTEURS_HISTOGRAMME)
+    {
+        compteurs[0][p[k]]++;
+        compteurs[1][p[k + 1]]++;
+        compteurs[2][p[k + 2]]++;
+        compteurs[3][p[k + 3]]++;
+    }
+    for (; k < n; k++)
+    {
+        compteurs[0][p[k]]++;
+    }
+
+    pthread_mutex_lock(&c->verrou);
+    for (int v = 0; v < 256; v++)
+    {
+        c->hist[v] += compteurs[0][v] + compteurs[1][v] + compteurs[2][v] + compteurs[3][v];
+    }
+    pthread_mutex_unlock(&c->verrou);
+}
+
+static void histogramme_bande_16(void *contexte, int debut, int fin)
+{
+    ContexteHistogramme *c = contexte;
+    unsigned int *compteurs = calloc(NIVEAUX_16_BITS, sizeof(unsigned int));
+    if (!compteurs)
+    {
+        perror("cannot allocate memory");
+        pthread_mutex_lock(&c->verrou);
+        c->echec = 1;
+        pthread_mutex_unlock(&c->verrou);
+        return;
+    }
+    const unsigned short *p = (const unsigned short *)ligne_image(c->image, debut);
+    size_t n = (size_t)(fin - debut) * c->image->largeur;
+    for (size_t k = 0; k < n; k++)
+    {
+        compteurs[p[k]]++;
+    }
+
+    pthread_mutex_lock(&c->verrou);
+    for (int v = 0; v < NIVEAUX_16_BITS; v++)
+    {
+        c->hist[v] += compteurs[v];
+    }
+    pthread_mutex_unlock(&c->verrou);
+    free(compteurs);
+}
+
+//! histogramme dans un tableau fourni de niveaux_pixel(image) cases; -1 si une bande a échoué
+int histogramme_dans(ImagePGM *image, unsigned int *hist)
+{
+    memset(hist, 0, niveaux_pixel(image) * sizeof(unsigned int));
+    ContexteHistogramme contexte = {.image = image, .hist = hist, .verrou = PTHREAD_MUTEX_INITIALIZER};
+    executer_par_bandes(image->hauteur, image_16_bits(image) ? histogramme_bande_16 : histogramme_bande_8, &contexte);
+    pthread_mutex_destroy(&contexte.verrou);
+    return contexte.echec ? -1 : 0;
+}
+
+//! histogramme alloué (à libérer), niveaux_pixel(image) cases
+unsigned int *creer_histogramme(ImagePGM *image)
+{
+    unsigned int *hist = malloc(niveaux_pixel(image) * sizeof(unsigned int));
+    if (!hist)
+    {
+        perror("cannot allocate memory");
+        return NULL;
+    }
+    if (histogramme_dans(image, hist) != 0)
+    {
+        free(hist);
+        return NULL;
+    }
+    return hist;
+}
+
+//! une case par niveau de 0 à max_val inclus
+int *histogramme(ImagePGM *image)
+{
+    int *hist = malloc((image->max_val + 1) * sizeof(int));
+    unsigned int *comptes = creer_histogramme(image);
+    if (!hist || !comptes)
+    {
+        free(hist);
+        free(comptes);
+        return NULL;
+    }
+    for (int v = 0; v <= image->max_val; v++)
+    {
+        hist[v] = comptes[v];
+    }
+    free(comptes);
+    return hist;
+}
+
+/*-------------------------------------------
+//? FONCTION D'APPLANISSEMENT DE L'HISTOGRAMME
+---------------------------------------------*/
+void table_egalisation(void *table, const unsigned int *hist, int max_val)
+{
+    if (max_val > 255)
+    {
+        //? 16 bits: densité cumulée en double, étalée sur [0, max_val]
+        unsigned long long nb_pixels = 0;
+        for (int v = 0; v < NIVEAUX_16_BITS; v++)
+        {
+            nb_pixels += hist[v];
+        }
+        double cumul = 0.0;
+        for (int v = 0; v < NIVEAUX_16_BITS; v++)
+        {
+            if (v < max_val)
+                cumul += hist[v] / (double)nb_pixels;
+            PIXEL_ECRIRE(table, v, (v < max_val) ? (int)(cumul * max_val) : max_val, 1);
+        }
+        return;
+    }
+
+    //*Etape 2 et 3 : histogramme normalisé et densité cumulée, en une passe sur les niveaux
+    unsigned char *table_8 = table;
+    unsigned int nb_pixels = 0;
+    for (int v = 0; v < 256; v++)
+    {
+        nb_pixels += hist[v];
+    }
+    float total = (float)nb_pixels;
+    float densite[256];
+    float cumul = 0.0;
+    for (int i = 0; i < max_val; i++)
+    {
+        cumul += hist[i] / total;
+        densite[i] = cumul;
+    }
+
+    //*Etape 4 : Transformation des niveaux de gris de l'image
+    for (int v = 0; v < 256; v++)
+    {
+        table_8[v] = (v < max_val) ? (unsigned char)(densite[v] * 255) : 255;
+    }
+}
+
+int egaliser_histogramme_dans(ImagePGM *image, ImagePGM *hist_equal)
+{
+    //*Etape 1 : Calcul de l'histogramme
+    unsigned int *hist = creer_histogramme(image);
+    void *table = creer_table(image->max_val);
+    if (hist && table)
+    {
+        table_egalisation(table, hist, image->max_val);
+        appliquer_table(image, hist_equal, table);
+    }
+    int code = (hist && table) ? 0 : -1;
+    free(hist);
+    free(table);
+    return code;
+}
+
+ImagePGM *egaliser_histogramme(ImagePGM *image)
+{
+    ImagePGM *hist_equal = creer_image_pgm(image->hauteur, image->largeur, image->max_val);
+    if (!hist_equal)
+        return NULL;
+    if (egaliser_histogramme_dans(image, hist_equal) != 0)
+    {
+        liberer_une_image(hist_equal);
+        return NULL;
+    }
+    return hist_equal;
+}
+
+/*-------------------------------------------
+//? CLAHE: ÉGALISATION ADAPTATIVE À CONTRASTE LIMITÉ
+//? l'image est découpée en grille x grille tuiles; l'histogramme de chaque tuile est écrêté
+//? à limite fois sa hauteur moyenne, l'excédent redistribué sur tous les niveaux, puis
+//? transformé en table d'égalisation. Chaque pixel interpole bilinéairement les tables
+//? des quatre tuiles dont les centres l'entourent: coût par pixel indépendant de la taille
+//? des tuiles. Sur 16 bits, les tables ont max_val + 1 niveaux.
+---------------------------------------------*/
+#define GRILLE_CLAHE_DEFAUT 8
+#define LIMITE_CLAHE_DEFAUT 2.0
+
+typedef struct
+{
+    ImagePGM *image;
+    ImagePGM *sortie;
+    int grille;
+    double limite;
+    float hauteur_tuile; //! h / grille: la tuile ty couvre les lignes [ty h / grille, (ty + 1) h / grille[
+    float largeur_tuile;
+    int niveaux;           //! 256 sur 8 bits, max_val + 1 sur 16 bits
+    unsigned char *tables; //! grille x grille tables de niveaux pixels
+    int *colonne_gauche;   //! par colonne de pixel: tuiles voisines et poids de la droite
+    int *colonne_droite;
+    float *poids_droite;
+    int echec; //! une tâche n'a pas pu construire ses tables
+} ContexteClahe;
+
+//! tables des tuiles [debut, fin[, numérotées ligne de tuiles par ligne de tuiles
+//! (grille <= largeur, hauteur: aucune tuile n'est vide)
+SPECIALISE void clahe_tables_tuiles(void *contexte, int debut, int fin, const int seize)
+{
+    ContexteClahe *c = contexte;
+    int largeur = c->image->largeur, hauteur = c->image->hauteur;
+    int niveaux = c->niveaux;
+    unsigned int *hist = malloc(niveaux * sizeof(unsigned int));
+    if (!hist)
+    {
+        perror("cannot allocate memory");
+        __atomic_store_n(&c->echec, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    for (int t = debut; t < fin; t++)
+    {
+        int ty = t / c->grille, tx = t % c->grille;
+        int i0 = (int)((long long)ty * hauteur / c->grille);
+        int i1 = (int)((long long)(ty + 1) * hauteur / c->grille);
+        int j0 = (int)((long long)tx * largeur / c->grille);
+        int j1 = (int)((long long)(tx + 1) * largeur / c->grille);
+        unsigned char *table = c->tables + (size_t)t * niveaux * (seize ? 2 : 1);
+        int nb_pixels = (i1 - i0) * (j1 - j0);
+
+        memset(hist, 0, niveaux * sizeof(unsigned int));
+        for (int i = i0; i < i1; i++)
+        {
+            const unsigned char *ligne = ligne_image(c->image, i);
+            for (int j = j0; j < j1; j++)
+            {
+                int v = PIXEL_LIRE(ligne, j, seize);
+                hist[(v < niveaux) ? v : niveaux - 1]++;
+            }
+        }
+
+        //? écrêtage puis redistribution uniforme de l'excédent (le reste pas à pas)
+        unsigned int plafond = (unsigned int)(c->limite * nb_pixels / niveaux);
+        if (plafond < 1)
+            plafond = 1;
+        unsigned int excedent = 0;
+        for (int v = 0; v < niveaux; v++)
+        {
+            if (hist[v] > plafond)
+            {
+                excedent += hist[v] - plafond;
+                hist[v] = plafond;
+            }
+        }
+        unsigned int part = excedent / niveaux, reste = excedent % niveaux;
+        for (int v = 0; v < niveaux; v++)
+        {
+            hist[v] += part;
+        }
+        if (reste > 0)
+        {
+            int pas = niveaux / reste;
+            for (int v = 0; v < niveaux && reste > 0; v += pas, reste--)
+            {
+                hist[v]++;
+            }
+        }
+
+        unsigned int cumul = 0;
+        for (int v = 0; v < niveaux; v++)
+        {
+            cumul += hist[v];
+            int valeur = (int)((double)cumul * c->image->max_val / nb_pixels + 0.5);
+            PIXEL_ECRIRE(table, v, (valeur > c->image->max_val) ? c->image->max_val : valeur, seize);
+        }
+    }
+    free(hist);
+}
+SPECIALISER_BANDE(clahe_tables_tuiles)
+
+//! interpolation des tables pour les lignes de pixels [debut, fin[
+SPECIALISE void clahe_interpolation_bande(void *contexte, int debut, int fin, const int seize)
+{
+    ContexteClahe *c = contexte;
+    int largeur = c->image->largeur;
+    size_t taille_ligne_tables = (size_t)c->grille * c->niveaux * (seize ? 2 : 1);
+    for (int i = debut; i < fin; i++)
+    {
+        float fy = (i + 0.5f) / c->hauteur_tuile - 0.5f;
+        int haut = (int)floorf(fy);
+        float poids_bas = fy - haut;
+        int bas = haut + 1;
+        if (haut < 0)
+            haut = 0;
+        if (bas > c->grille - 1)
+            bas = c->grille - 1;
+        if (haut > c->grille - 1)
+            haut = c->grille - 1;
+
+        const unsigned char *tables_haut = c->tables + haut * taille_ligne_tables;
+        const unsigned char *tables_bas = c->tables + bas * taille_ligne_tables;
+        const unsigned char *src = ligne_image(c->image, i);
+        unsigned char *dst = ligne_image(c->sortie, i);
+        for (int j = 0; j < largeur; j++)
+        {
+            int v = PIXEL_LIRE(src, j, seize);
+            if (v >= c->niveaux)
+                v = c->niveaux - 1;
+            int g = c->colonne_gauche[j] * c->niveaux + v, d = c->colonne_droite[j] * c->niveaux + v;
+            float wx = c->poids_droite[j];
+            int haut_g = PIXEL_LIRE(tables_haut, g, seize), haut_d = PIXEL_LIRE(tables_haut, d, seize);
+            int bas_g = PIXEL_LIRE(tables_bas, g, seize), bas_d = PIXEL_LIRE(tables_bas, d, seize);
+            float valeur_haut = haut_g + wx * (haut_d - haut_g);
+            float valeur_bas = bas_g + wx * (bas_d - bas_g);
+            PIXEL_ECRIRE(dst, j, (int)(valeur_haut + poids_bas * (valeur_bas - valeur_haut) + 0.5f), seize);
+        }
+    }
+}
+SPECIALISER_BANDE(clahe_interpolation_bande)
+
+int clahe_dans(ImagePGM *image, ImagePGM *sortie, int grille, double limite)
+{
+    if (grille < 1 || grille > image->largeur || grille > image->hauteur || !(limite > 0))
+    {
+        printf("paramètres de clahe invalides: grille %d, limite %g\n", grille, limite);
+        return -1;
+    }
+    ContexteClahe contexte = {.image = image, .sortie = sortie, .grille = grille, .limite = limite};
+    contexte.hauteur_tuile = (float)image->hauteur / grille;
+    contexte.largeur_tuile = (float)image->largeur / grille;
+    int seize = image_16_bits(image);
+    contexte.niveaux = seize ? image->max_val + 1 : NIVEAUX_8_BITS;
+    contexte.tables = malloc((size_t)grille * grille * contexte.niveaux * octets_par_pixel(image));
+    contexte.colonne_gauche = malloc(image->largeur * sizeof(int));
+    contexte.colonne_droite = malloc(image->largeur * sizeof(int));
+    contexte.poids_droite = malloc(image->largeur * sizeof(float));
+    int code = 0;
+    if (!contexte.tables || !contexte.colonne_gauche || !contexte.colonne_droite || !contexte.poids_droite)
+    {
+        perror("cannot allocate memory");
+        code = -1;
+    }
+    else
+    {
+        //? voisins horizontaux calculés une fois pour toutes les lignes
+        for (int j = 0; j < image->largeur; j++)
+        {
+            float fx = (j + 0.5f) / contexte.largeur_tuile - 0.5f;
+            int gauche = (int)floorf(fx);
+            contexte.poids_droite[j] = fx - gauche;
+            int droite = gauche + 1;
+            contexte.colonne_gauche[j] = (gauche < 0) ? 0 : (gauche > grille - 1) ? grille - 1 : gauche;
+            contexte.colonne_droite[j] = (droite > grille - 1) ? grille - 1 : droite;
+        }
+        executer_par_taches(grille * grille, seize ? clahe_tables_tuiles_16 : clahe_tables_tuiles_8, &contexte);
+        if (contexte.echec)
+            code = -1; //! tables non construites: rien n'est interpolé
+        else
+            executer_par_bandes(image->hauteur, seize ? clahe_interpolation_bande_16 : clahe_interpolation_bande_8, &contexte);
+    }
+    free(contexte.tables);
+    free(contexte.colonne_gauche);
+    free(contexte.colonne_droite);
+    free(contexte.poids_droite);
+    return code;
+}
+
+//! "grille[:limite]"
+static void analyser_parametres_clahe(const char *parametre, int *grille, double *limite)
+{
+    *grille = GRILLE_CLAHE_DEFAUT;
+    *limite = LIMITE_CLAHE_DEFAUT;
+    if (parametre)
+        sscanf(parametre, "%d:%lf", grille, limite);
+}
+
+ImagePGM *clahe(ImagePGM *image, const char *parametre)
+{
+    int grille;
+    double limite;
+    analyser_parametres_clahe(parametre, &grille, &limite);
+    ImagePGM *resultat = creer_image_pgm(image->hauteur, image->largeur, image->max_val);
+    if (!resultat)
+        return NULL;
+    if (clahe_dans(image, resultat, grille, limite) != 0)
+    {
+        liberer_une_image(resultat);
+        return NULL;
+    }
+    return resultat;
+}
+
+/*-------------------------------------------
+//? SEULLAGE D'UNE IMAGE (transformation en image binaire)
+---------------------------------------------*/
+ImagePGM *seuillage(ImagePGM *image, int seuil)
+{
+    if (seuil < 0 || seuil > image->max_val)
+        return NULL;
+
+    //?initialisation des images
+    ImagePGM *image_binaire = creer_image_pgm(image->hauteur, image->largeur, image->max_val);
+    if (!image_binaire)
+        return NULL;
+
+    ContextePonctuel contexte = {.operation = PONCTUEL_SEUIL, .a = image->data, .dst = image_binaire->data, .largeur = image->largeur, .parametre = seuil, .max_val = image_binaire->max_val, .seize = image_16_bits(image)};
+    appliquer_ponctuel(&contexte, image->hauteur);
+
+    return image_binaire;
+}
+
+/*-------------------------------------------
+//? MOTEUR DE CONVOLUTION 3x3
+//? noyaux entiers, normalisation en virgule fixe, décomposition en deux passes 1D
+//? lorsque le noyau est séparable (coef[i][j] = colonne[i] * ligne[j]).
+//? La réponse est écrite au coin haut-gauche de la fenêtre, comme les anciens filtres:
+//? les deux dernières lignes et colonnes de la sortie restent à 0.
+---------------------------------------------*/
+#define PRECISION_VIRGULE_FIXE 16
+
+//? l'inverse arrondi au-dessus de d donne floor(somme / d) tant que somme x (inverse x d - 2^16) < 2^16:
+//? vrai pour les sommes 8 bits des noyaux normalisés (9 x 255, 16 x 255), pas pour celles de 16 bits
+//? (9 x 65535), qui sont divisées exactement.
+#define INVERSE_EXACT(d, somme_max) \
+    ((long long)(somme_max) * ((((1 << PRECISION_VIRGULE_FIXE) + (d) - 1) / (d)) * (d) - (1 << PRECISION_VIRGULE_FIXE)) < (1 << PRECISION_VIRGULE_FIXE))
+_Static_assert(INVERSE_EXACT(9, 9 * 255) && INVERSE_EXACT(16, 16 * 255), "inverse en virgule fixe inexact sur 8 bits");
+
+typedef struct
+{
+    int coef[3][3];
+    int diviseur;
+    int separable;
+    int ligne[3];
+    int colonne[3];
+} Noyau3x3;
+
+//! Ce que le moteur écrit dans l'image de sortie
+typedef enum
+{
+    CONVOLUTION_VALEUR_ABSOLUE, //* |somme| / diviseur, saturé à max_val
+    CONVOLUTION_SEUIL           //* max_val si |somme| / diviseur >= seuil, 0 sinon
+} ModeConvolution;
+
+const Noyau3x3 NOYAU_MOYENNEUR = {{{1, 1, 1}, {1, 1, 1}, {1, 1, 1}}, 9, 1, {1, 1, 1}, {1, 1, 1}};
+const Noyau3x3 NOYAU_GAUSSIEN = {{{1, 2, 1}, {2, 4, 2}, {1, 2, 1}}, 16, 1, {1, 2, 1}, {1, 2, 1}};
+const Noyau3x3 NOYAU_LAPLACIEN = {{{1, 1, 1}, {1, -8, 1}, {1, 1, 1}}, 1, 0, {0, 0, 0}, {0, 0, 0}};
+const Noyau3x3 NOYAU_PREWITT_X = {{{-1, 0, 1}, {-1, 0, 1}, {-1, 0, 1}}, 1, 1, {-1, 0, 1}, {1, 1, 1}};
+const Noyau3x3 NOYAU_PREWITT_Y = {{{-1, -1, -1}, {0, 0, 0}, {1, 1, 1}}, 1, 1, {1, 1, 1}, {-1, 0, 1}};
+const Noyau3x3 NOYAU_SOBEL_X = {{{-1, 0, 1}, {-2, 0, 2}, {-1, 0, 1}}, 1, 1, {-1, 0, 1}, {1, 2, 1}};
+const Noyau3x3 NOYAU_SOBEL_Y = {{{-1, -2, -1}, {0, 0, 0}, {1, 2, 1}}, 1, 1, {1, 2, 1}, {-1, 0, 1}};
+
+//! passe horizontale d'un noyau séparable sur une ligne de l'image
+SPECIALISE void convolution_passe_horizontale(const unsigned char *src, int *dst, int largeur, const int ligne[3], const int seize)
+{
+    int k0 = ligne[0], k1 = ligne[1], k2 = ligne[2];
+    for (int j = 0; j + 2 < largeur; j++)
+    {
+        dst[j] = k0 * PIXEL_LIRE(src, j, seize) + k1 * PIXEL_LIRE(src, j + 1, seize) + k2 * PIXEL_LIRE(src, j + 2, seize);
+    }
+}
+
+//! normalisation puis écriture d'une ligne de réponses
+//! (sur 16 bits, division exacte: l'inverse en virgule fixe n'y est pas exact, voir INVERSE_EXACT)
+SPECIALISE void convolution_ecrire_ligne(const int *somme, unsigned char *dst, int largeur, int diviseur, int max_val, ModeConvolution mode, int seuil, const int seize)
+{
+    int multiplicateur = ((1 << PRECISION_VIRGULE_FIXE) + diviseur - 1) / diviseur;
+    for (int j = 0; j + 2 < largeur; j++)
+    {
+        int valeur = abs(somme[j]);
+        if (diviseur != 1)
+            valeur = seize ? valeur / diviseur : (valeur * multiplicateur) >> PRECISION_VIRGULE_FIXE;
+
+        if (mode == CONVOLUTION_SEUIL)
+            PIXEL_ECRIRE(dst, j, (valeur >= seuil) ? max_val : 0, seize);
+        else
+            PIXEL_ECRIRE(dst, j, (valeur > max_val) ? max_val : valeur, seize);
+    }
+    for (int j = (largeur > 2 ? largeur - 2 : 0); j < largeur; j++)
+    {
+        PIXEL_ECRIRE(dst, j, 0, seize);
+    }
+}
+
+/*-------------------------------------------
+//? CONVOLUTION 3x3 D'UNE BANDE DE LIGNES [debut, fin[
+//? la bande lit ses deux lignes de halo (debut+1, debut+2 ... fin+1) dans l'image d'entrée
+---------------------------------------------*/
+typedef struct
+{
+    ImagePGM *image;
+    ImagePGM *sortie;
+    const Noyau3x3 *noyau;
+    ModeConvolution mode;
+    int seuil;
+} ContexteConvolution;
+
+SPECIALISE void convolution_bande(void *contexte, int debut, int fin, const int seize)
+{
+    ContexteConvolution *c = contexte;
+    const Noyau3x3 *noyau = c->noyau;
+    int largeur = c->image->largeur;
+    int hauteur = c->image->hauteur;
+    size_t octets_ligne = (size_t)largeur * (seize ? 2 : 1);
+    int fin_valide = (fin < hauteur - 2) ? fin : hauteur - 2;
+
+    //? 3 lignes de passe horizontale (anneau) + 1 ligne de sommes
+    int *tampon = malloc(4 * largeur * sizeof(int));
+    if (!tampon)
+    {
+        perror("cannot allocate memory");
+        return;
+    }
+    int *horizontale[3] = {tampon, tampon + largeur, tampon + 2 * largeur};
+    int *somme = tampon + 3 * largeur;
+
+    if (noyau->separable && debut < fin_valide)
+    {
+        convolution_passe_horizontale(ligne_image(c->image, debut), horizontale[debut % 3], largeur, noyau->ligne, seize);
+        convolution_passe_horizontale(ligne_image(c->image, debut + 1), horizontale[(debut + 1) % 3], largeur, noyau->ligne, seize);
+    }
+
+    for (int i = debut; i < fin_valide; i++)
+    {
+        const unsigned char *l0 = ligne_image(c->image, i);
+        const unsigned char *l1 = l0 + octets_ligne;
+        const unsigned char *l2 = l1 + octets_ligne;
+
+        if (noyau->separable)
+        {
+            //? seule la nouvelle ligne entrant dans la fenêtre est filtrée horizontalement
+            int *h0 = horizontale[i % 3];
+            int *h1 = horizontale[(i + 1) % 3];
+            int *h2 = horizontale[(i + 2) % 3];
+            convolution_passe_horizontale(l2, h2, largeur, noyau->ligne, seize);
+
+            int c0 = noyau->colonne[0], c1 = noyau->colonne[1], c2 = noyau->colonne[2];
+            for (int j = 0; j + 2 < largeur; j++)
+            {
+                somme[j] = c0 * h0[j] + c1 * h1[j] + c2 * h2[j];
+            }
+        }
+        else
+        {
+            const int (*k)[3] = noyau->coef;
+            for (int j = 0; j + 2 < largeur; j++)
+            {
+                somme[j] = k[0][0] * PIXEL_LIRE(l0, j, seize) + k[0][1] * PIXEL_LIRE(l0, j + 1, seize) + k[0][2] * PIXEL_LIRE(l0, j + 2, seize) +
+                           k[1][0] * PIXEL_LIRE(l1, j, seize) + k[1][1] * PIXEL_LIRE(l1, j + 1, seize) + k[1][2] * PIXEL_LIRE(l1, j + 2, seize) +
+                           k[2][0] * PIXEL_LIRE(l2, j, seize) + k[2][1] * PIXEL_LIRE(l2, j + 1, seize) + k[2][2] * PIXEL_LIRE(l2, j + 2, seize);
+            }
+        }
+
+        convolution_ecrire_ligne(somme, ligne_image(c->sortie, i), largeur, noyau->diviseur, c->sortie->max_val, c->mode, c->seuil, seize);
+    }
+
+    //? les lignes sans fenêtre complète restent noires
+    for (int i = (fin_valide > debut ? fin_valide : debut); i < fin; i++)
+    {
+        memset(ligne_image(c->sortie, i), 0, octets_ligne);
+    }
+
+    free(tampon);
+}
+SPECIALISER_BANDE(convolution_bande)
+
+/*-------------------------------------------
+//? CONVOLUTION 3x3 D'UNE IMAGE DANS UNE IMAGE DE SORTIE DÉJÀ ALLOUÉE
+---------------------------------------------*/
+void convolution_3x3_dans(ImagePGM *image, ImagePGM *sortie, const Noyau3x3 *noyau, ModeConvolution mode, int seuil)
+{
+    ContexteConvolution contexte = {image, sortie, noyau, mode, seuil};
+    executer_par_bandes(image->hauteur, image_16_bits(image) ? convolution_bande_16 : convolution_bande_8, &contexte);
+}
+
+/*-------------------------------------------
+//? CONVOLUTION 3x3 AVEC ALLOCATION DE L'IMAGE RÉSULTAT
+---------------------------------------------*/
+ImagePGM *convolution_3x3(ImagePGM *image, const Noyau3x3 *noyau, ModeConvolution mode, int seuil)
+{
+    ImagePGM *resultat = creer_image_pgm(image->hauteur, image->largeur, image->max_val);
+    if (!resultat)
+        return NULL;
+    convolution_3x3_dans(image, resultat, noyau, mode, seuil);
+    return resultat;
+}
+
+/*-------------------------------------------
+//? NOYAU DE GRADIENT FUSIONNÉ
+//? Gx et Gy sont calculés dans la même passe et seule la sortie finale est écrite:
+//? min(|Gx| + |Gy|, max_val), ou max_val si |Gx| + |Gy| > seuil (comparaison stricte,
+//? comme les anciens filtres _seuil). Pas d'image intermédiaire imageX / imageY.
+---------------------------------------------*/
+typedef struct
+{
+    ImagePGM *image;
+    ImagePGM *sortie;
+    const Noyau3x3 *noyau_x; //! NULL: opérateur de Robert (2x2)
+    const Noyau3x3 *noyau_y;
+    ModeConvolution mode;
+    int seuil;
+} ContexteGradient;
+
+static inline int gradient_valeur(int gx, int gy, ModeConvolution mode, int seuil, int max_val)
+{
+    int magnitude = abs(gx) + abs(gy);
+    if (mode == CONVOLUTION_SEUIL)
+        return (magnitude > seuil) ? max_val : 0;
+    return (magnitude > max_val) ? max_val : magnitude;
+}
+
+//! Robert: lignes [debut, fin[ (halo: la ligne suivante)
+SPECIALISE void gradient_robert_bande(ContexteGradient *c, int debut, int fin, const int seize)
+{
+    int largeur = c->image->largeur;
+    int max_val = c->sortie->max_val;
+    size_t octets_ligne = (size_t)largeur * (seize ? 2 : 1);
+    int fin_valide = (fin < c->image->hauteur - 1) ? fin : c->image->hauteur - 1;
+
+    for (int i = debut; i < fin_valide; i++)
+    {
+        const unsigned char *l0 = ligne_image(c->image, i);
+        const unsigned char *l1 = l0 + octets_ligne;
+        unsigned char *dst = ligne_image(c->sortie, i);
+        for (int j = 0; j + 1 < largeur; j++)
+        {
+            int gx = PIXEL_LIRE(l0, j + 1, seize) - PIXEL_LIRE(l1, j, seize);
+            int gy = PIXEL_LIRE(l0, j, seize) - PIXEL_LIRE(l1, j + 1, seize);
+            PIXEL_ECRIRE(dst, j, gradient_valeur(gx, gy, c->mode, c->seuil, max_val), seize);
+        }
+        PIXEL_ECRIRE(dst, largeur - 1, 0, seize);
+    }
+    for (int i = (fin_valide > debut ? fin_valide : debut); i < fin; i++)
+    {
+        memset(ligne_image(c->sortie, i), 0, octets_ligne);
+    }
+}
+
+//! noyaux 3x3: lignes [debut, fin[ (halo: les deux lignes suivantes)
+SPECIALISE void gradient_3x3_bande(ContexteGradient *c, int debut, int fin, const int seize)
+{
+    const Noyau3x3 *nx = c->noyau_x;
+    const Noyau3x3 *ny = c->noyau_y;
+    int largeur = c->image->largeur;
+    int max_val = c->sortie->max_val;
+    size_t octets_ligne = (size_t)largeur * (seize ? 2 : 1);
+    int fin_valide = (fin < c->image->hauteur - 2) ? fin : c->image->hauteur - 2;
+    int separables = nx->separable && ny->separable;
+
+    //? anneaux de passes horizontales, un par noyau
+    int *tampon = malloc(6 * largeur * sizeof(int));
+    if (!tampon)
+    {
+        perror("cannot allocate memory");
+        return;
+    }
+    int *hx[3] = {tampon, tampon + largeur, tampon + 2 * largeur};
+    int *hy[3] = {tampon + 3 * largeur, tampon + 4 * largeur, tampon + 5 * largeur};
+
+    if (separables && debut < fin_valide)
+    {
+        for (int k = 0; k < 2; k++)
+        {
+            const unsigned char *l = ligne_image(c->image, debut + k);
+            convolution_passe_horizontale(l, hx[(debut + k) % 3], largeur, nx->ligne, seize);
+            convolution_passe_horizontale(l, hy[(debut + k) % 3], largeur, ny->ligne, seize);
+        }
+    }
+
+    for (int i = debut; i < fin_valide; i++)
+    {
+        const unsigned char *l0 = ligne_image(c->image, i);
+        const unsigned char *l1 = l0 + octets_ligne;
+        const unsigned char *l2 = l1 + octets_ligne;
+        unsigned char *dst = ligne_image(c->sortie, i);
+
+        if (separables)
+        {
+            int *x0 = hx[i % 3], *x1 = hx[(i + 1) % 3], *x2 = hx[(i + 2) % 3];
+            int *y0 = hy[i % 3], *y1 = hy[(i + 1) % 3], *y2 = hy[(i + 2) % 3];
+            convolution_passe_horizontale(l2, x2, largeur, nx->ligne, seize);
+            convolution_passe_horizontale(l2, y2, largeur, ny->ligne, seize);
+
+            int cx0 = nx->colonne[0], cx1 = nx->colonne[1], cx2 = nx->colonne[2];
+            int cy0 = ny->colonne[0], cy1 = ny->colonne[1], cy2 = ny->colonne[2];
+            for (int j = 0; j + 2 < largeur; j++)
+            {
+                int gx = cx0 * x0[j] + cx1 * x1[j] + cx2 * x2[j];
+                int gy = cy0 * y0[j] + cy1 * y1[j] + cy2 * y2[j];
+                PIXEL_ECRIRE(dst, j, gradient_valeur(gx, gy, c->mode, c->seuil, max_val), seize);
+            }
+        }
+        else
+        {
+            const int (*kx)[3] = nx->coef;
+            const int (*ky)[3] = ny->coef;
+            for (int j = 0; j + 2 < largeur; j++)
+            {
+                int p[3][3] = {{PIXEL_LIRE(l0, j, seize), PIXEL_LIRE(l0, j + 1, seize), PIXEL_LIRE(l0, j + 2, seize)},
+                               {PIXEL_LIRE(l1, j, seize), PIXEL_LIRE(l1, j + 1, seize), PIXEL_LIRE(l1, j + 2, seize)},
+                               {PIXEL_LIRE(l2, j, seize), PIXEL_LIRE(l2, j + 1, seize), PIXEL_LIRE(l2, j + 2, seize)}};
+                int gx = 0, gy = 0;
+                for (int a = 0; a < 3; a++)
+                {
+                    for (int b = 0; b < 3; b++)
+                    {
+                        gx += kx[a][b] * p[a][b];
+                        gy += ky[a][b] * p[a][b];
+                    }
+                }
+                PIXEL_ECRIRE(dst, j, gradient_valeur(gx, gy, c->mode, c->seuil, max_val), seize);
+            }
+        }
+        for (int j = (largeur > 2 ? largeur - 2 : 0); j < largeur; j++)
+        {
+            PIXEL_ECRIRE(dst, j, 0, seize);
+        }
+    }
+    for (int i = (fin_valide > debut ? fin_valide : debut); i < fin; i++)
+    {
+        memset(ligne_image(c->sortie, i), 0, octets_ligne);
+    }
+
+    free(tampon);
+}
+
+SPECIALISE void gradient_bande(void *contexte, int debut, int fin, const int seize)
+{
+    ContexteGradient *c = contexte;
+    if (c->noyau_x)
+        gradient_3x3_bande(c, debut, fin, seize);
+    else
+        gradient_robert_bande(c, debut, fin, seize);
+}
+SPECIALISER_BANDE(gradient_bande)
+
+/*-------------------------------------------
+//? GRADIENT D'UNE IMAGE DANS UNE IMAGE DE SORTIE DÉJÀ ALLOUÉE (noyau_x == NULL: Robert)
+---------------------------------------------*/
+void gradient_dans(ImagePGM *image, ImagePGM *sortie, const Noyau3x3 *noyau_x, const Noyau3x3 *noyau_y, ModeConvolution mode, int seuil)
+{
+    ContexteGradient contexte = {image, sortie, noyau_x, noyau_y, mode, seuil};
+    executer_par_bandes(image->hauteur, image_16_bits(image) ? gradient_bande_16 : gradient_bande_8, &contexte);
+}
+
+ImagePGM *gradient(ImagePGM *image, const Noyau3x3 *noyau_x, const Noyau3x3 *noyau_y, ModeConvolution mode, int seuil)
+{
+    ImagePGM *resultat = creer_image_pgm(image->hauteur, image->largeur, image->max_val);
+    if (!resultat)
+        return NULL;
+    gradient_dans(image, resultat, noyau_x, noyau_y, mode, seuil);
+    return resultat;
+}
+
+/*-------------------------------------------
+//? FONCTION DE LISSAGE(Moyenneur)
+---------------------------------------------*/
+ImagePGM *filtre_moyenneur(ImagePGM *image)
+{
+    return convolution_3x3(image, &NOYAU_MOYENNEUR, CONVOLUTION_VALEUR_ABSOLUE, 0);
+}
+
+/*-------------------------------------------
+//? TABLE DES SOMMES CUMULÉES (summed-area table)
+//? somme[(i)(largeur+1) + j] = somme des pixels des lignes [0, i[ et colonnes [0, j[
+//? la somme d'un rectangle quelconque coûte 4 lectures, quelle que soit sa taille.
+//? les entrées sont en arithmétique modulo 2^32: les différences restent exactes
+//? tant que la somme du rectangle tient sur 32 bits (max_val x aire < 2^32: fenêtres
+//? jusqu'à ~4000x4000 sur 8 bits, 255x255 sur 16 bits)
+---------------------------------------------*/
+typedef struct
+{
+    int largeur;
+    int hauteur;
+    unsigned int *somme; //! (hauteur + 1) x (largeur + 1)
+} TableSommes;
+
+typedef struct
+{
+    ImagePGM *image;
+    TableSommes *table;
+} ContexteTableSommes;
+
+//! passe 1: sommes préfixes de chaque ligne, indépendantes entre lignes
+SPECIALISE void table_sommes_lignes_bande(void *contexte, int debut, int fin, const int seize)
+{
+    ContexteTableSommes *c = contexte;
+    size_t pas = (size_t)c->table->largeur + 1;
+    for (int i = debut; i < fin; i++)
+    {
+        const unsigned char *src = ligne_image(c->image, i);
+        unsigned int *dst = c->table->somme + (size_t)(i + 1) * pas;
+        unsigned int cumul = 0;
+        dst[0] = 0;
+        for (int j = 0; j < c->image->largeur; j++)
+        {
+            cumul += PIXEL_LIRE(src, j, seize);
+            dst[j + 1] = cumul;
+        }
+    }
+}
+SPECIALISER_BANDE(table_sommes_lignes_bande)
+
+//! passe 2: cumul vertical, découpé en bandes de colonnes [debut, fin[
+static void table_sommes_colonnes_bande(void *contexte, int debut, int fin)
+{
+    ContexteTableSommes *c = contexte;
+    size_t pas = (size_t)c->table->largeur + 1;
+    for (int i = 2; i <= c->table->hauteur; i++)
+    {
+        const unsigned int *precedente = c->table->somme + (size_t)(i - 1) * pas;
+        unsigned int *ligne = c->table->somme + (size_t)i * pas;
+        for (int j = debut; j < fin; j++)
+        {
+            ligne[j] += precedente[j];
+        }
+    }
+}
+
+TableSommes *table_sommes(ImagePGM *image)
+{
+    TableSommes *table = malloc(sizeof(TableSommes));
+    if (!table)
+    {
+        perror("cannot allocate memory");
+        return NULL;
+    }
+    table->largeur = image->largeur;
+    table->hauteur = image->hauteur;
+    table->somme = malloc(((size_t)image->largeur + 1) * ((size_t)image->hauteur + 1) * sizeof(unsigned int));
+    if (!table->somme)
+    {
+        perror("cannot allocate memory");
+        free(table);
+        return NULL;
+    }
+    memset(table->somme, 0, ((size_t)image->largeur + 1) * sizeof(unsigned int));
+
+    ContexteTableSommes contexte = {image, table};
+    executer_par_bandes(image->hauteur, image_16_bits(image) ? table_sommes_lignes_bande_16 : table_sommes_lignes_bande_8, &contexte);
+    executer_par_bandes(image->largeur + 1, table_sommes_colonnes_bande, &contexte);
+    return table;
+}
+
+void liberer_table_sommes(TableSommes *table)
+{
+    if (!table)
+        return;
+    free(table->somme);
+    free(table);
+}
+
+//! somme des pixels des lignes [i0, i1[ et colonnes [j0, j1[
+static inline unsigned int somme_rectangle(const TableSommes *table, int i0, int j0, int i1, int j1)
+{
+    size_t pas = (size_t)table->largeur + 1;
+    const unsigned int *haut = table->somme + (size_t)i0 * pas;
+    const unsigned int *bas = table->somme + (size_t)i1 * pas;
+    return bas[j1] - bas[j0] - haut[j1] + haut[j0];
+}
+
+/*-------------------------------------------
+//? MOYENNEUR DE RAYON QUELCONQUE: fenêtre (2r+1)x(2r+1), coût constant par pixel
+//? fenêtre centrée sur (i, j) et bornée à l'image: près des bords, la moyenne porte
+//? sur la partie de la fenêtre qui est dans l'image (comme gaussien <sigma>, pas de décalage)
+---------------------------------------------*/
+#define PRECISION_MOYENNE 40
+
+typedef struct
+{
+    const TableSommes *table;
+    ImagePGM *sortie;
+    int rayon;
+} ContexteMoyenneur;
+
+SPECIALISE void moyenneur_bande(void *contexte, int debut, int fin, const int seize)
+{
+    ContexteMoyenneur *c = contexte;
+    int largeur = c->sortie->largeur;
+    int hauteur = c->sortie->hauteur;
+    int rayon = c->rayon;
+    unsigned long long aire = (unsigned long long)(2 * rayon + 1) * (2 * rayon + 1);
+
+    //? fenêtre entière: division par l'aire via un inverse en virgule fixe, exact tant que
+    //? max_val * aire² < 2^40 (le maximum du type de pixel sur 8 bits); près des bords,
+    //? l'aire bornée change à chaque pixel et la division est faite directement
+    unsigned long long plus_grand = seize ? (unsigned long long)c->sortie->max_val : 255ULL;
+    int inverse_exact = plus_grand * aire * aire < (1ULL << PRECISION_MOYENNE);
+    unsigned long long multiplicateur = ((1ULL << PRECISION_MOYENNE) + aire - 1) / aire;
+
+    for (int i = debut; i < fin; i++)
+    {
+        unsigned char *dst = ligne_image(c->sortie, i);
+        int i0 = (i - rayon < 0) ? 0 : i - rayon;
+        int i1 = (i + rayon + 1 > hauteur) ? hauteur : i + rayon + 1;
+        for (int j = 0; j < largeur; j++)
+        {
+            int j0 = (j - rayon < 0) ? 0 : j - rayon;
+            int j1 = (j + rayon + 1 > largeur) ? largeur : j + rayon + 1;
+            unsigned long long aire_pixel = (unsigned long long)(i1 - i0) * (j1 - j0);
+            unsigned long long somme = somme_rectangle(c->table, i0, j0, i1, j1);
+            unsigned long long valeur = (inverse_exact && aire_pixel == aire) ? (somme * multiplicateur) >> PRECISION_MOYENNE : somme / aire_pixel;
+            PIXEL_ECRIRE(dst, j, (valeur > (unsigned long long)c->sortie->max_val) ? (unsigned long long)c->sortie->max_val : valeur, seize);
+        }
+    }
+}
+SPECIALISER_BANDE(moyenneur_bande)
+
+//! moyenneur à partir d'une table déjà construite (réutilisable pour plusieurs rayons)
+void moyenneur_table_dans(const TableSommes *table, ImagePGM *sortie, int rayon)
+{
+    ContexteMoyenneur contexte = {table, sortie, rayon};
+    executer_par_bandes(sortie->hauteur, image_16_bits(sortie) ? moyenneur_bande_16 : moyenneur_bande_8, &contexte);
+}
+
+int moyenneur_rayon_dans(ImagePGM *image, ImagePGM *sortie, int rayon)
+{
+    //? côté en 64 bits: un rayon proche de INT_MAX ne doit pas déborder avant le test
+    unsigned long long plus_grand = image_16_bits(image) ? (unsigned long long)image->max_val : 255ULL;
+    unsigned long long cote = 2ULL * (unsigned long long)(rayon > 0 ? rayon : 0) + 1;
+    if (rayon < 1 || cote > 65535 || plus_grand * cote * cote >= (1ULL << 32))
+    {
+        printf("rayon invalide: %d\n", rayon);
+        return -1;
+    }
+    TableSommes *table = table_sommes(image);
+    if (!table)
+        return -1;
+    moyenneur_table_dans(table, sortie, rayon);
+    liberer_table_sommes(table);
+    return 0;
+}
+
+ImagePGM *filtre_moyenneur_rayon(ImagePGM *image, int rayon)
+{
+    ImagePGM *resultat = creer_image_pgm(image->hauteur, image->largeur, image->max_val);
+    if (!resultat)
+        return NULL;
+    if (moyenneur_rayon_dans(image, resultat, rayon) != 0)
+    {
+        liberer_une_image(resultat);
+        return NULL;
+    }
+    return resultat;
+}
+
+/*-------------------------------------------
+//? FONCTION DE LISSAGE(Gaussien)
+---------------------------------------------*/
+ImagePGM *filtre_gaussien(ImagePGM *image)
+{
+    return convolution_3x3(image, &NOYAU_GAUSSIEN, CONVOLUTION_VALEUR_ABSOLUE, 0);
+}
+
+/*-------------------------------------------
+//? FLOU GAUSSIEN D'ÉCART-TYPE QUELCONQUE
+//? sigma < SIGMA_RECURSIF: noyau séparable échantillonné sur [-3 sigma, 3 sigma]
+//? au-delà: filtre récursif de Young et van Vliet (3 pôles, passe avant puis arrière),
+//? coût constant par pixel quel que soit sigma. Coefficients et états en double: les pôles
+//? tendent vers 1 quand sigma grandit et, en float, le gain continu dérive (image assombrie
+//? ou saturée dès sigma ~ 200); au-delà de SIGMA_MAX même le double ne suffit plus.
+//? contrairement au noyau 3x3, la sortie est centrée et les bords sont répliqués
+---------------------------------------------*/
+#define SIGMA_RECURSIF 2.0
+#define SIGMA_MAX 1000.0
+
+typedef struct
+{
+    ImagePGM *image;
+    ImagePGM *sortie;
+    float *intermediaire; //! résultat de la passe horizontale, hauteur x largeur
+    const float *noyau;   //! demi-noyau normalisé, noyau[0] au centre
+    int rayon;
+    double b, a1, a2, a3; //! coefficients du filtre récursif
+    int marge;            //! échantillons répliqués après le dernier pixel avant la passe arrière
+    int echec;            //! une bande n'a pas pu allouer son tampon: la sortie est incomplète
+} ContexteGaussien;
+
+static inline int gaussien_arrondi(double valeur, int max_val)
+{
+    //? borné avant la conversion: un flottant hors de la plage de int n'a pas de valeur entière
+    return (valeur < 0.0) ? 0 : (valeur >= max_val) ? max_val : (int)(valeur + 0.5);
+}
+
+//? --- version séparable ---
+
+SPECIALISE void gaussien_separable_lignes_bande(void *contexte, int debut, int fin, const int seize)
+{
+    ContexteGaussien *c = contexte;
+    int largeur = c->image->largeur;
+    int rayon = c->rayon;
+    //? ligne recopiée avec rayon pixels répliqués de chaque côté
+    float *ligne = malloc((largeur + 2 * rayon) * sizeof(float));
+    if (!ligne)
+    {
+        perror("cannot allocate memory");
+        __atomic_store_n(&c->echec, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    for (int i = debut; i < fin; i++)
+    {
+        const unsigned char *src = ligne_image(c->image, i);
+        float *dst = c->intermediaire + get_position(i, 0, largeur);
+        for (int j = 0; j < rayon; j++)
+        {
+            ligne[j] = PIXEL_LIRE(src, 0, seize);
+            ligne[rayon + largeur + j] = PIXEL_LIRE(src, largeur - 1, seize);
+        }
+        for (int j = 0; j < largeur; j++)
+        {
+            ligne[rayon + j] = PIXEL_LIRE(src, j, seize);
+        }
+        const float *centre = ligne + rayon;
+        for (int j = 0; j < largeur; j++)
+        {
+            float somme = c->noyau[0] * centre[j];
+            for (int t = 1; t <= rayon; t++)
+            {
+                somme += c->noyau[t] * (centre[j - t] + centre[j + t]);
+            }
+            dst[j] = somme;
+        }
+    }
+    free(ligne);
+}
+SPECIALISER_BANDE(gaussien_separable_lignes_bande)
+
+SPECIALISE void gaussien_separable_colonnes_bande(void *contexte, int debut, int fin, const int seize)
+{
+    ContexteGaussien *c = contexte;
+    int largeur = c->image->largeur;
+    int hauteur = c->image->hauteur;
+    float *somme = malloc(largeur * sizeof(float));
+    if (!somme)
+    {
+        perror("cannot allocate memory");
+        __atomic_store_n(&c->echec, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    for (int i = debut; i < fin; i++)
+    {
+        //? accumulation ligne par ligne pour rester contigu en mémoire
+        const float *centre = c->intermediaire + get_position(i, 0, largeur);
+        for (int j = 0; j < largeur; j++)
+        {
+            somme[j] = c->noyau[0] * centre[j];
+        }
+        for (int t = 1; t <= c->rayon; t++)
+        {
+            int haut = (i - t < 0) ? 0 : i - t;
+            int bas = (i + t >= hauteur) ? hauteur - 1 : i + t;
+            const float *l_haut = c->intermediaire + get_position(haut, 0, largeur);
+            const float *l_bas = c->intermediaire + get_position(bas, 0, largeur);
+            float k = c->noyau[t];
+            for (int j = 0; j < largeur; j++)
+            {
+                somme[j] += k * (l_haut[j] + l_bas[j]);
+            }
+        }
+        unsigned char *dst = ligne_image(c->sortie, i);
+        for (int j = 0; j < largeur; j++)
+        {
+            PIXEL_ECRIRE(dst, j, gaussien_arrondi(somme[j], c->sortie->max_val), seize);
+        }
+    }
+    free(somme);
+}
+SPECIALISER_BANDE(gaussien_separable_colonnes_bande)
+
+//? --- version récursive (Young et van Vliet) ---
+//? w[n] = b x[n] + a1 w[n-1] + a2 w[n-2] + a3 w[n-3], puis la même récurrence en sens inverse
+
+SPECIALISE void gaussien_recursif_lignes_bande(void *contexte, int debut, int fin, const int seize)
+{
+    ContexteGaussien *c = contexte;
+    int largeur = c->image->largeur;
+    double b = c->b, a1 = c->a1, a2 = c->a2, a3 = c->a3;
+    double *marge = malloc(c->marge * sizeof(double));
+    if (!marge)
+    {
+        perror("cannot allocate memory");
+        __atomic_store_n(&c->echec, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    for (int i = debut; i < fin; i++)
+    {
+        const unsigned char *src = ligne_image(c->image, i);
+        float *dst = c->intermediaire + get_position(i, 0, largeur);
+
+        //? bord gauche répliqué: le filtre a un gain unité, l'état initial vaut le pixel de bord
+        double w1 = PIXEL_LIRE(src, 0, seize), w2 = w1, w3 = w1;
+        for (int j = 0; j < largeur; j++)
+        {
+            double w = b * PIXEL_LIRE(src, j, seize) + a1 * w1 + a2 * w2 + a3 * w3;
+            dst[j] = (float)w;
+            w3 = w2;
+            w2 = w1;
+            w1 = w;
+        }
+        //? bord droit: la passe avant continue sur la marge répliquée, la passe arrière y démarre
+        for (int p = 0; p < c->marge; p++)
+        {
+            double w = b * PIXEL_LIRE(src, largeur - 1, seize) + a1 * w1 + a2 * w2 + a3 * w3;
+            marge[p] = w;
+            w3 = w2;
+            w2 = w1;
+            w1 = w;
+        }
+        w1 = w2 = w3 = marge[c->marge - 1];
+        for (int p = c->marge - 1; p >= 0; p--)
+        {
+            double w = b * marge[p] + a1 * w1 + a2 * w2 + a3 * w3;
+            w3 = w2;
+            w2 = w1;
+            w1 = w;
+        }
+        for (int j = largeur - 1; j >= 0; j--)
+        {
+            double w = b * dst[j] + a1 * w1 + a2 * w2 + a3 * w3;
+            dst[j] = (float)w;
+            w3 = w2;
+            w2 = w1;
+            w1 = w;
+        }
+    }
+    free(marge);
+}
+SPECIALISER_BANDE(gaussien_recursif_lignes_bande)
+
+//! passe verticale sur les colonnes [debut, fin[, balayée ligne par ligne
+SPECIALISE void gaussien_recursif_colonnes_bande(void *contexte, int debut, int fin, const int seize)
+{
+    ContexteGaussien *c = contexte;
+    int largeur = c->image->largeur;
+    int hauteur = c->image->hauteur;
+    int nb = fin - debut;
+    double b = c->b, a1 = c->a1, a2 = c->a2, a3 = c->a3;
+
+    //? trois lignes d'état par colonne de la bande, la dernière ligne d'entrée et la marge
+    double *etat = malloc((4 + (size_t)c->marge) * nb * sizeof(double));
+    if (!etat)
+    {
+        perror("cannot allocate memory");
+        __atomic_store_n(&c->echec, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    double *w1 = etat, *w2 = etat + nb, *w3 = etat + 2 * nb;
+    double *bord = etat + 3 * nb;
+    double *marge = etat + 4 * nb;
+
+    //? la passe avant écrase l'entrée: on garde la dernière ligne pour la marge du bas
+    const float *derniere = c->intermediaire + get_position(hauteur - 1, debut, largeur);
+    const float *premiere = c->intermediaire + debut;
+    for (int j = 0; j < nb; j++)
+    {
+        bord[j] = derniere[j];
+        w1[j] = w2[j] = w3[j] = premiere[j];
+    }
+    for (int i = 0; i < hauteur; i++)
+    {
+        float *ligne = c->intermediaire + get_position(i, debut, largeur);
+        for (int j = 0; j < nb; j++)
+        {
+            double w = b * ligne[j] + a1 * w1[j] + a2 * w2[j] + a3 * w3[j];
+            ligne[j] = (float)w;
+            w3[j] = w2[j];
+            w2[j] = w1[j];
+            w1[j] = w;
+        }
+    }
+    for (int p = 0; p < c->marge; p++)
+    {
+        double *ligne = marge + (size_t)p * nb;
+        for (int j = 0; j < nb; j++)
+        {
+            double w = b * bord[j] + a1 * w1[j] + a2 * w2[j] + a3 * w3[j];
+            ligne[j] = w;
+            w3[j] = w2[j];
+            w2[j] = w1[j];
+            w1[j] = w;
+        }
+    }
+
+    double *fin_marge = marge + (size_t)(c->marge - 1) * nb;
+    for (int j = 0; j < nb; j++)
+    {
+        w1[j] = w2[j] = w3[j] = fin_marge[j];
+    }
+    for (int p = c->marge - 1; p >= 0; p--)
+    {
+        const double *ligne = marge + (size_t)p * nb;
+        for (int j = 0; j < nb; j++)
+        {
+            double w = b * ligne[j] + a1 * w1[j] + a2 * w2[j] + a3 * w3[j];
+            w3[j] = w2[j];
+            w2[j] = w1[j];
+            w1[j] = w;
+        }
+    }
+    for (int i = hauteur - 1; i >= 0; i--)
+    {
+        const float *ligne = c->intermediaire + get_position(i, debut, largeur);
+        unsigned char *dst = c->sortie->data + get_position(i, debut, largeur) * (seize ? 2 : 1);
+        for (int j = 0; j < nb; j++)
+        {
+            double w = b * ligne[j] + a1 * w1[j] + a2 * w2[j] + a3 * w3[j];
+            PIXEL_ECRIRE(dst, j, gaussien_arrondi(w, c->sortie->max_val), seize);
+            w3[j] = w2[j];
+            w2[j] = w1[j];
+            w1[j] = w;
+        }
+    }
+    free(etat);
+}
+SPECIALISER_BANDE(gaussien_recursif_colonnes_bande)
+
+//! coefficients de Young et van Vliet (1995) pour un écart-type sigma
+static void gaussien_coefficients_recursifs(double sigma, ContexteGaussien *c)
+{
+    double q = (sigma >= 2.5) ? 0.98711 * sigma - 0.96330 : 3.97156 - 4.14554 * sqrt(1.0 - 0.26891 * sigma);
+    double q2 = q * q, q3 = q2 * q;
+    double b0 = 1.57825 + 2.44413 * q + 1.4281 * q2 + 0.422205 * q3;
+    double b1 = 2.44413 * q + 2.85619 * q2 + 1.26661 * q3;
+    double b2 = -(1.4281 * q2 + 1.26661 * q3);
+    double b3 = 0.422205 * q3;
+    c->a1 = b1 / b0;
+    c->a2 = b2 / b0;
+    c->a3 = b3 / b0;
+    //? gain continu ramené à 1 exactement à partir des coefficients arrondis
+    c->b = 1.0 - (c->a1 + c->a2 + c->a3);
+}
+
+int gaussien_sigma_dans(ImagePGM *image, ImagePGM *sortie, double sigma)
+{
+    if (!(sigma > 0) || sigma > SIGMA_MAX)
+    {
+        printf("sigma invalide: %g (0 < sigma <= %g)\n", sigma, SIGMA_MAX);
+        return -1;
+    }
+    int seize = image_16_bits(image);
+    ContexteGaussien contexte = {.image = image, .sortie = sortie};
+    contexte.intermediaire = malloc((size_t)image->largeur * image->hauteur * sizeof(float));
+    if (!contexte.intermediaire)
+    {
+        perror("cannot allocate memory");
+        return -1;
+    }
+
+    if (sigma < SIGMA_RECURSIF)
+    {
+        int rayon = (int)ceil(3.0 * sigma);
+        float *noyau = malloc((rayon + 1) * sizeof(float));
+        if (!noyau)
+        {
+            perror("cannot allocate memory");
+            free(contexte.intermediaire);
+            return -1;
+        }
+        double total = 0;
+        for (int t = 0; t <= rayon; t++)
+        {
+            noyau[t] = exp(-(double)(t * t) / (2.0 * sigma * sigma));
+            total += (t == 0) ? noyau[t] : 2.0 * noyau[t];
+        }
+        for (int t = 0; t <= rayon; t++)
+        {
+            noyau[t] /= total;
+        }
+        contexte.noyau = noyau;
+        contexte.rayon = rayon;
+        executer_par_bandes(image->hauteur, seize ? gaussien_separable_lignes_bande_16 : gaussien_separable_lignes_bande_8, &contexte);
+        if (!contexte.echec)
+            executer_par_bandes(image->hauteur, seize ? gaussien_separable_colonnes_bande_16 : gaussien_separable_colonnes_bande_8, &contexte);
+        free(noyau);
+    }
+    else
+    {
+        gaussien_coefficients_recursifs(sigma, &contexte);
+        contexte.marge = (int)ceil(4.0 * sigma); //! sigma <= SIGMA_MAX: tient dans un int
+        executer_par_bandes(image->hauteur, seize ? gaussien_recursif_lignes_bande_16 : gaussien_recursif_lignes_bande_8, &contexte);
+        if (!contexte.echec)
+            executer_par_bandes(image->largeur, seize ? gaussien_recursif_colonnes_bande_16 : gaussien_recursif_colonnes_bande_8, &contexte);
+    }
+
+    free(contexte.intermediaire);
+    //? une bande sans tampon n'a rien écrit: la sortie contient encore la mémoire du pool
+    return contexte.echec ? -1 : 0;
+}
+
+ImagePGM *filtre_gaussien_sigma(ImagePGM *image, double sigma)
+{
+    ImagePGM *resultat = creer_image_pgm(image->hauteur, image->largeur, image->max_val);
+    if (!resultat)
+        return NULL;
+    if (gaussien_sigma_dans(image, resultat, sigma) != 0)
+    {
+        liberer_une_image(resultat);
+        return NULL;
+    }
+    return resultat;
+}
+
+/*-------------------------------------------
+//? FONCTION DE DETECTION DES CONTOURS(Prewitt)
+---------------------------------------------*/
+ImagePGM *filtre_prewitt(ImagePGM *image)
+{
+    return gradient(image, &NOYAU_PREWITT_X, &NOYAU_PREWITT_Y, CONVOLUTION_VALEUR_ABSOLUE, 0);
+}
+
+/*-------------------------------------------
+//? FONCTION DE DETECTION DES CONTOURS(Sobel)
+---------------------------------------------*/
+ImagePGM *filtre_sobel(ImagePGM *image)
+{
+    return gradient(image, &NOYAU_SOBEL_X, &NOYAU_SOBEL_Y, CONVOLUTION_VALEUR_ABSOLUE, 0);
+}
+
+/*-------------------------------------------
+//? FONCTION DE DETECTION DES CONTOURS(Robert)
+---------------------------------------------*/
+ImagePGM *filtre_robert(ImagePGM *image)
+{
+    return gradient(image, NULL, NULL, CONVOLUTION_VALEUR_ABSOLUE, 0);
+}
+
+/*-------------------------------------------
+//? FONCTION DE DETECTION DES CONTOURS(Usage de l'approximation discret du LAPLACIEN)
+---------------------------------------------*/
+ImagePGM *filtre_laplacien(ImagePGM *image)
+{
+    return convolution_3x3(image, &NOYAU_LAPLACIEN, CONVOLUTION_VALEUR_ABSOLUE, 0);
+}
+
+
+
+/*-------------------------------------------
+//? FONCTION DE DETECTION DES CONTOURS AVEC SEUIL(Prewitt)
+---------------------------------------------*/
+ImagePGM *filtre_prewitt_seuil(ImagePGM *image, int seuil)
+{
+    return gradient(image, &NOYAU_PREWITT_X, &NOYAU_PREWITT_Y, CONVOLUTION_SEUIL, seuil);
+}
+
+/*-------------------------------------------
+//? FONCTION DE DETECTION DES CONTOURS AVEC SEUIL(Sobel)
+---------------------------------------------*/
+ImagePGM *filtre_sobel_seuil(ImagePGM *image, int seuil)
+{
+    return gradient(image, &NOYAU_SOBEL_X, &NOYAU_SOBEL_Y, CONVOLUTION_SEUIL, seuil);
+}
+
+/*-------------------------------------------
+//? FONCTION DE DETECTION DES CONTOURS AVEC SEUIL(Robert)
+---------------------------------------------*/
+ImagePGM *filtre_robert_seuil(ImagePGM *image, int seuil)
+{
+    return gradient(image, NULL, NULL, CONVOLUTION_SEUIL, seuil);
+}
+
+/*-------------------------------------------
+//? FONCTION DE DETECTION DES CONTOURS AVEC SEUIL(Usage de l'approximation discret du LAPLACIEN)
+---------------------------------------------*/
+ImagePGM *filtre_laplacien_seuil(ImagePGM *image, int seuil)
+{
+    return convolution_3x3(image, &NOYAU_LAPLACIEN, CONVOLUTION_SEUIL, seuil);
+}
+
+/*-------------------------------------------
+//? TRANSFORMÉE DE HOUGH
+//? les pixels de contour (Robert seuillé) votent pour les droites rho = i cos(theta) + j sin(theta),
+//? theta parcourant [0, 180] degrés par pas de pas_angle, rho signé dans [-diag, diag] découpé
+//? par pas de pas_rho (une droite dont la normale pointe hors de l'image a un rho négatif).
+//? sin/cos sont tabulés une fois en virgule fixe; chaque bande vote dans un accumulateur
+//? privé de 32 bits, les accumulateurs sont sommés à la fin.
+---------------------------------------------*/
+#define PRECISION_HOUGH 20
+
+//! contours (Robert seuillé) toujours sur 8 bits, 0 ou 255: les votes lisent des octets
+ImagePGM *contours_hough(ImagePGM *image, int seuil)
+{
+    ImagePGM *contours = filtre_robert_seuil(image, seuil);
+    if (!contours || !image_16_bits(contours))
+        return contours;
+    ImagePGM *octets = creer_image_pgm(contours->hauteur, contours->largeur, 255);
+    if (octets)
+    {
+        const unsigned short *src = (const unsigned short *)contours->data;
+        size_t nb_pixels = (size_t)contours->largeur * contours->hauteur;
+        for (size_t k = 0; k < nb_pixels; k++)
+        {
+            octets->data[k] = src[k] ? 255 : 0;
+        }
+    }
+    liberer_une_image(contours);
+    return octets;
+}
+
+typedef struct
+{
+    int seuil_contour;        //! seuil du gradient de Robert
+    unsigned int seuil_votes; //! votes minimum pour tracer une droite
+    double pas_angle;         //! en degrés
+    double pas_rho;           //! en pixels
+} ParametresHough;
+
+const ParametresHough PARAMETRES_HOUGH_DEFAUT = {0, 80, 1.0, 1.0};
+
+typedef struct
+{
+    int nb_angles;
+    int nb_rho;
+    int rho_zero; //! indice de rho = 0: la ligne r de l'accumulateur vaut rho = (r - rho_zero) x pas_rho
+    double pas_angle;
+    double pas_rho;
+    int *cos_fixe;       //! cos(theta) / pas_rho en virgule fixe
+    int *sin_fixe;       //! sin(theta) / pas_rho en virgule fixe
+    unsigned int *votes; //! nb_rho x nb_angles
+} AccumulateurHough;
+
+void liberer_accumulateur_hough(AccumulateurHough *acc)
+{
+    if (!acc)
+        return;
+    free(acc->cos_fixe);
+    free(acc->sin_fixe);
+    free(acc->votes);
+    free(acc);
+}
+
+//! "seuil[:votes[:pas_angle[:pas_rho]]]"; retourne 0 si les valeurs sont valides
+int analyser_parametres_hough(const char *parametre, ParametresHough *p)
+{
+    *p = PARAMETRES_HOUGH_DEFAUT;
+    if (parametre)
+        sscanf(parametre, "%d:%u:%lf:%lf", &p->seuil_contour, &p->seuil_votes, &p->pas_angle, &p->pas_rho);
+    if (!(p->pas_angle > 0 && p->pas_angle <= 180) || !(p->pas_rho > 0))
+    {
+        printf("résolution de Hough invalide: angle %g, rho %g\n", p->pas_angle, p->pas_rho);
+        return -1;
+    }
+    return 0;
+}
+
+AccumulateurHough *creer_accumulateur_hough(int hauteur, int largeur, double pas_angle, double pas_rho)
+{
+    AccumulateurHough *acc = calloc(1, sizeof(AccumulateurHough));
+    if (!acc)
+    {
+        perror("cannot allocate memory");
+        return NULL;
+    }
+    int diag = sqrt((double)hauteur * hauteur + (double)largeur * largeur);
+    acc->pas_angle = pas_angle;
+    acc->pas_rho = pas_rho;
+    acc->nb_angles = (int)floor(MAX_THETA / pas_angle + 1e-9) + 1;
+    acc->rho_zero = (int)ceil(diag / pas_rho);
+    acc->nb_rho = 2 * acc->rho_zero + 1;
+    acc->cos_fixe = malloc(acc->nb_angles * sizeof(int));
+    acc->sin_fixe = malloc(acc->nb_angles * sizeof(int));
+    acc->votes = calloc((size_t)acc->nb_rho * acc->nb_angles, sizeof(unsigned int));
+    if (!acc->cos_fixe || !acc->sin_fixe || !acc->votes)
+    {
+        perror("cannot allocate memory");
+        liberer_accumulateur_hough(acc);
+        return NULL;
+    }
+    for (int t = 0; t < acc->nb_angles; t++)
+    {
+        double theta = t * pas_angle * C_PI / 180;
+        acc->cos_fixe[t] = (int)lround(cos(theta) * (1 << PRECISION_HOUGH) / pas_rho);
+        acc->sin_fixe[t] = (int)lround(sin(theta) * (1 << PRECISION_HOUGH) / pas_rho);
+    }
+    return acc;
+}
+
+/*-------------------------------------------
+//? VOTE PAR BANDES DE LIGNES
+//? chaque bande prend un accumulateur privé libre (un par thread au plus), le remet ensuite
+---------------------------------------------*/
+typedef struct
+{
+    ImagePGM *contours;
+    AccumulateurHough *acc;
+    pthread_mutex_t verrou;
+    int nb_prives;
+    unsigned int **prives; //! accumulateurs privés, alloués à la première utilisation
+    int *libres;           //! pile des indices d'accumulateurs privés disponibles
+    int nb_libres;
+    int echec;             //! une bande n'a pas pu voter: l'accumulateur est incomplet
+} ContexteHough;
+
+static void hough_vote_bande(void *contexte, int debut, int fin)
+{
+    ContexteHough *c = contexte;
+    AccumulateurHough *acc = c->acc;
+    int largeur = c->contours->largeur;
+    int nb_angles = acc->nb_angles;
+    size_t taille = (size_t)acc->nb_rho * nb_angles;
+
+    pthread_mutex_lock(&c->verrou);
+    int indice = (c->nb_libres > 0) ? c->libres[--c->nb_libres] : -1;
+    if (indice >= 0 && !c->prives[indice])
+        c->prives[indice] = calloc(taille, sizeof(unsigned int));
+    unsigned int *votes = (indice >= 0) ? c->prives[indice] : NULL;
+    pthread_mutex_unlock(&c->verrou);
+
+    long long *base = malloc(nb_angles * sizeof(long long));
+    if (!votes || !base)
+    {
+        perror("cannot allocate memory");
+        free(base);
+        pthread_mutex_lock(&c->verrou);
+        if (indice >= 0)
+            c->libres[c->nb_libres++] = indice;
+        c->echec = 1;
+        pthread_mutex_unlock(&c->verrou);
+        return;
+    }
+
+    for (int i = debut; i < fin; i++)
+    {
+        const unsigned char *ligne = c->contours->data + get_position(i, 0, largeur);
+        int base_calculee = 0;
+        for (int j = 0; j < largeur; j++)
+        {
+            if (ligne[j] < 240)
+                continue;
+            if (!base_calculee)
+            {
+                for (int t = 0; t < nb_angles; t++)
+                {
+                    base[t] = (long long)i * acc->cos_fixe[t];
+                }
+                base_calculee = 1;
+            }
+            for (int t = 0; t < nb_angles; t++)
+            {
+                //? troncature vers zéro, comme la conversion en entier: ]-1, 0[ vote pour rho = 0
+                long long v = base[t] + (long long)j * acc->sin_fixe[t];
+                long long r = acc->rho_zero + ((v < 0) ? -((-v) >> PRECISION_HOUGH) : (v >> PRECISION_HOUGH));
+                if (r >= 0 && r < acc->nb_rho)
+                    votes[r * nb_angles + t]++;
+            }
+        }
+    }
+    free(base);
+
+    pthread_mutex_lock(&c->verrou);
+    c->libres[c->nb_libres++] = indice;
+    pthread_mutex_unlock(&c->verrou);
+}
+
+//! somme des accumulateurs privés, par bandes de valeurs de rho
+static void hough_fusion_bande(void *contexte, int debut, int fin)
+{
+    ContexteHough *c = contexte;
+    size_t premier = (size_t)debut * c->acc->nb_angles;
+    size_t dernier = (size_t)fin * c->acc->nb_angles;
+    for (int p = 0; p < c->nb_prives; p++)
+    {
+        const unsigned int *prive = c->prives[p];
+        if (!prive)
+            continue;
+        for (size_t k = premier; k < dernier; k++)
+        {
+            c->acc->votes[k] += prive[k];
+        }
+    }
+}
+
+AccumulateurHough *hough_accumuler(ImagePGM *contours, double pas_angle, double pas_rho)
+{
+    AccumulateurHough *acc = creer_accumulateur_hough(contours->hauteur, contours->largeur, pas_angle, pas_rho);
+    if (!acc)
+        return NULL;
+
+    ContexteHough contexte = {.contours = contours, .acc = acc, .verrou = PTHREAD_MUTEX_INITIALIZER};
+    contexte.nb_prives = nb_threads_effectifs();
+    contexte.prives = calloc(contexte.nb_prives, sizeof(unsigned int *));
+    contexte.libres = malloc(contexte.nb_prives * sizeof(int));
+    if (!contexte.prives || !contexte.libres)
+    {
+        perror("cannot allocate memory");
+        free(contexte.prives);
+        free(contexte.libres);
+        liberer_accumulateur_hough(acc);
+        return NULL;
+    }
+    for (int p = 0; p < contexte.nb_prives; p++)
+    {
+        contexte.libres[p] = p;
+    }
+    contexte.nb_libres = contexte.nb_prives;
+
+    executer_par_bandes(contours->hauteur, hough_vote_bande, &contexte);
+    if (!contexte.echec)
+        executer_par_bandes(acc->nb_rho, hough_fusion_bande, &contexte);
+
+    for (int p = 0; p < contexte.nb_prives; p++)
+    {
+        free(contexte.prives[p]);
+    }
+    free(contexte.prives);
+    free(contexte.libres);
+    pthread_mutex_destroy(&contexte.verrou);
+    if (contexte.echec)
+    {
+        //? des votes manquent: aucune droite ne doit être tirée d'un accumulateur partiel
+        liberer_accumulateur_hough(acc);
+        return NULL;
+    }
+    return acc;
+}
+
+//! trace en blanc la droite (rho, theta) d'indices (r, t) dans l'image
+void hough_tracer_droite(ImagePGM *image, const AccumulateurHough *acc, int r, int t)
+{
+    double rho = (r - acc->rho_zero) * acc->pas_rho;
+    double theta = t * acc->pas_angle * C_PI / 180;
+    double cos_theta = cos(theta), sin_theta = sin(theta);
+    for (int j = 0; j < image->largeur; j++)
+    {
+        double X = (rho - j * sin_theta) / cos_theta;
+        if (X > -1 && X < image->hauteur)
+        {
+            PIXEL_ECRIRE(image->data, get_position((int)X, j, image->largeur), image->max_val, image_16_bits(image));
+        }
+    }
+}
+
+/*-------------------------------------------
+//? FONCTION D'IMPLÉMENTATION DE LA MÉTHODE DE HOUGH
+//? l'image d'entrée additionnée des droites ayant reçu au moins seuil_votes votes
+---------------------------------------------*/
+ImagePGM *hough_transform_parametres(ImagePGM *image1, const ParametresHough *p)
+{
+    ImagePGM *image = contours_hough(image1, p->seuil_contour);
+    if (!image)
+        return NULL;
+    AccumulateurHough *acc = hough_accumuler(image, p->pas_angle, p->pas_rho);
+    //? les contours rendent leur tampon au pool avant l'allocation de l'image des droites
+    liberer_une_image(image);
+    if (!acc)
+        return NULL;
+
+    // Initialisation de l'image contenant la droite contour
+    ImagePGM *imageDroite = init_image_pgm(image1->hauteur, image1->largeur, image1->max_val);
+    ImagePGM *imageFinale = NULL;
+    if (imageDroite)
+    {
+        //? tracé historique: seules les droites de rho positif ou nul
+        for (int r = acc->rho_zero; r < acc->nb_rho; r++)
+        {
+            for (int t = 0; t < acc->nb_angles; t++)
+            {
+                if (acc->votes[(size_t)r * acc->nb_angles + t] >= p->seuil_votes)
+                    hough_tracer_droite(imageDroite, acc, r, t);
+            }
+        }
+        // Construction de l'image finale en sommant l'image originale et l'image droite
+        imageFinale = somme_images(image1, imageDroite);
+    }
+
+    liberer_une_image(imageDroite);
+    liberer_accumulateur_hough(acc);
+    return imageFinale;
+}
+
+ImagePGM *hough_transform(ImagePGM *image1, int seuil)
+{
+    ParametresHough p = PARAMETRES_HOUGH_DEFAUT;
+    p.seuil_contour = seuil;
+    return hough_transform_parametres(image1, &p);
+}
+
+/*-------------------------------------------
+//? PICS DE L'ACCUMULATEUR DE HOUGH
+//? une cellule est un pic si elle atteint seuil_votes et domine sa fenêtre
+//? (2 RAYON_NMS_HOUGH + 1)² en (rho, theta); les K plus forts sont gardés dans un tas
+---------------------------------------------*/
+#define RAYON_NMS_HOUGH 2
+
+typedef struct
+{
+    int r; //! indice de rho
+    int t; //! indice de theta
+    unsigned int votes;
+} PicHough;
+
+//! ordre total: plus de votes d'abord, puis rho puis theta croissants (résultat indépendant des bandes)
+static int pic_hough_avant(const PicHough *a, const PicHough *b)
+{
+    if (a->votes != b->votes)
+        return a->votes > b->votes;
+    if (a->r != b->r)
+        return a->r < b->r;
+    return a->t < b->t;
+}
+
+//! tas des K meilleurs pics: le plus faible est à la racine
+typedef struct
+{
+    PicHough *pics;
+    int nb;
+    int capacite;
+} TasPics;
+
+static void tas_pics_echanger(PicHough *a, PicHough *b)
+{
+    PicHough tmp = *a;
+    *a = *b;
+    *b = tmp;
+}
+
+static void tas_pics_inserer(TasPics *tas, PicHough pic)
+{
+    if (tas->nb == tas->capacite)
+    {
+        //? plein: le nouveau pic ne remplace la racine que s'il la bat
+        if (!pic_hough_avant(&pic, &tas->pics[0]))
+            return;
+        tas->pics[0] = pic;
+        int i = 0;
+        for (;;)
+        {
+            int g = 2 * i + 1, d = g + 1, plus_faible = i;
+            if (g < tas->nb && pic_hough_avant(&tas->pics[plus_faible], &tas->pics[g]))
+                plus_faible = g;
+            if (d < tas->nb && pic_hough_avant(&tas->pics[plus_faible], &tas->pics[d]))
+                plus_faible = d;
+            if (plus_faible == i)
+                break;
+            tas_pics_echanger(&tas->pics[i], &tas->pics[plus_faible]);
+            i = plus_faible;
+        }
+        return;
+    }
+    int i = tas->nb++;
+    tas->pics[i] = pic;
+    while (i > 0 && pic_hough_avant(&tas->pics[(i - 1) / 2], &tas->pics[i]))
+    {
+        tas_pics_echanger(&tas->pics[i], &tas->pics[(i - 1) / 2]);
+        i = (i - 1) / 2;
+    }
+}
+
+static int comparer_pics(const void *a, const void *b)
+{
+    return pic_hough_avant(b, a) - pic_hough_avant(a, b);
+}
+
+typedef struct
+{
+    const AccumulateurHough *acc;
+    unsigned int seuil_votes;
+    TasPics *tas;
+    pthread_mutex_t verrou;
+    int echec; //! une bande n'a pas pu allouer son tas: des pics manquent
+} ContextePics;
+
+//! un voisin égal placé avant dans l'ordre de balayage l'emporte: un seul pic par plateau
+static int hough_est_maximum(const AccumulateurHough *acc, int r, int t, unsigned int votes)
+{
+    for (int dr = -RAYON_NMS_HOUGH; dr <= RAYON_NMS_HOUGH; dr++)
+    {
+        int rr = r + dr;
+        if (rr < 0 || rr >= acc->nb_rho)
+            continue;
+        const unsigned int *ligne = acc->votes + (size_t)rr * acc->nb_angles;
+        for (int dt = -RAYON_NMS_HOUGH; dt <= RAYON_NMS_HOUGH; dt++)
+        {
+            int tt = t + dt;
+            if (tt < 0 || tt >= acc->nb_angles || (dr == 0 && dt == 0))
+                continue;
+            int avant = (dr < 0) || (dr == 0 && dt < 0);
+            if (ligne[tt] > votes || (avant && ligne[tt] == votes))
+                return 0;
+        }
+    }
+    return 1;
+}
+
+static void hough_pics_bande(void *contexte, int debut, int fin)
+{
+    ContextePics *c = contexte;
+    const AccumulateurHough *acc = c->acc;
+    //? une bande ne peut pas fournir plus de pics qu'elle n'a de cellules
+    long long cellules = (long long)(fin - debut) * acc->nb_angles;
+    int capacite = (cellules < c->tas->capacite) ? (int)cellules : c->tas->capacite;
+    TasPics local = {malloc(capacite * sizeof(PicHough)), 0, capacite};
+    //? avec rho signé, theta = 180 répète theta = 0 (rho opposé): colonne ignorée pour ne pas
+    //? rendre deux fois la même droite
+    int nb_angles = acc->nb_angles;
+    if ((nb_angles - 1) * acc->pas_angle > MAX_THETA - 1e-9)
+        nb_angles--;
+    if (!local.pics)
+    {
+        perror("cannot allocate memory");
+        pthread_mutex_lock(&c->verrou);
+        c->echec = 1;
+        pthread_mutex_unlock(&c->verrou);
+        return;
+    }
+    for (int r = debut; r < fin; r++)
+    {
+        const unsigned int *ligne = acc->votes + (size_t)r * acc->nb_angles;
+        for (int t = 0; t < nb_angles; t++)
+        {
+            if (ligne[t] >= c->seuil_votes && ligne[t] > 0 && hough_est_maximum(acc, r, t, ligne[t]))
+            {
+                PicHough pic = {r, t, ligne[t]};
+                tas_pics_inserer(&local, pic);
+            }
+        }
+    }
+    pthread_mutex_lock(&c->verrou);
+    for (int k = 0; k < local.nb; k++)
+    {
+        tas_pics_inserer(c->tas, local.pics[k]);
+    }
+    pthread_mutex_unlock(&c->verrou);
+    free(local.pics);
+}
+
+//! remplit pics (capacité k) par votes décroissants; retourne le nombre de pics trouvés, -1 si une bande a échoué
+int hough_extraire_pics(const AccumulateurHough *acc, unsigned int seuil_votes, PicHough *pics, int k)
+{
+    if (k <= 0)
+        return 0;
+    TasPics tas = {pics, 0, k};
+    ContextePics contexte = {.acc = acc, .seuil_votes = seuil_votes, .tas = &tas, .verrou = PTHREAD_MUTEX_INITIALIZER};
+    executer_par_bandes(acc->nb_rho, hough_pics_bande, &contexte);
+    pthread_mutex_destroy(&contexte.verrou);
+    if (contexte.echec)
+        return -1;
+    qsort(pics, tas.nb, sizeof(PicHough), comparer_pics);
+    return tas.nb;
+}
+
+/*-------------------------------------------
+//? TRANSFORMÉE DE HOUGH PROBABILISTE PROGRESSIVE (Matas, Galambos, Kittler)
+//? les pixels de contour votent un par un dans un ordre aléatoire; dès qu'une cellule
+//? atteint seuil_votes, la droite est suivie depuis le pixel courant pour en extraire
+//? le segment, dont les pixels sont retirés (et leurs votes annulés).
+//? le tirage utilise une graine fixe: le résultat est reproductible
+---------------------------------------------*/
+#define NB_ANGLES_HOUGH_PROB 180
+
+typedef struct
+{
+    int seuil_contour;
+    int seuil_votes;
+    int longueur_min; //! longueur minimale d'un segment (en pixels sur l'axe principal)
+    int ecart_max;    //! trou maximal toléré le long d'un segment
+} ParametresHoughProb;
+
+const ParametresHoughProb PARAMETRES_HOUGH_PROB_DEFAUT = {0, 50, 30, 5};
+
+typedef struct
+{
+    int x0, y0, x1, y1; //! x: colonne, y: ligne
+    int votes;
+} SegmentHough;
+
+//! état des pixels de contour dans le masque
+enum
+{
+    PIXEL_RETIRE = 0,
+    PIXEL_EN_ATTENTE = 1,
+    PIXEL_A_VOTE = 2
+};
+
+//! "seuil[:votes[:longueur_min[:ecart_max]]]"
+int analyser_parametres_hough_prob(const char *parametre, ParametresHoughProb *p)
+{
+    *p = PARAMETRES_HOUGH_PROB_DEFAUT;
+    if (parametre)
+        sscanf(parametre, "%d:%d:%d:%d", &p->seuil_contour, &p->seuil_votes, &p->longueur_min, &p->ecart_max);
+    if (p->seuil_votes < 1 || p->longueur_min < 0 || p->ecart_max < 0)
+    {
+        printf("paramètres de hough_prob invalides: votes %d, longueur %d, écart %d\n", p->seuil_votes, p->longueur_min, p->ecart_max);
+        return -1;
+    }
+    return 0;
+}
+
+static unsigned int hough_prob_aleatoire(unsigned int *etat)
+{
+    //? xorshift32
+    unsigned int x = *etat;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *etat = x;
+}
+
+//! retourne le nombre de segments écrits dans *segments (à libérer), -1 en cas d'erreur
+int hough_probabiliste(ImagePGM *contours, const ParametresHoughProb *p, SegmentHough **segments)
+{
+    int hauteur = contours->hauteur, largeur = contours->largeur;
+    int diag = (int)ceil(sqrt((double)hauteur * hauteur + (double)largeur * largeur));
+    int nb_rho = 2 * diag + 1;
+    size_t nb_pixels = (size_t)hauteur * largeur;
+
+    int cos_fixe[NB_ANGLES_HOUGH_PROB], sin_fixe[NB_ANGLES_HOUGH_PROB];
+    for (int t = 0; t < NB_ANGLES_HOUGH_PROB; t++)
+    {
+        cos_fixe[t] = (int)lround(cos(t * C_PI / 180) * (1 << PRECISION_HOUGH));
+        sin_fixe[t] = (int)lround(sin(t * C_PI / 180) * (1 << PRECISION_HOUGH));
+    }
+
+    //? liste des pixels de contour et masque de ceux qui restent
+    size_t nb_points = 0;
+    for (size_t k = 0; k < nb_pixels; k++)
+    {
+        nb_points += contours->data[k] >= 240;
+    }
+    unsigned char *masque = calloc(nb_pixels, 1);
+    int *points = malloc((nb_points ? nb_points : 1) * sizeof(int) * 2);
+    int *votes = calloc((size_t)nb_rho * NB_ANGLES_HOUGH_PROB, sizeof(int));
+    int capacite = 64, nb_segments = 0;
+    *segments = malloc(capacite * sizeof(SegmentHough));
+    if (!masque || !points || !votes || !*segments)
+    {
+        perror("cannot allocate memory");
+        free(masque);
+        free(points);
+        free(votes);
+        free(*segments);
+        *segments = NULL;
+        return -1;
+    }
+    size_t n = 0;
+    for (int i = 0; i < hauteur; i++)
+    {
+        for (int j = 0; j < largeur; j++)
+        {
+            if (contours->data[get_position(i, j, largeur)] >= 240)
+            {
+                masque[get_position(i, j, largeur)] = PIXEL_EN_ATTENTE;
+                points[2 * n] = i;
+                points[2 * n + 1] = j;
+                n++;
+            }
+        }
+    }
+
+    //? ordre de tirage: mélange de Fisher-Yates
+    unsigned int graine = 2463534242u;
+    for (size_t k = nb_points; k > 1; k--)
+    {
+        size_t l = hough_prob_aleatoire(&graine) % k;
+        int i = points[2 * (k - 1)], j = points[2 * (k - 1) + 1];
+        points[2 * (k - 1)] = points[2 * l];
+        points[2 * (k - 1) + 1] = points[2 * l + 1];
+        points[2 * l] = i;
+        points[2 * l + 1] = j;
+    }
+
+    for (size_t k = 0; k < nb_points; k++)
+    {
+        int i = points[2 * k], j = points[2 * k + 1];
+        if (masque[get_position(i, j, largeur)] != PIXEL_EN_ATTENTE)
+            continue;
+        masque[get_position(i, j, largeur)] = PIXEL_A_VOTE;
+
+        //? vote, en retenant la cellule la plus forte de ce pixel
+        int meilleur_votes = 0, meilleur_t = 0;
+        for (int t = 0; t < NB_ANGLES_HOUGH_PROB; t++)
+        {
+            long long v = (long long)i * cos_fixe[t] + (long long)j * sin_fixe[t];
+            int r = (int)((v + (1 << (PRECISION_HOUGH - 1))) >> PRECISION_HOUGH) + diag;
+            int *cellule = votes + (size_t)r * NB_ANGLES_HOUGH_PROB + t;
+            if (++*cellule > meilleur_votes)
+            {
+                meilleur_votes = *cellule;
+                meilleur_t = t;
+            }
+        }
+        if (meilleur_votes < p->seuil_votes)
+            continue;
+
+        //? suivi de la droite: pas unité sur l'axe principal, pas fractionnaire (virgule fixe) sur l'autre
+        double theta = meilleur_t * C_PI / 180;
+        double di = -sin(theta), dj = cos(theta);
+        long long pas_i, pas_j;
+        if (fabs(di) > fabs(dj))
+        {
+            pas_i = (di > 0) ? (1LL << PRECISION_HOUGH) : -(1LL << PRECISION_HOUGH);
+            pas_j = (long long)llround(dj / fabs(di) * (1 << PRECISION_HOUGH));
+        }
+        else
+        {
+            pas_j = (dj > 0) ? (1LL << PRECISION_HOUGH) : -(1LL << PRECISION_HOUGH);
+            pas_i = (long long)llround(di / fabs(dj) * (1 << PRECISION_HOUGH));
+        }
+        long long demi = 1LL << (PRECISION_HOUGH - 1);
+
+        int extremites[2][2] = {{i, j}, {i, j}};
+        for (int sens = 0; sens < 2; sens++)
+        {
+            long long fi = ((long long)i << PRECISION_HOUGH) + demi;
+            long long fj = ((long long)j << PRECISION_HOUGH) + demi;
+            long long si = sens ? -pas_i : pas_i, sj = sens ? -pas_j : pas_j;
+            int ecart = 0;
+            for (;;)
+            {
+                fi += si;
+                fj += sj;
+                int ci = (int)(fi >> PRECISION_HOUGH), cj = (int)(fj >> PRECISION_HOUGH);
+                if (ci < 0 || ci >= hauteur || cj < 0 || cj >= largeur)
+                    break;
+                if (masque[get_position(ci, cj, largeur)] != PIXEL_RETIRE)
+                {
+                    ecart = 0;
+                    extremites[sens][0] = ci;
+                    extremites[sens][1] = cj;
+                }
+                else if (++ecart > p->ecart_max)
+                    break;
+            }
+        }
+
+        int longueur_i = abs(extremites[1][0] - extremites[0][0]);
+        int longueur_j = abs(extremites[1][1] - extremites[0][1]);
+        int retenu = (longueur_i > longueur_j ? longueur_i : longueur_j) >= p->longueur_min;
+
+        //? retrait des pixels du segment; ceux qui avaient voté rendent leurs votes
+        for (int sens = 0; sens < 2; sens++)
+        {
+            long long fi = ((long long)i << PRECISION_HOUGH) + demi;
+            long long fj = ((long long)j << PRECISION_HOUGH) + demi;
+            long long si = sens ? -pas_i : pas_i, sj = sens ? -pas_j : pas_j;
+            for (;;)
+            {
+                int ci = (int)(fi >> PRECISION_HOUGH), cj = (int)(fj >> PRECISION_HOUGH);
+                unsigned char *etat = masque + get_position(ci, cj, largeur);
+                if (*etat == PIXEL_A_VOTE && retenu)
+                {
+                    for (int t = 0; t < NB_ANGLES_HOUGH_PROB; t++)
+                    {
+                        long long v = (long long)ci * cos_fixe[t] + (long long)cj * sin_fixe[t];
+                        int r = (int)((v + (1 << (PRECISION_HOUGH - 1))) >> PRECISION_HOUGH) + diag;
+                        votes[(size_t)r * NB_ANGLES_HOUGH_PROB + t]--;
+                    }
+                }
+                *etat = PIXEL_RETIRE;
+                if (ci == extremites[sens][0] && cj == extremites[sens][1])
+                    break;
+                fi += si;
+                fj += sj;
+            }
+        }
+
+        if (!retenu)
+            continue;
+        if (nb_segments == capacite)
+        {
+            capacite *= 2;
+            SegmentHough *agrandi = realloc(*segments, capacite * sizeof(SegmentHough));
+            if (!agrandi)
+            {
+                perror("cannot allocate memory");
+                break;
+            }
+            *segments = agrandi;
+        }
+        SegmentHough segment = {extremites[0][1], extremites[0][0], extremites[1][1], extremites[1][0], meilleur_votes};
+        (*segments)[nb_segments++] = segment;
+    }
+
+    free(masque);
+    free(points);
+    free(votes);
+    return nb_segments;
+}
+
+//! tracé d'un segment (Bresenham) en blanc
+void tracer_segment(ImagePGM *image, const SegmentHough *s)
+{
+    int dx = abs(s->x1 - s->x0), dy = -abs(s->y1 - s->y0);
+    int sx = (s->x0 < s->x1) ? 1 : -1, sy = (s->y0 < s->y1) ? 1 : -1;
+    int erreur = dx + dy;
+    int x = s->x0, y = s->y0;
+    for (;;)
+    {
+        PIXEL_ECRIRE(image->data, get_position(y, x, image->largeur), image->max_val, image_16_bits(image));
+        if (x == s->x1 && y == s->y1)
+            break;
+        int e2 = 2 * erreur;
+        if (e2 >= dy)
+        {
+            erreur += dy;
+            x += sx;
+        }
+        if (e2 <= dx)
+        {
+            erreur += dx;
+            y += sy;
+        }
+    }
+}
+
+
+/*-------------------------------------------
+//? ZOOM PAR BANDES: moyenne 2x2 (réduction) ou duplication 2x2 (agrandissement)
+---------------------------------------------*/
+typedef struct
+{
+    ImagePGM *image;
+    ImagePGM *sortie;
+} ContexteZoom;
+
+//! lignes [debut, fin[ de la petite image, lues dans les lignes 2i et 2i+1 de l'image source
+SPECIALISE void zoom_in_bande(void *contexte, int debut, int fin, const int seize)
+{
+    ContexteZoom *c = contexte;
+    for (int i = debut; i < fin; i++)
+    {
+        const unsigned char *l0 = ligne_image(c->image, 2 * i);
+        const unsigned char *l1 = ligne_image(c->image, 2 * i + 1);
+        unsigned char *dst = ligne_image(c->sortie, i);
+        for (int j = 0; j < c->sortie->largeur; j++)
+        {
+            PIXEL_ECRIRE(dst, j, (PIXEL_LIRE(l0, 2 * j, seize) + PIXEL_LIRE(l0, 2 * j + 1, seize) + PIXEL_LIRE(l1, 2 * j, seize) + PIXEL_LIRE(l1, 2 * j + 1, seize)) >> 2, seize);
+        }
+    }
+}
+SPECIALISER_BANDE(zoom_in_bande)
+
+//! lignes [debut, fin[ de l'image source, écrites dans les lignes 2i et 2i+1 de la grande image
+SPECIALISE void zoom_out_bande(void *contexte, int debut, int fin, const int seize)
+{
+    ContexteZoom *c = contexte;
+    int largeur = c->image->largeur;
+    for (int i = debut; i < fin; i++)
+    {
+        const unsigned char *src = ligne_image(c->image, i);
+        unsigned char *d0 = ligne_image(c->sortie, 2 * i);
+        unsigned char *d1 = ligne_image(c->sortie, 2 * i + 1);
+        for (int j = 0; j < largeur; j++)
+        {
+            int v = PIXEL_LIRE(src, j, seize);
+            PIXEL_ECRIRE(d0, 2 * j, v, seize);
+            PIXEL_ECRIRE(d0, 2 * j + 1, v, seize);
+        }
+        memcpy(d1, d0, (size_t)c->sortie->largeur * (seize ? 2 : 1));
+    }
+}
+SPECIALISER_BANDE(zoom_out_bande)
+
+/*-------------------------------------------
+//? FONCTION ZOOM IN (reduction de la taille d'une image)
+---------------------------------------------*/
+ImagePGM *zomm_in(ImagePGM *image)
+{
+    //?initialisation des images
+    ImagePGM *small_image = creer_image_pgm(image->hauteur / 2, image->largeur / 2, image->max_val);
+    if (!small_image)
+        return NULL;
+
+    ContexteZoom contexte = {image, small_image};
+    executer_par_bandes(small_image->hauteur, image_16_bits(image) ? zoom_in_bande_16 : zoom_in_bande_8, &contexte);
+
+    return small_image;
+}
+
+/*-------------------------------------------
+//? FONCTION ZOOM OUT (augmentation de la taille d'une image)
+---------------------------------------------*/
+ImagePGM *zomm_out(ImagePGM *image)
+{
+    //?initialisation des images
+    ImagePGM *big_image = creer_image_pgm(image->hauteur * 2, image->largeur * 2, image->max_val);
+    if (!big_image)
+        return NULL;
+
+    ContexteZoom contexte = {image, big_image};
+    executer_par_bandes(image->hauteur, image_16_bits(image) ? zoom_out_bande_16 : zoom_out_bande_8, &contexte);
+
+    return big_image;
+}
+
+/*-------------------------------------------
+//? FONCTION D'IMPLÉMENTATION DE LA MÉTHODE DE OTSU
+//? variance inter-classes w0 w1 (m0 - m1)² calculée en une passe sur les sommes cumulées
+//? de l'histogramme; le seuil retourné est le premier niveau de la classe claire
+---------------------------------------------*/
+int seuil_otsu_histogramme(const unsigned int *h, int max_val)
+{
+    int seuil = 1;
+    double total = 0.0, somme_totale = 0.0;
+    for (int v = 0; v <= max_val; v++)
+    {
+        total += h[v];
+        somme_totale += (double)v * h[v];
+    }
+
+    double w0 = 0.0, somme0 = 0.0, meilleure = -1.0;
+    for (int t = 0; t < max_val; t++)
+    {
+        w0 += h[t];
+        somme0 += (double)t * h[t];
+        double w1 = total - w0;
+        if (w0 == 0.0 || w1 == 0.0)
+            continue;
+        double ecart = somme0 / w0 - (somme_totale - somme0) / w1;
+        double variance = w0 * w1 * ecart * ecart;
+        if (variance > meilleure)
+        {
+            meilleure = variance;
+            seuil = t + 1;
+        }
+    }
+    return seuil;
+}
+
+int seuil_otsu(ImagePGM *image)
+{
+    unsigned int *hist = creer_histogramme(image);
+    if (!hist)
+        return -1;
+    int seuil = seuil_otsu_histogramme(hist, image->max_val);
+    free(hist);
+    return seuil;
+}
+
+/*-------------------------------------------
+//? OTSU MULTI-NIVEAUX (Liao, Chen et Chung)
+//? maximiser la variance inter-classes revient à maximiser la somme des S(u,v)² / P(u,v)
+//? des classes [u, v]; ces termes sont tabulés puis la meilleure partition est trouvée
+//? par programmation dynamique en O(nb_seuils L²).
+//? seuils[c] est le premier niveau de la classe c + 1.
+//? au-delà de 256 niveaux (16 bits), L² devient prohibitif: la recherche se fait sur
+//? l'histogramme regroupé en 256 cases, et les seuils sont ramenés à l'échelle d'origine
+---------------------------------------------*/
+#define MAX_SEUILS_OTSU 3
+
+int seuils_otsu_histogramme(const unsigned int *h, int max_val, int nb_seuils, int *seuils)
+{
+    if (max_val > 255)
+    {
+        unsigned int regroupe[NIVEAUX_8_BITS] = {0};
+        for (int v = 0; v <= max_val; v++)
+        {
+            regroupe[(long long)v * NIVEAUX_8_BITS / (max_val + 1)] += h[v];
+        }
+        if (seuils_otsu_histogramme(regroupe, NIVEAUX_8_BITS - 1, nb_seuils, seuils) != 0)
+            return -1;
+        for (int c = 0; c < nb_seuils; c++)
+        {
+            //? premier niveau d'origine de la case seuils[c]
+            seuils[c] = (int)(((long long)seuils[c] * (max_val + 1) + NIVEAUX_8_BITS - 1) / NIVEAUX_8_BITS);
+        }
+        return 0;
+    }
+    int niveaux = max_val + 1;
+    if (nb_seuils < 1 || nb_seuils > MAX_SEUILS_OTSU || nb_seuils >= niveaux)
+    {
+        printf("nombre de seuils d'Otsu invalide: %d (1 à %d)\n", nb_seuils, MAX_SEUILS_OTSU);
+        return -1;
+    }
+    double *cumul_p = malloc((niveaux + 1) * sizeof(double));
+    double *cumul_s = malloc((niveaux + 1) * sizeof(double));
+    double *table = malloc((size_t)niveaux * niveaux * sizeof(double));
+    double *meilleur = malloc((size_t)(nb_seuils + 1) * niveaux * sizeof(double));
+    int *origine = malloc((size_t)(nb_seuils + 1) * niveaux * sizeof(int));
+    int code = 0;
+    if (!cumul_p || !cumul_s || !table || !meilleur || !origine)
+    {
+        perror("cannot allocate memory");
+        code = -1;
+        goto fin;
+    }
+
+    cumul_p[0] = cumul_s[0] = 0.0;
+    for (int v = 0; v < niveaux; v++)
+    {
+        cumul_p[v + 1] = cumul_p[v] + h[v];
+        cumul_s[v + 1] = cumul_s[v] + (double)v * h[v];
+    }
+    //? table[u][v] = S(u, v)² / P(u, v) pour la classe [u, v]
+    for (int u = 0; u < niveaux; u++)
+    {
+        for (int v = u; v < niveaux; v++)
+        {
+            double p = cumul_p[v + 1] - cumul_p[u];
+            double s = cumul_s[v + 1] - cumul_s[u];
+            table[(size_t)u * niveaux + v] = (p > 0.0) ? s * s / p : 0.0;
+        }
+    }
+
+    //? meilleur[c][v]: meilleure somme pour les niveaux [0, v] découpés en c + 1 classes
+    for (int v = 0; v < niveaux; v++)
+    {
+        meilleur[v] = table[v];
+        origine[v] = 0;
+    }
+    for (int c = 1; c <= nb_seuils; c++)
+    {
+        double *courant = meilleur + (size_t)c * niveaux;
+        const double *precedent = meilleur + (size_t)(c - 1) * niveaux;
+        for (int v = c; v < niveaux; v++)
+        {
+            double record = -1.0;
+            int debut = c;
+            for (int u = c; u <= v; u++)
+            {
+                double valeur = precedent[u - 1] + table[(size_t)u * niveaux + v];
+                if (valeur > record)
+                {
+                    record = valeur;
+                    debut = u;
+                }
+            }
+            courant[v] = record;
+            origine[(size_t)c * niveaux + v] = debut;
+        }
+    }
+
+    //? remontée de la partition optimale
+    int v = niveaux - 1;
+    for (int c = nb_seuils; c >= 1; c--)
+    {
+        seuils[c - 1] = origine[(size_t)c * niveaux + v];
+        v = seuils[c - 1] - 1;
+    }
+
+fin:
+    free(cumul_p);
+    free(cumul_s);
+    free(table);
+    free(meilleur);
+    free(origine);
+    return code;
+}
+
+//! table à nb_seuils + 1 niveaux régulièrement espacés de 0 à max_val
+int table_otsu(void *table, const unsigned int *hist, int max_val, int nb_seuils)
+{
+    int seuils[MAX_SEUILS_OTSU];
+    if (nb_seuils == 1)
+        seuils[0] = seuil_otsu_histogramme(hist, max_val);
+    else if (seuils_otsu_histogramme(hist, max_val, nb_seuils, seuils) != 0)
+        return -1;
+
+    int classe = 0;
+    int seize = max_val > 255;
+    for (int v = 0; v < niveaux_table(max_val); v++)
+    {
+        while (classe < nb_seuils && v >= seuils[classe])
+            classe++;
+        PIXEL_ECRIRE(table, v, classe * max_val / nb_seuils, seize);
+    }
+    return 0;
+}
+
+int otsu_multi_dans(ImagePGM *image, ImagePGM *sortie, int nb_seuils)
+{
+    unsigned int *hist = creer_histogramme(image);
+    void *table = creer_table(image->max_val);
+    int code = (hist && table) ? table_otsu(table, hist, image->max_val, nb_seuils) : -1;
+    if (code == 0)
+        appliquer_table(image, sortie, table);
+    free(hist);
+    free(table);
+    return code;
+}
+
+ImagePGM *binaire_otsu(ImagePGM *image)
+{
+    int seuil = seuil_otsu(image);
+    return (seuil < 0) ? NULL : seuillage(image, seuil);
+}
+
+ImagePGM *otsu_multi(ImagePGM *image, int nb_seuils)
+{
+    ImagePGM *resultat = creer_image_pgm(image->hauteur, image->largeur, image->max_val);
+    if (!resultat)
+        return NULL;
+    if (otsu_multi_dans(image, resultat, nb_seuils) != 0)
+    {
+        liberer_une_image(resultat);
+        return NULL;
+    }
+    return resultat;
+}
+
+/*-------------------------------------------
+//? CHAÎNE D'OPÉRATIONS PONCTUELLES FUSIONNÉES
+//? chaque étape devient une table (un niveau par entrée), composée avec les précédentes:
+//? toute la chaîne coûte une seule passe sur les pixels. Les étapes qui dépendent
+//? de leur entrée (contraste, égalisation, Otsu) lisent l'histogramme de l'image
+//? source transporté à travers la table déjà composée, sans repasser sur les pixels.
+---------------------------------------------*/
+#define MAX_ETAPES_FUSION 16
+
+typedef struct
+{
+    OperationPonctuelle operation; //! LUMINOSITE, SEUIL, CONTRASTE, EGALISATION ou OTSU
+    int parametre;                 //! facteur, seuil ou nombre de seuils d'Otsu (0: 1)
+} EtapePonctuelle;
+
+static int etape_depend_histogramme(OperationPonctuelle operation)
+{
+    return operation == PONCTUEL_CONTRASTE || operation == PONCTUEL_EGALISATION || operation == PONCTUEL_OTSU;
+}
+
+//! table d'une étape à partir de l'histogramme de son entrée; retourne 0 si valide
+static int table_etape(const EtapePonctuelle *etape, const unsigned int *hist, int max_val, void *table)
+{
+    switch (etape->operation)
+    {
+    case PONCTUEL_LUMINOSITE:
+        table_luminosite(table, etape->parametre, max_val);
+        return 0;
+    case PONCTUEL_SEUIL:
+        table_seuil(table, etape->parametre, max_val);
+        return 0;
+    case PONCTUEL_CONTRASTE:
+    {
+        int dernier = niveaux_table(max_val) - 1;
+        int min = 0, max = dernier;
+        while (min < dernier && hist[min] == 0)
+            min++;
+        while (max > 0 && hist[max] == 0)
+            max--;
+        table_contraste(table, min, (max < min) ? min : max, max_val);
+        return 0;
+    }
+    case PONCTUEL_EGALISATION:
+        table_egalisation(table, hist, max_val);
+        return 0;
+    case PONCTUEL_OTSU:
+        return table_otsu(table, hist, max_val, etape->parametre ? etape->parametre : 1);
+    default:
+        return -1;
+    }
+}
+
+int appliquer_chaine_ponctuelle(ImagePGM *image, ImagePGM *sortie, const EtapePonctuelle *etapes, int nb_etapes)
+{
+    int seize = image_16_bits(image);
+    //? une seule étape arithmétique: son noyau vectoriel direct est moins cher qu'une table
+    if (nb_etapes == 1 && !etape_depend_histogramme(etapes[0].operation))
+    {
+        ContextePonctuel contexte = {.operation = etapes[0].operation, .a = image->data, .dst = sortie->data, .largeur = image->largeur, .parametre = etapes[0].parametre, .max_val = sortie->max_val, .seize = seize};
+        appliquer_ponctuel(&contexte, image->hauteur);
+        return 0;
+    }
+
+    int dernier_dependant = -1;
+    for (int k = 0; k < nb_etapes; k++)
+    {
+        if (etape_depend_histogramme(etapes[k].operation))
+            dernier_dependant = k;
+    }
+    int niveaux = niveaux_pixel(image);
+    unsigned int *hist = calloc(2 * (size_t)niveaux, sizeof(unsigned int)); //! + histogramme transporté
+    void *composee = creer_table(image->max_val);
+    void *table = creer_table(image->max_val);
+    int code = (hist && composee && table) ? 0 : -1;
+    if (code == 0 && dernier_dependant >= 0 && histogramme_dans(image, hist) != 0)
+        code = -1;
+
+    for (int v = 0; code == 0 && v < niveaux; v++)
+    {
+        PIXEL_ECRIRE(composee, v, v, seize);
+    }
+    for (int k = 0; code == 0 && k < nb_etapes; k++)
+    {
+        if (table_etape(&etapes[k], hist, sortie->max_val, table) != 0)
+        {
+            code = -1;
+            break;
+        }
+        composer_tables(composee, table, composee, sortie->max_val);
+        if (k < dernier_dependant)
+        {
+            //? histogramme de la sortie de l'étape k
+            unsigned int *transporte = hist + niveaux;
+            memset(transporte, 0, niveaux * sizeof(unsigned int));
+            for (int v = 0; v < niveaux; v++)
+            {
+                transporte[PIXEL_LIRE(table, v, seize)] += hist[v];
+            }
+            memcpy(hist, transporte, niveaux * sizeof(unsigned int));
+        }
+    }
+    if (code == 0)
+        appliquer_table(image, sortie, composee);
+    free(hist);
+    free(composee);
+    free(table);
+    return code;
+}
+
+int to_int(const char *word)
+{
+    int num = 0;
+    if (word)
+        sscanf(word, "%d", &num);
+    return num;
+}
+
+double to_double(const char *word)
+{
+    double num = 0;
+    if (word)
+        sscanf(word, "%lf", &num);
+    return num;
+}
+
+/*-------------------------------------------
+//? TABLE DES OPÉRATEURS À UNE IMAGE
+//? nom de la commande, fichier de sortie par défaut, paramètre entier attendu ou non,
+//? version qui alloue son résultat, version qui écrit dans une image de même taille
+//? (NULL si la taille change), opération ponctuelle équivalente pour la fusion et
+//? nombre de lignes d'entrée lues par ligne de sortie en mode flux (0: impossible)
+---------------------------------------------*/
+typedef struct
+{
+    const char *nom;
+    const char *fichier_sortie;
+    int avec_parametre;
+    ImagePGM *(*appliquer)(ImagePGM *image, const char *parametre);
+    int (*appliquer_dans)(ImagePGM *image, ImagePGM *sortie, const char *parametre);
+    OperationPonctuelle ponctuelle;
+    int halo;
+} Operateur;
+
+static ImagePGM *op_contrast(ImagePGM *image, const char *parametre) { (void)parametre; return modification_basique_du_contraste(image); }
+static ImagePGM *op_eq_histogramme(ImagePGM *image, const char *parametre) { (void)parametre; return egaliser_histogramme(image); }
+static ImagePGM *op_clahe(ImagePGM *image, const char *parametre) { return clahe(image, parametre); }
+static ImagePGM *op_zoom_in(ImagePGM *image, const char *parametre) { (void)parametre; return zomm_in(image); }
+static ImagePGM *op_zoom_out(ImagePGM *image, const char *parametre) { (void)parametre; return zomm_out(image); }
+static ImagePGM *op_seuillage(ImagePGM *image, const char *parametre) { return seuillage(image, to_int(parametre)); }
+static ImagePGM *op_otsu(ImagePGM *image, const char *parametre) { return parametre ? otsu_multi(image, to_int(parametre)) : binaire_otsu(image); }
+static ImagePGM *op_moyenneur(ImagePGM *image, const char *parametre) { return parametre ? filtre_moyenneur_rayon(image, to_int(parametre)) : filtre_moyenneur(image); }
+static ImagePGM *op_gaussien(ImagePGM *image, const char *parametre) { return parametre ? filtre_gaussien_sigma(image, to_double(parametre)) : filtre_gaussien(image); }
+static ImagePGM *op_luminosite(ImagePGM *image, const char *parametre) { return modifier_luminosite(image, to_int(parametre)); }
+static ImagePGM *op_robert(ImagePGM *image, const char *parametre) { (void)parametre; return filtre_robert(image); }
+static ImagePGM *op_prewitt(ImagePGM *image, const char *parametre) { (void)parametre; return filtre_prewitt(image); }
+static ImagePGM *op_sobel(ImagePGM *image, const char *parametre) { (void)parametre; return filtre_sobel(image); }
+static ImagePGM *op_laplace(ImagePGM *image, const char *parametre) { (void)parametre; return filtre_laplacien(image); }
+static ImagePGM *op_robert_seuil(ImagePGM *image, const char *parametre) { return filtre_robert_seuil(image, to_int(parametre)); }
+static ImagePGM *op_prewitt_seuil(ImagePGM *image, const char *parametre) { return filtre_prewitt_seuil(image, to_int(parametre)); }
+static ImagePGM *op_sobel_seuil(ImagePGM *image, const char *parametre) { return filtre_sobel_seuil(image, to_int(parametre)); }
+static ImagePGM *op_laplace_seuil(ImagePGM *image, const char *parametre) { return filtre_laplacien_seuil(image, to_int(parametre)); }
+static ImagePGM *op_hough(ImagePGM *image, const char *parametre)
+{
+    ParametresHough p;
+    if (analyser_parametres_hough(parametre, &p) != 0)
+        return NULL;
+    return hough_transform_parametres(image, &p);
+}
+
+//! versions sans allocation, pour les tampons réutilisés du pipeline
+static int op_contrast_dans(ImagePGM *image, ImagePGM *sortie, const char *parametre) { (void)parametre; return contraste_dans(image, sortie); }
+static int op_eq_histogramme_dans(ImagePGM *image, ImagePGM *sortie, const char *parametre) { (void)parametre; return egaliser_histogramme_dans(image, sortie); }
+static int op_clahe_dans(ImagePGM *image, ImagePGM *sortie, const char *parametre)
+{
+    int grille;
+    double limite;
+    analyser_parametres_clahe(parametre, &grille, &limite);
+    return clahe_dans(image, sortie, grille, limite);
+}
+static int op_moyenneur_dans(ImagePGM *image, ImagePGM *sortie, const char *parametre)
+{
+    if (parametre)
+        return moyenneur_rayon_dans(image, sortie, to_int(parametre));
+    convolution_3x3_dans(image, sortie, &NOYAU_MOYENNEUR, CONVOLUTION_VALEUR_ABSOLUE, 0);
+    return 0;
+}
+static int op_gaussien_dans(ImagePGM *image, ImagePGM *sortie, const char *parametre)
+{
+    if (parametre)
+        return gaussien_sigma_dans(image, sortie, to_double(parametre));
+    convolution_3x3_dans(image, sortie, &NOYAU_GAUSSIEN, CONVOLUTION_VALEUR_ABSOLUE, 0);
+    return 0;
+}
+static int op_laplace_dans(ImagePGM *image, ImagePGM *sortie, const char *parametre) { (void)parametre; convolution_3x3_dans(image, sortie, &NOYAU_LAPLACIEN, CONVOLUTION_VALEUR_ABSOLUE, 0); return 0; }
+static int op_laplace_seuil_dans(ImagePGM *image, ImagePGM *sortie, const char *parametre) { convolution_3x3_dans(image, sortie, &NOYAU_LAPLACIEN, CONVOLUTION_SEUIL, to_int(parametre)); return 0; }
+static int op_robert_dans(ImagePGM *image, ImagePGM *sortie, const char *parametre) { (void)parametre; gradient_dans(image, sortie, NULL, NULL, CONVOLUTION_VALEUR_ABSOLUE, 0); return 0; }
+static int op_prewitt_dans(ImagePGM *image, ImagePGM *sortie, const char *parametre) { (void)parametre; gradient_dans(image, sortie, &NOYAU_PREWITT_X, &NOYAU_PREWITT_Y, CONVOLUTION_VALEUR_ABSOLUE, 0); return 0; }
+static int op_sobel_dans(ImagePGM *image, ImagePGM *sortie, const char *parametre) { (void)parametre; gradient_dans(image, sortie, &NOYAU_SOBEL_X, &NOYAU_SOBEL_Y, CONVOLUTION_VALEUR_ABSOLUE, 0); return 0; }
+static int op_robert_seuil_dans(ImagePGM *image, ImagePGM *sortie, const char *parametre) { gradient_dans(image, sortie, NULL, NULL, CONVOLUTION_SEUIL, to_int(parametre)); return 0; }
+static int op_prewitt_seuil_dans(ImagePGM *image, ImagePGM *sortie, const char *parametre) { gradient_dans(image, sortie, &NOYAU_PREWITT_X, &NOYAU_PREWITT_Y, CONVOLUTION_SEUIL, to_int(parametre)); return 0; }
+static int op_sobel_seuil_dans(ImagePGM *image, ImagePGM *sortie, const char *parametre) { gradient_dans(image, sortie, &NOYAU_SOBEL_X, &NOYAU_SOBEL_Y, CONVOLUTION_SEUIL, to_int(parametre)); return 0; }
+static int op_otsu_dans(ImagePGM *image, ImagePGM *sortie, const char *parametre)
+{
+    EtapePonctuelle etape = {PONCTUEL_OTSU, to_int(parametre)};
+    return appliquer_chaine_ponctuelle(image, sortie, &etape, 1);
+}
+
+const Operateur OPERATEURS[] = {
+    {"contrast", "contrast_img.pgm", 0, op_contrast, op_contrast_dans, PONCTUEL_CONTRASTE, 1},
+    {"eq_histogramme", "eq_hist_img.pgm", 0, op_eq_histogramme, op_eq_histogramme_dans, PONCTUEL_EGALISATION, 1},
+    {"clahe", "clahe_img.pgm", 0, op_clahe, op_clahe_dans, PONCTUEL_AUCUNE, 0},
+    {"zoom_in", "zoom_in_img.pgm", 0, op_zoom_in, NULL, PONCTUEL_AUCUNE, 0},
+    {"zoom_out", "zoom_out_img.pgm", 0, op_zoom_out, NULL, PONCTUEL_AUCUNE, 0},
+    {"seuillage", "binaire_img.pgm", 1, op_seuillage, NULL, PONCTUEL_SEUIL, 1},
+    {"otsu", "otsu_img.pgm", 0, op_otsu, op_otsu_dans, PONCTUEL_OTSU, 1},
+    {"moyenneur", "moyenneur_img.pgm", 0, op_moyenneur, op_moyenneur_dans, PONCTUEL_AUCUNE, 3},
+    {"gaussien", "gaussien_img.pgm", 0, op_gaussien, op_gaussien_dans, PONCTUEL_AUCUNE, 3},
+    {"luminosite", "lumin_img.pgm", 1, op_luminosite, NULL, PONCTUEL_LUMINOSITE, 1},
+    {"robert", "robert_img.pgm", 0, op_robert, op_robert_dans, PONCTUEL_AUCUNE, 2},
+    {"prewitt", "prewitt_img.pgm", 0, op_prewitt, op_prewitt_dans, PONCTUEL_AUCUNE, 3},
+    {"sobel", "sobel_img.pgm", 0, op_sobel, op_sobel_dans, PONCTUEL_AUCUNE, 3},
+    {"laplace", "laplace_img.pgm", 0, op_laplace, op_laplace_dans, PONCTUEL_AUCUNE, 3},
+    {"robert_seuil", "robert_seuil_img.pgm", 1, op_robert_seuil, op_robert_seuil_dans, PONCTUEL_AUCUNE, 2},
+    {"prewitt_seuil", "prewitt_seuil_img.pgm", 1, op_prewitt_seuil, op_prewitt_seuil_dans, PONCTUEL_AUCUNE, 3},
+    {"sobel_seuil", "sobel_seuil_img.pgm", 1, op_sobel_seuil, op_sobel_seuil_dans, PONCTUEL_AUCUNE, 3},
+    {"laplace_seuil", "laplace_seuil_img.pgm", 1, op_laplace_seuil, op_laplace_seuil_dans, PONCTUEL_AUCUNE, 3},
+    {"hough", "hough_img.pgm", 1, op_hough, NULL, PONCTUEL_AUCUNE, 0},
+};
+#define NB_OPERATEURS (int)(sizeof(OPERATEURS) / sizeof(OPERATEURS[0]))
+
+const Operateur *trouver_operateur(const char *nom)
+{
+    for (int k = 0; k < NB_OPERATEURS; k++)
+    {
+        if (strcmp(OPERATEURS[k].nom, nom) == 0)
+            return &OPERATEURS[k];
+    }
+    return NULL;
+}
+
+//! application d'un opérateur, mesurée sous son nom par --profile
+ImagePGM *appliquer_operateur(const Operateur *operateur, ImagePGM *image, const char *parametre)
+{
+    MesureProfil mesure;
+    PROFIL_DEBUT(mesure);
+    ImagePGM *resultat = operateur->appliquer(image, parametre);
+    PROFIL_FIN(mesure, operateur->nom);
+    return resultat;
+}
+
+int appliquer_operateur_dans(const Operateur *operateur, ImagePGM *image, ImagePGM *sortie, const char *parametre)
+{
+    MesureProfil mesure;
+    PROFIL_DEBUT(mesure);
+    int code = operateur->appliquer_dans(image, sortie, parametre);
+    PROFIL_FIN(mesure, operateur->nom);
+    return code;
+}
+
+/*-------------------------------------------
+//? FILE BORNÉE ENTRE LES ÉTAPES DU MODE BATCH
+---------------------------------------------*/
+typedef struct
+{
+    char *entree;
+    char *sortie;
+    ImagePGM *image; //! NULL si l'étape précédente a échoué
+} ElementBatch;
+
+typedef struct
+{
+    ElementBatch *elements;
+    int capacite;
+    int debut;
+    int nombre;
+    int fermee;
+    pthread_mutex_t verrou;
+    pthread_cond_t non_vide;
+    pthread_cond_t non_pleine;
+} FileBatch;
+
+int file_batch_init(FileBatch *file, int capacite)
+{
+    file->elements = malloc(capacite * sizeof(ElementBatch));
+    if (!file->elements)
+        return -1;
+    file->capacite = capacite;
+    file->debut = 0;
+    file->nombre = 0;
+    file->fermee = 0;
+    pthread_mutex_init(&file->verrou, NULL);
+    pthread_cond_init(&file->non_vide, NULL);
+    pthread_cond_init(&file->non_pleine, NULL);
+    return 0;
+}
+
+void file_batch_detruire(FileBatch *file)
+{
+    pthread_mutex_destroy(&file->verrou);
+    pthread_cond_destroy(&file->non_vide);
+    pthread_cond_destroy(&file->non_pleine);
+    free(file->elements);
+}
+
+//! bloque tant que la file est pleine (contre-pression sur l'étape précédente)
+void file_batch_deposer(FileBatch *file, ElementBatch element)
+{
+    pthread_mutex_lock(&file->verrou);
+    while (file->nombre == file->capacite)
+        pthread_cond_wait(&file->non_pleine, &file->verrou);
+    file->elements[(file->debut + file->nombre) % file->capacite] = element;
+    file->nombre++;
+    pthread_cond_signal(&file->non_vide);
+    pthread_mutex_unlock(&file->verrou);
+}
+
+//! retourne 0 quand la file est fermée et vide
+int file_batch_retirer(FileBatch *file, ElementBatch *element)
+{
+    pthread_mutex_lock(&file->verrou);
+    while (file->nombre == 0 && !file->fermee)
+        pthread_cond_wait(&file->non_vide, &file->verrou);
+    if (file->nombre == 0)
+    {
+        pthread_mutex_unlock(&file->verrou);
+        return 0;
+    }
+    *element = file->elements[file->debut];
+    file->debut = (file->debut + 1) % file->capacite;
+    file->nombre--;
+    pthread_cond_signal(&file->non_pleine);
+    pthread_mutex_unlock(&file->verrou);
+    return 1;
+}
+
+void file_batch_fermer(FileBatch *file)
+{
+    pthread_mutex_lock(&file->verrou);
+    file->fermee = 1;
+    pthread_cond_broadcast(&file->non_vide);
+    pthread_mutex_unlock(&file->verrou);
+}
+
+/*-------------------------------------------
+//? LISTE DES IMAGES D'ENTRÉE: fichiers *.pgm d'un dossier (triés), ou un chemin par ligne d'un fichier liste
+---------------------------------------------*/
+static int comparer_chemins(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static int ajouter_chemin(char ***chemins, int *nombre, int *capacite, const char *chemin)
+{
+    if (*nombre == *capacite)
+    {
+        int nouvelle = *capacite ? 2 * *capacite : 64;
+        char **plus_grand = realloc(*chemins, nouvelle * sizeof(char *));
+        if (!plus_grand)
+            return -1;
+        *chemins = plus_grand;
+        *capacite = nouvelle;
+    }
+    (*chemins)[*nombre] = strdup(chemin);
+    if (!(*chemins)[*nombre])
+        return -1;
+    (*nombre)++;
+    return 0;
+}
+
+char **lister_entrees(const char *source, int *nombre)
+{
+    char **chemins = NULL;
+    int capacite = 0;
+    *nombre = 0;
+
+    struct stat infos;
+    if (stat(source, &infos) != 0)
+    {
+        perror("cannot open");
+        return NULL;
+    }
+
+    if (S_ISDIR(infos.st_mode))
+    {
+        DIR *dossier = opendir(source);
+        if (!dossier)
+        {
+            perror("cannot open");
+            return NULL;
+        }
+        struct dirent *entree;
+        char chemin[4096];
+        while ((entree = readdir(dossier)) != NULL)
+        {
+            size_t longueur = strlen(entree->d_name);
+            if (longueur < 5 || strcmp(entree->d_name + longueur - 4, ".pgm") != 0)
+                continue;
+            snprintf(chemin, sizeof(chemin), "%s/%s", source, entree->d_name);
+            if (ajouter_chemin(&chemins, nombre, &capacite, chemin) != 0)
+                break;
+        }
+        closedir(dossier);
+        qsort(chemins, *nombre, sizeof(char *), comparer_chemins);
+        return chemins;
+    }
+
+    FILE *liste = fopen(source, "r");
+    if (!liste)
+    {
+        perror("cannot open");
+        return NULL;
+    }
+    char ligne[4096];
+    while (fgets(ligne, sizeof(ligne), liste))
+    {
+        ligne[strcspn(ligne, "\r\n")] = '\0';
+        if (ligne[0] == '\0' || ligne[0] == '#')
+            continue;
+        if (ajouter_chemin(&chemins, nombre, &capacite, ligne) != 0)
+            break;
+    }
+    fclose(liste);
+    return chemins;
+}
+
+/*-------------------------------------------
+//? CHEMIN DE SORTIE: %s du motif remplacé par le nom de l'entrée sans dossier ni extension,
+//? ou, sans %s, motif considéré comme un dossier de sortie
+---------------------------------------------*/
+char *construire_chemin_sortie(const char *motif, const char *entree)
+{
+    const char *nom = strrchr(entree, '/');
+    nom = nom ? nom + 1 : entree;
+    const char *point = strrchr(nom, '.');
+    int longueur_nom = point ? (int)(point - nom) : (int)strlen(nom);
+
+    size_t taille = strlen(motif) + strlen(nom) + 2;
+    char *chemin = malloc(taille);
+    if (!chemin)
+        return NULL;
+
+    const char *marque = strstr(motif, "%s");
+    if (marque)
+        snprintf(chemin, taille, "%.*s%.*s%s", (int)(marque - motif), motif, longueur_nom, nom, marque + 2);
+    else
+        snprintf(chemin, taille, "%s/%s", motif, nom);
+    return chemin;
+}
+
+/*-------------------------------------------
+//? MODE BATCH: lecture de l'image suivante, calcul de l'image courante et écriture
+//? de la précédente se recouvrent sur trois threads reliés par des files bornées
+---------------------------------------------*/
+#define PROFONDEUR_FILE_BATCH 2
+
+typedef struct
+{
+    char **entrees;
+    int nb_entrees;
+    const char *motif;
+    FileBatch lues;
+    FileBatch calculees;
+    int ecrites;
+} ContexteBatch;
+
+//! force la lecture des pages projetées sur le thread lecteur plutôt que pendant le calcul
+static void precharger_image(const ImagePGM *image)
+{
+    size_t nb_octets = (size_t)image->largeur * image->hauteur * octets_par_pixel(image);
+    volatile unsigned char somme = 0;
+    for (size_t i = 0; i < nb_octets; i += 4096)
+    {
+        somme += image->data[i];
+    }
+    (void)somme;
+}
+
+static void *batch_lecteur(void *argument)
+{
+    ContexteBatch *batch = argument;
+    for (int k = 0; k < batch->nb_entrees; k++)
+    {
+        ElementBatch element = {batch->entrees[k], construire_chemin_sortie(batch->motif, batch->entrees[k]), NULL};
+        element.image = lecture(element.entree);
+        if (element.image)
+            precharger_image(element.image);
+        file_batch_deposer(&batch->lues, element);
+    }
+    file_batch_fermer(&batch->lues);
+    return NULL;
+}
+
+static void *batch_ecrivain(void *argument)
+{
+    ContexteBatch *batch = argument;
+    ElementBatch element;
+    while (file_batch_retirer(&batch->calculees, &element))
+    {
+        if (element.image && element.sortie)
+        {
+            if (enregister_pgm(element.sortie, element.image) == 0)
+                batch->ecrites++;
+        }
+        else
+        {
+            fprintf(stderr, "échec: %s\n", element.entree);
+        }
+        liberer_une_image(element.image);
+        free(element.sortie);
+    }
+    return NULL;
+}
+
+int commande_batch(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        printf("usage: batch <commande> <dossier|liste> <motif_sortie> [<parametre>]\n");
+        return 1;
+    }
+    const Operateur *operateur = trouver_operateur(argv[0]);
+    if (!operateur)
+    {
+        printf("Commande inconnue.\n");
+        return 1;
+    }
+    if (operateur->avec_parametre && argc < 4)
+    {
+        printf("la commande %s attend un paramètre\n", operateur->nom);
+        return 1;
+    }
+    const char *parametre = (argc > 3) ? argv[3] : NULL;
+
+    ContexteBatch batch = {0};
+    batch.motif = argv[2];
+    batch.entrees = lister_entrees(argv[1], &batch.nb_entrees);
+    if (batch.nb_entrees == 0)
+    {
+        printf("aucune image à traiter\n");
+        free(batch.entrees);
+        return 1;
+    }
+    if (file_batch_init(&batch.lues, PROFONDEUR_FILE_BATCH) != 0 || file_batch_init(&batch.calculees, PROFONDEUR_FILE_BATCH) != 0)
+    {
+        perror("cannot allocate memory");
+        return 1;
+    }
+
+    pthread_t lecteur, ecrivain;
+    pthread_create(&lecteur, NULL, batch_lecteur, &batch);
+    pthread_create(&ecrivain, NULL, batch_ecrivain, &batch);
+
+    //? calcul sur le thread principal (qui répartit lui-même chaque image sur le pool)
+    ElementBatch element;
+    while (file_batch_retirer(&batch.lues, &element))
+    {
+        ImagePGM *resultat = element.image ? appliquer_operateur(operateur, element.image, parametre) : NULL;
+        liberer_une_image(element.image);
+        element.image = resultat;
+        file_batch_deposer(&batch.calculees, element);
+    }
+    file_batch_fermer(&batch.calculees);
+
+    pthread_join(lecteur, NULL);
+    pthread_join(ecrivain, NULL);
+    file_batch_detruire(&batch.lues);
+    file_batch_detruire(&batch.calculees);
+
+    printf("%d/%d images traitées\n", batch.ecrites, batch.nb_entrees);
+    int code = (batch.ecrites == batch.nb_entrees) ? 0 : 1;
+    for (int k = 0; k < batch.nb_entrees; k++)
+    {
+        free(batch.entrees[k]);
+    }
+    free(batch.entrees);
+    return code;
+}
+
+/*-------------------------------------------
+//? MODE FLUX POUR LES IMAGES PLUS GRANDES QUE LA MÉMOIRE
+//? flux <commande> <entree> <sortie> [<parametre>]
+//? le fichier P5 est lu par bandes de LIGNES_BANDE_FLUX lignes; les filtres à fenêtre
+//? gardent en tête de bande les lignes de la bande précédente dont leur fenêtre a encore
+//? besoin et chaque ligne de sortie est écrite dès que sa fenêtre est complète.
+//? mémoire: O(largeur x (LIGNES_BANDE_FLUX + halo)), indépendante de la hauteur.
+//? les opérations qui dépendent de l'histogramme (contrast, eq_histogramme, otsu)
+//? lisent le fichier deux fois: histogramme, puis application de la table.
+---------------------------------------------*/
+#define LIGNES_BANDE_FLUX 128
+#define TAILLE_ENTETE_FLUX 65536
+
+typedef struct
+{
+    FILE *fichier;
+    int largeur;
+    int hauteur;
+    int max_val;
+    long debut_pixels;
+    size_t octets_ligne; //! largeur x 1 ou 2 octets
+    int lignes_lues;
+    int tronque;
+} LecteurFlux;
+
+static int flux_ouvrir(LecteurFlux *lecteur, const char *chemin)
+{
+    memset(lecteur, 0, sizeof(LecteurFlux));
+    lecteur->fichier = fopen(chemin, "rb");
+    if (!lecteur->fichier)
+    {
+        perror(chemin);
+        return -1;
+    }
+    unsigned char entete[TAILLE_ENTETE_FLUX];
+    size_t lus = fread(entete, 1, sizeof(entete), lecteur->fichier);
+    size_t debut = analyser_entete_pgm(entete, lus, &lecteur->largeur, &lecteur->hauteur, &lecteur->max_val);
+    if (debut == 0 || debut >= lus + 1 || fseek(lecteur->fichier, (long)debut, SEEK_SET) != 0)
+    {
+        printf("%s: entête PGM (P5) invalide\n", chemin);
+        fclose(lecteur->fichier);
+        lecteur->fichier = NULL;
+        return -1;
+    }
+    lecteur->debut_pixels = (long)debut;
+    lecteur->octets_ligne = (size_t)lecteur->largeur * ((lecteur->max_val > 255) ? 2 : 1);
+    return 0;
+}
+
+//! lit nb lignes dans dst (16 bits: remis dans l'ordre natif); les pixels absents d'un fichier tronqué valent 0
+static void flux_lire_lignes(LecteurFlux *lecteur, unsigned char *dst, int nb)
+{
+    MesureProfil mesure;
+    PROFIL_DEBUT(mesure);
+    size_t attendu = (size_t)nb * lecteur->octets_ligne;
+    size_t lus = fread(dst, 1, attendu, lecteur->fichier);
+    if (lus < attendu)
+    {
+        memset(dst + lus, 0, attendu - lus);
+        if (!lecteur->tronque)
+            printf("Fichier PGM tronqué: pixels manquants mis à 0\n");
+        lecteur->tronque = 1;
+    }
+    if (lecteur->max_val > 255)
+    {
+        unsigned short *pixels = (unsigned short *)dst;
+        for (size_t k = 0; k < attendu / 2; k++)
+        {
+            pixels[k] = (unsigned short)(dst[2 * k] << 8 | dst[2 * k + 1]);
+        }
+    }
+    lecteur->lignes_lues += nb;
+    PROFIL_FIN(mesure, "flux_lecture");
+}
+
+//! copie les lignes dans le tampon de sortie: le vidage se fait pendant le calcul de la bande suivante
+static int flux_ecrire_lignes(const LecteurFlux *lecteur, SortiePGM *sortie, const unsigned char *src, int nb)
+{
+    MesureProfil mesure;
+    PROFIL_DEBUT(mesure);
+    int code = sortie_pixels(sortie, src, (size_t)nb * lecteur->largeur, lecteur->max_val > 255);
+    PROFIL_FIN(mesure, "flux_ecriture");
+    return code;
+}
+
+static int flux_rembobiner(LecteurFlux *lecteur)
+{
+    lecteur->lignes_lues = 0;
+    return fseek(lecteur->fichier, lecteur->debut_pixels, SEEK_SET);
+}
+
+//! passe de table sur tout le fichier (opérations ponctuelles)
+static int flux_table(LecteurFlux *lecteur, SortiePGM *sortie, const void *table, unsigned char *bande)
+{
+    ImagePGM vue = {.largeur = lecteur->largeur, .max_val = lecteur->max_val, .data = bande};
+    while (lecteur->lignes_lues < lecteur->hauteur)
+    {
+        int nb = lecteur->hauteur - lecteur->lignes_lues;
+        if (nb > LIGNES_BANDE_FLUX)
+            nb = LIGNES_BANDE_FLUX;
+        flux_lire_lignes(lecteur, bande, nb);
+        vue.hauteur = nb;
+        MesureProfil mesure;
+        PROFIL_DEBUT(mesure);
+        appliquer_table(&vue, &vue, table);
+        PROFIL_FIN(mesure, "table");
+        if (flux_ecrire_lignes(lecteur, sortie, bande, nb) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+//! filtre à fenêtre: la sortie de la ligne i dépend des lignes [i - avant, i + apres] de l'image
+//! (bornées à l'image); une ligne n'est écrite que si la bande contient toute sa fenêtre
+static int flux_fenetre(LecteurFlux *lecteur, SortiePGM *sortie, const Operateur *operateur, const char *parametre, int avant, int apres, unsigned char *entree, unsigned char *resultat)
+{
+    size_t largeur = lecteur->octets_ligne;
+    ImagePGM vue_entree = {.largeur = lecteur->largeur, .max_val = lecteur->max_val, .data = entree};
+    ImagePGM vue_sortie = {.largeur = lecteur->largeur, .max_val = lecteur->max_val, .data = resultat};
+    int reportees = 0; //! lignes gardées en tête de bande (au plus avant + apres)
+    int ecrites = 0;
+    while (lecteur->lignes_lues < lecteur->hauteur)
+    {
+        int nb = lecteur->hauteur - lecteur->lignes_lues;
+        if (nb > LIGNES_BANDE_FLUX)
+            nb = LIGNES_BANDE_FLUX;
+        flux_lire_lignes(lecteur, entree + reportees * largeur, nb);
+        int disponibles = reportees + nb;
+        int premiere = lecteur->lignes_lues - disponibles; //! ligne de l'image en tête de bande
+        int derniere = lecteur->lignes_lues == lecteur->hauteur;
+
+        //? les bords de la bande ne sont ceux de l'image qu'en haut (premiere == 0) et sur la
+        //? dernière bande: ailleurs, seules les lignes à fenêtre complète sont écrites
+        vue_entree.hauteur = vue_sortie.hauteur = disponibles;
+        if (appliquer_operateur_dans(operateur, &vue_entree, &vue_sortie, parametre) != 0)
+            return -1;
+        int fin = derniere ? lecteur->hauteur : lecteur->lignes_lues - apres;
+        if (fin > ecrites)
+        {
+            if (flux_ecrire_lignes(lecteur, sortie, resultat + (size_t)(ecrites - premiere) * largeur, fin - ecrites) != 0)
+                return -1;
+            ecrites = fin;
+        }
+
+        int garder = (ecrites - avant > premiere) ? ecrites - avant : premiere;
+        reportees = lecteur->lignes_lues - garder;
+        memmove(entree, entree + (size_t)(garder - premiere) * largeur, (size_t)reportees * largeur);
+    }
+    return 0;
+}
+
+int commande_flux(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        printf("usage: flux <commande> <entree> <sortie> [<parametre>]\n");
+        return 1;
+    }
+    const Operateur *operateur = trouver_operateur(argv[0]);
+    const char *parametre = (argc > 3) ? argv[3] : NULL;
+    if (!operateur)
+    {
+        printf("Commande inconnue: %s\n", argv[0]);
+        return 1;
+    }
+    if (operateur->avec_parametre && !parametre)
+    {
+        printf("la commande %s attend un paramètre\n", operateur->nom);
+        return 1;
+    }
+
+    //? largeur de fenêtre: fixée par la table (ancrée en haut: halo - 1 lignes après), sauf
+    //? moyenneur de rayon r, centré: r lignes avant et r lignes après
+    int halo = operateur->halo;
+    int avant = 0;
+    if (operateur->appliquer_dans == op_moyenneur_dans && parametre)
+    {
+        int rayon = to_int(parametre);
+        if (rayon < 1 || rayon > 32767) //! côté au plus 65535, comme moyenneur_rayon_dans
+        {
+            printf("rayon invalide: %d\n", rayon);
+            return 1;
+        }
+        avant = rayon;
+        halo = 2 * rayon + 1;
+    }
+    if (operateur->appliquer_dans == op_gaussien_dans && parametre)
+        halo = 0; //! flou centré à bords répliqués: pas de découpage en bandes exact
+    if (halo <= 0 || (halo > 1 && !operateur->appliquer_dans))
+    {
+        printf("la commande %s n'est pas disponible en mode flux\n", operateur->nom);
+        return 1;
+    }
+
+    if (codec_de_sortie(argv[2])->encoder != encoder_p5)
+    {
+        printf("le mode flux n'écrit que du PGM binaire (P5)\n");
+        return 1;
+    }
+
+    LecteurFlux lecteur;
+    if (flux_ouvrir(&lecteur, argv[1]) != 0)
+        return 1;
+    SortiePGM sortie;
+    int ouverte = sortie_ouvrir(&sortie, argv[2], 1) == 0;
+    size_t taille_bande = (size_t)(LIGNES_BANDE_FLUX + halo) * lecteur.octets_ligne;
+    unsigned char *entree = malloc(taille_bande);
+    unsigned char *resultat = (halo > 1) ? malloc(taille_bande) : NULL;
+    int code = 0;
+    if (!ouverte || !entree || (halo > 1 && !resultat))
+    {
+        if (ouverte)
+            perror("cannot allocate memory");
+        code = 1;
+        goto fin;
+    }
+    if (sortie_entete_pgm(&sortie, "P5", lecteur.largeur, lecteur.hauteur, lecteur.max_val) != 0)
+    {
+        code = 1;
+        goto fin;
+    }
+
+    if (operateur->ponctuelle != PONCTUEL_AUCUNE)
+    {
+        EtapePonctuelle etape = {operateur->ponctuelle, to_int(parametre)};
+        if (etape.operation == PONCTUEL_SEUIL && (etape.parametre < 0 || etape.parametre > lecteur.max_val))
+        {
+            printf("seuil invalide: %d\n", etape.parametre);
+            code = 1;
+            goto fin;
+        }
+        int niveaux = niveaux_table(lecteur.max_val);
+        unsigned int *hist = calloc(2 * (size_t)niveaux, sizeof(unsigned int)); //! + histogramme d'une bande
+        void *table = creer_table(lecteur.max_val);
+        if (!hist || !table)
+            code = 1;
+        if (!code && etape_depend_histogramme(etape.operation))
+        {
+            //? première passe: histogramme par bandes
+            ImagePGM vue = {.largeur = lecteur.largeur, .max_val = lecteur.max_val, .data = entree};
+            unsigned int *partiel = hist + niveaux;
+            while (lecteur.lignes_lues < lecteur.hauteur)
+            {
+                int nb = lecteur.hauteur - lecteur.lignes_lues;
+                if (nb > LIGNES_BANDE_FLUX)
+                    nb = LIGNES_BANDE_FLUX;
+                flux_lire_lignes(&lecteur, entree, nb);
+                vue.hauteur = nb;
+                if (histogramme_dans(&vue, partiel) != 0)
+                {
+                    code = 1;
+                    break;
+                }
+                for (int v = 0; v < niveaux; v++)
+                    hist[v] += partiel[v];
+            }
+            flux_rembobiner(&lecteur);
+        }
+        if (!code && (table_etape(&etape, hist, lecteur.max_val, table) != 0 || flux_table(&lecteur, &sortie, table, entree) != 0))
+            code = 1;
+        free(hist);
+        free(table);
+    }
+    else if (flux_fenetre(&lecteur, &sortie, operateur, parametre, avant, halo - 1 - avant, entree, resultat) != 0)
+        code = 1;
+
+    if (code)
+        printf("échec du traitement en flux de %s\n", argv[1]);
+
+fin:
+    free(entree);
+    free(resultat);
+    if (ouverte && code)
+        sortie_abandonner(&sortie);
+    else if (ouverte && sortie_valider(&sortie) != 0)
+        code = 1;
+    fclose(lecteur.fichier);
+    return code;
+}
+
+/*-------------------------------------------
+//? PIPELINE D'OPÉRATEURS EN MÉMOIRE
+//? pipeline <image> <op1,op2:param,...> [<sortie>]
+//? les étapes écrivent alternativement dans deux tampons réutilisés (ping-pong);
+//? les opérations ponctuelles consécutives (luminosite, seuillage, contrast, eq_histogramme,
+//? otsu) sont composées en une seule table appliquée en une passe
+---------------------------------------------*/
+typedef struct
+{
+    const Operateur *operateur;
+    char *parametre; //! NULL si absent
+} EtapePipeline;
+
+//! découpe "gaussien,sobel_seuil:80,otsu" en étapes; retourne le nombre d'étapes, -1 si invalide
+int analyser_pipeline(char *chaine, EtapePipeline *etapes, int capacite)
+{
+    int nombre = 0;
+    char *reste = NULL;
+    for (char *jeton = strtok_r(chaine, ",", &reste); jeton; jeton = strtok_r(NULL, ",", &reste))
+    {
+        if (nombre == capacite)
+        {
+            printf("pipeline trop long (%d étapes au plus)\n", capacite);
+            return -1;
+        }
+        char *parametre = strchr(jeton, ':');
+        if (parametre)
+            *parametre++ = '\0';
+        const Operateur *operateur = trouver_operateur(jeton);
+        if (!operateur)
+        {
+            printf("Commande inconnue: %s\n", jeton);
+            return -1;
+        }
+        if (operateur->avec_parametre && !parametre)
+        {
+            printf("la commande %s attend un paramètre (%s:<valeur>)\n", operateur->nom, operateur->nom);
+            return -1;
+        }
+        etapes[nombre].operateur = operateur;
+        etapes[nombre].parametre = parametre;
+        nombre++;
+    }
+    return nombre;
+}
+
+//! tampon de sortie réutilisé s'il a déjà la bonne taille
+static ImagePGM *tampon_pipeline(ImagePGM *tampon, int hauteur, int largeur, int max_val)
+{
+    if (tampon && tampon->hauteur == hauteur && tampon->largeur == largeur && image_16_bits(tampon) == (max_val > 255))
+    {
+        tampon->max_val = max_val;
+        return tampon;
+    }
+    liberer_une_image(tampon);
+    return creer_image_pgm(hauteur, largeur, max_val);
+}
+
+//! la dernière étape écrit dans destination si elle en a la taille et la profondeur
+static ImagePGM *sortie_etape(ImagePGM **tampon, ImagePGM *destination, int derniere, const ImagePGM *courante)
+{
+    if (derniere && destination && destination->hauteur == courante->hauteur && destination->largeur == courante->largeur &&
+        image_16_bits(destination) == image_16_bits(courante))
+    {
+        destination->max_val = courante->max_val;
+        return destination;
+    }
+    *tampon = tampon_pipeline(*tampon, courante->hauteur, courante->largeur, courante->max_val);
+    return *tampon;
+}
+
+/*-------------------------------------------
+//? EXÉCUTION D'UN PIPELINE: retourne l'image finale, NULL en cas d'erreur
+//? l'image d'entrée n'est jamais modifiée. Si destination (non NULL) convient à la
+//? dernière étape, celle-ci y écrit directement et destination est retournée; sinon
+//? l'image retournée est allouée (à libérer).
+---------------------------------------------*/
+ImagePGM *executer_pipeline_vers(ImagePGM *image, const EtapePipeline *etapes, int nb_etapes, ImagePGM *destination)
+{
+    ImagePGM *tampons[2] = {NULL, NULL};
+    ImagePGM *courante = image;
+    int tampon_courant = -1;
+
+    for (int k = 0; k < nb_etapes;)
+    {
+        int tampon_sortie = (tampon_courant == 0) ? 1 : 0;
+        const Operateur *operateur = etapes[k].operateur;
+        ImagePGM *sortie = NULL;
+
+        if (operateur->ponctuelle != PONCTUEL_AUCUNE)
+        {
+            //? fusion des opérations ponctuelles consécutives
+            EtapePonctuelle chaine[MAX_ETAPES_FUSION];
+            int nb_chaine = 0;
+            while (k < nb_etapes && etapes[k].operateur->ponctuelle != PONCTUEL_AUCUNE && nb_chaine < MAX_ETAPES_FUSION)
+            {
+                chaine[nb_chaine].operation = etapes[k].operateur->ponctuelle;
+                chaine[nb_chaine].parametre = to_int(etapes[k].parametre);
+                if (chaine[nb_chaine].operation == PONCTUEL_SEUIL && (chaine[nb_chaine].parametre < 0 || chaine[nb_chaine].parametre > courante->max_val))
+                {
+                    printf("seuil invalide: %d\n", chaine[nb_chaine].parametre);
+                    courante = NULL;
+                    break;
+                }
+                nb_chaine++;
+                k++;
+            }
+            if (!courante)
+                break;
+            sortie = sortie_etape(&tampons[tampon_sortie], destination, k == nb_etapes, courante);
+            MesureProfil mesure;
+            PROFIL_DEBUT(mesure);
+            int code = sortie ? appliquer_chaine_ponctuelle(courante, sortie, chaine, nb_chaine) : -1;
+            PROFIL_FIN(mesure, "chaine_ponctuelle");
+            if (code != 0)
+            {
+                courante = NULL;
+                break;
+            }
+        }
+        else if (operateur->appliquer_dans)
+        {
+            sortie = sortie_etape(&tampons[tampon_sortie], destination, k + 1 == nb_etapes, courante);
+            if (!sortie || appliquer_operateur_dans(operateur, courante, sortie, etapes[k].parametre) != 0)
+            {
+                courante = NULL;
+                break;
+            }
+            k++;
+        }
+        else
+        {
+            //? l'opérateur change la taille de l'image: son résultat devient le tampon
+            ImagePGM *resultat = appliquer_operateur(operateur, courante, etapes[k].parametre);
+            if (!resultat)
+            {
+                courante = NULL;
+                break;
+            }
+            liberer_une_image(tampons[tampon_sortie]);
+            tampons[tampon_sortie] = resultat;
+            sortie = resultat;
+            k++;
+        }
+        courante = sortie;
+        tampon_courant = tampon_sortie;
+    }
+
+    //? on garde le tampon final, l'autre est libéré
+    for (int t = 0; t < 2; t++)
+    {
+        if (tampons[t] != courante)
+            liberer_une_image(tampons[t]);
+    }
+    if (courante == image)
+    {
+        //? pipeline vide: copie de l'entrée
+        courante = creer_image_pgm(image->hauteur, image->largeur, image->max_val);
+        if (courante)
+            memcpy(courante->data, image->data, (size_t)image->largeur * image->hauteur * octets_par_pixel(image));
+    }
+    return courante;
+}
+
+ImagePGM *executer_pipeline(ImagePGM *image, const EtapePipeline *etapes, int nb_etapes)
+{
+    return executer_pipeline_vers(image, etapes, nb_etapes, NULL);
+}
+
+#define MAX_ETAPES_PIPELINE 64
+
+int commande_pipeline(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        printf("usage: pipeline <image> <op1,op2:param,...> [<sortie>]\n");
+        return 1;
+    }
+    EtapePipeline etapes[MAX_ETAPES_PIPELINE];
+    int nb_etapes = analyser_pipeline(argv[1], etapes, MAX_ETAPES_PIPELINE);
+    if (nb_etapes < 0)
+        return 1;
+
+    ImagePGM *image = lecture(argv[0]);
+    if (!image)
+        return 1;
+    ImagePGM *resultat = executer_pipeline(image, etapes, nb_etapes);
+    int code = (resultat && enregister_pgm((argc > 2) ? argv[2] : "pipeline_img.pgm", resultat) == 0) ? 0 : 1;
+    liberer_une_image(resultat);
+    liberer_une_image(image);
+    return code;
+}
+
+/*-------------------------------------------
+//? BIBLIOTHÈQUE: API C SUR DES TAMPONS DE L'APPELANT (voir traitement_image.h)
+//? une image de l'appelant dont les lignes sont contiguës est vue directement comme
+//? une ImagePGM (ni copie, ni libération); sinon ses lignes sont regroupées dans un
+//? tampon du pool. La dernière étape écrit directement dans la sortie quand elle
+//? est contiguë et que l'étape garde la taille (executer_pipeline_vers).
+---------------------------------------------*/
+static pthread_once_t initialisation_bibliotheque = PTHREAD_ONCE_INIT;
+
+static void initialiser_bibliotheque(void)
+{
+    noyaux_ponctuels();
+}
+
+int ti_version(void)
+{
+    return TI_VERSION;
+}
+
+const char *ti_message(int code)
+{
+    switch (code)
+    {
+    case TI_OK:
+        return "succès";
+    case TI_ERREUR_PARAMETRE:
+        return "paramètre invalide";
+    case TI_ERREUR_TAILLE:
+        return "taille ou profondeur de la sortie incorrecte";
+    case TI_ERREUR_MEMOIRE:
+        return "mémoire insuffisante";
+    case TI_ERREUR_TRAITEMENT:
+        return "échec du traitement";
+    case TI_ERREUR_SYSTEME:
+        return "erreur système";
+    }
+    return "code inconnu";
+}
+
+void ti_definir_threads(int nb_threads)
+{
+    nb_threads_demandes = (nb_threads > 0) ? nb_threads : 0;
+}
+
+void ti_terminer(void)
+{
+    arreter_pool_threads();
+    vider_pool_tampons();
+}
+
+//! taille de l'image après les étapes (seuls les zooms la changent)
+static void taille_apres_etapes(const EtapePipeline *etapes, int nb_etapes, int *largeur, int *hauteur)
+{
+    for (int k = 0; k < nb_etapes; k++)
+    {
+        if (etapes[k].operateur->appliquer == op_zoom_in)
+        {
+            *largeur /= 2;
+            *hauteur /= 2;
+        }
+        else if (etapes[k].operateur->appliquer == op_zoom_out)
+        {
+            *largeur *= 2;
+            *hauteur *= 2;
+        }
+    }
+}
+
+int ti_taille_sortie(const char *operations, int largeur, int hauteur, int *largeur_sortie, int *hauteur_sortie)
+{
+    if (!operations || largeur <= 0 || hauteur <= 0 || !largeur_sortie || !hauteur_sortie)
+        return TI_ERREUR_PARAMETRE;
+    char *copie = strdup(operations);
+    if (!copie)
+        return TI_ERREUR_MEMOIRE;
+    EtapePipeline etapes[MAX_ETAPES_PIPELINE];
+    int nb_etapes = analyser_pipeline(copie, etapes, MAX_ETAPES_PIPELINE);
+    if (nb_etapes >= 0)
+    {
+        taille_apres_etapes(etapes, nb_etapes, &largeur, &hauteur);
+        *largeur_sortie = largeur;
+        *hauteur_sortie = hauteur;
+    }
+    free(copie);
+    return (nb_etapes >= 0) ? TI_OK : TI_ERREUR_PARAMETRE;
+}
+
+//! copie ligne à ligne entre une image contiguë et un tampon de pas quelconque
+static void copier_lignes(unsigned char *dst, size_t pas_dst, const unsigned char *src, size_t pas_src, size_t octets_ligne, int hauteur)
+{
+    for (int i = 0; i < hauteur; i++)
+    {
+        memcpy(dst + (size_t)i * pas_dst, src + (size_t)i * pas_src, octets_ligne);
+    }
+}
+
+int ti_appliquer(const char *operations, const TiImage *entree, TiImage *sortie)
+{
+    if (!operations || !entree || !sortie || !entree->pixels || !sortie->pixels || entree->largeur <= 0 || entree->hauteur <= 0 ||
+        entree->max_val <= 0 || entree->max_val > 65535)
+        return TI_ERREUR_PARAMETRE;
+    size_t octets = (entree->max_val > 255) ? 2 : 1;
+    size_t ligne_entree = (size_t)entree->largeur * octets;
+    size_t ligne_sortie = (size_t)sortie->largeur * octets;
+    if (entree->pas < ligne_entree || sortie->pas < ligne_sortie)
+        return TI_ERREUR_PARAMETRE;
+    pthread_once(&initialisation_bibliotheque, initialiser_bibliotheque);
+
+    char *copie = strdup(operations);
+    if (!copie)
+        return TI_ERREUR_MEMOIRE;
+    EtapePipeline etapes[MAX_ETAPES_PIPELINE];
+    int nb_etapes = analyser_pipeline(copie, etapes, MAX_ETAPES_PIPELINE);
+    int largeur = entree->largeur, hauteur = entree->hauteur;
+    if (nb_etapes >= 0)
+        taille_apres_etapes(etapes, nb_etapes, &largeur, &hauteur);
+    int code = TI_OK;
+    if (nb_etapes < 0)
+        code = TI_ERREUR_PARAMETRE;
+    else if (largeur != sortie->largeur || hauteur != sortie->hauteur)
+        code = TI_ERREUR_TAILLE;
+    if (code != TI_OK)
+    {
+        free(copie);
+        return code;
+    }
+
+    //? entrée: vue directe si contiguë, sinon regroupement des lignes
+    ImagePGM vue_entree = {.largeur = entree->largeur, .hauteur = entree->hauteur, .max_val = entree->max_val, .data = entree->pixels};
+    ImagePGM *image = &vue_entree;
+    if (entree->pas != ligne_entree)
+    {
+        image = creer_image_pgm(entree->hauteur, entree->largeur, entree->max_val);
+        if (image)
+            copier_lignes(image->data, ligne_entree, entree->pixels, entree->pas, ligne_entree, entree->hauteur);
+    }
+    ImagePGM vue_sortie = {.largeur = sortie->largeur, .hauteur = sortie->hauteur, .max_val = entree->max_val, .data = sortie->pixels};
+    ImagePGM *resultat = image ? executer_pipeline_vers(image, etapes, nb_etapes, (sortie->pas == ligne_sortie) ? &vue_sortie : NULL) : NULL;
+
+    if (!image)
+        code = TI_ERREUR_MEMOIRE;
+    else if (!resultat)
+        code = TI_ERREUR_TRAITEMENT;
+    else
+    {
+        sortie->max_val = resultat->max_val;
+        if (resultat != &vue_sortie)
+        {
+            copier_lignes(sortie->pixels, sortie->pas, resultat->data, ligne_sortie, ligne_sortie, sortie->hauteur);
+            liberer_une_image(resultat);
+        }
+    }
+    if (image != &vue_entree)
+        liberer_une_image(image);
+    free(copie);
+    return code;
+}
+
+/*-------------------------------------------
+//? PICS DE HOUGH EN TEXTE OU JSON
+//? hough_pics <image> <seuil[:votes[:pas_angle[:pas_rho]]]> <K> [texte|json] [<image_tracee>]
+//? une ligne "rho theta votes" par droite (theta en degrés); les droites ne sont tracées
+//? sur une copie de l'image que si un fichier de sortie est donné
+---------------------------------------------*/
+int commande_hough_pics(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        printf("usage: hough_pics <image> <seuil[:votes[:pas_angle[:pas_rho]]]> <K> [texte|json] [<image_tracee>]\n");
+        return 1;
+    }
+    ParametresHough p;
+    if (analyser_parametres_hough(argv[1], &p) != 0)
+        return 1;
+    int k = to_int(argv[2]);
+    int json = (argc > 3) && strcmp(argv[3], "json") == 0;
+    if (k <= 0 || (argc > 3 && !json && strcmp(argv[3], "texte") != 0))
+    {
+        printf("paramètres invalides: K = %d, format = %s\n", k, (argc > 3) ? argv[3] : "texte");
+        return 1;
+    }
+
+    ImagePGM *image = lecture(argv[0]);
+    if (!image)
+        return 1;
+    ImagePGM *contours = contours_hough(image, p.seuil_contour);
+    AccumulateurHough *acc = contours ? hough_accumuler(contours, p.pas_angle, p.pas_rho) : NULL;
+    liberer_une_image(contours);
+    PicHough *pics = malloc(k * sizeof(PicHough));
+    if (!acc || !pics)
+    {
+        free(pics);
+        liberer_accumulateur_hough(acc);
+        liberer_une_image(image);
+        return 1;
+    }
+    int nb = hough_extraire_pics(acc, p.seuil_votes, pics, k);
+    if (nb < 0)
+    {
+        free(pics);
+        liberer_accumulateur_hough(acc);
+        liberer_une_image(image);
+        return 1;
+    }
+
+    if (json)
+        printf("[");
+    for (int n = 0; n < nb; n++)
+    {
+        double rho = (pics[n].r - acc->rho_zero) * acc->pas_rho;
+        double theta = pics[n].t * acc->pas_angle;
+        if (json)
+            printf("%s\n  {\"rho\": %g, \"theta\": %g, \"votes\": %u}", n ? "," : "", rho, theta, pics[n].votes);
+        else
+            printf("%g %g %u\n", rho, theta, pics[n].votes);
+    }
+    if (json)
+        printf("%s]\n", nb ? "\n" : "");
+
+    if (argc > 4)
+    {
+        //? tracé direct sur une copie: équivalent à la somme saturée avec une image de droites
+        ImagePGM *trace = creer_image_pgm(image->hauteur, image->largeur, image->max_val);
+        if (trace)
+        {
+            memcpy(trace->data, image->data, (size_t)image->largeur * image->hauteur * octets_par_pixel(image));
+            for (int n = 0; n < nb; n++)
+            {
+                hough_tracer_droite(trace, acc, pics[n].r, pics[n].t);
+            }
+            enregister_pgm(argv[4], trace);
+            liberer_une_image(trace);
+        }
+    }
+
+    free(pics);
+    liberer_accumulateur_hough(acc);
+    liberer_une_image(image);
+    return 0;
+}
+
+/*-------------------------------------------
+//? SEGMENTS PAR HOUGH PROBABILISTE
+//? hough_prob <image> <seuil[:votes[:longueur_min[:ecart_max]]]> [texte|json] [<image_tracee>]
+//? une ligne "x0 y0 x1 y1 votes" par segment (x: colonne, y: ligne)
+---------------------------------------------*/
+int commande_hough_prob(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        printf("usage: hough_prob <image> <seuil[:votes[:longueur_min[:ecart_max]]]> [texte|json] [<image_tracee>]\n");
+        return 1;
+    }
+    ParametresHoughProb p;
+    if (analyser_parametres_hough_prob(argv[1], &p) != 0)
+        return 1;
+    int json = (argc > 2) && strcmp(argv[2], "json") == 0;
+    if (argc > 2 && !json && strcmp(argv[2], "texte") != 0)
+    {
+        printf("format inconnu: %s\n", argv[2]);
+        return 1;
+    }
+
+    ImagePGM *image = lecture(argv[0]);
+    if (!image)
+        return 1;
+    ImagePGM *contours = contours_hough(image, p.seuil_contour);
+    SegmentHough *segments = NULL;
+    int nb = contours ? hough_probabiliste(contours, &p, &segments) : -1;
+    liberer_une_image(contours);
+    if (nb < 0)
+    {
+        liberer_une_image(image);
+        return 1;
+    }
+
+    if (json)
+        printf("[");
+    for (int n = 0; n < nb; n++)
+    {
+        const SegmentHough *s = &segments[n];
+        if (json)
+            printf("%s\n  {\"x0\": %d, \"y0\": %d, \"x1\": %d, \"y1\": %d, \"votes\": %d}", n ? "," : "", s->x0, s->y0, s->x1, s->y1, s->votes);
+        else
+            printf("%d %d %d %d %d\n", s->x0, s->y0, s->x1, s->y1, s->votes);
+    }
+    if (json)
+        printf("%s]\n", nb ? "\n" : "");
+
+    if (argc > 3)
+    {
+        ImagePGM *trace = creer_image_pgm(image->hauteur, image->largeur, image->max_val);
+        if (trace)
+        {
+            memcpy(trace->data, image->data, (size_t)image->largeur * image->hauteur * octets_par_pixel(image));
+            for (int n = 0; n < nb; n++)
+            {
+                tracer_segment(trace, &segments[n]);
+            }
+            enregister_pgm(argv[3], trace);
+            liberer_une_image(trace);
+        }
+    }
+
+    free(segments);
+    liberer_une_image(image);
+    return 0;
+}
+
+/*-------------------------------------------
+//? BANC D'ESSAI DES OPÉRATEURS
+//? bench <dossier|liste> [<repetitions>[:<echauffement>]] [texte|csv|json]
+//? sur chaque image, addition et soustraction (de l'image avec elle-même) puis chaque
+//? opérateur de la table sont exécutés echauffement fois sans mesure puis repetitions fois.
+//? Seul le calcul est chronométré (horloge monotone), pas la lecture ni la libération.
+//? Par image et par opérateur: médiane et 95e centile de la latence, et mégapixels
+//? d'entrée traités par seconde à la latence médiane.
+---------------------------------------------*/
+#define REPETITIONS_BENCH 10
+#define ECHAUFFEMENT_BENCH 2
+
+typedef enum
+{
+    BENCH_TEXTE,
+    BENCH_CSV,
+    BENCH_JSON
+} FormatBench;
+
+typedef struct
+{
+    const char *nom;
+    const char *parametre;
+    ImagePGM *(*appliquer)(ImagePGM *image, const char *parametre);
+} CasBench;
+
+//! paramètres des opérateurs qui en exigent un
+static const struct
+{
+    const char *nom;
+    const char *parametre;
+} PARAMETRES_BENCH[] = {
+    {"seuillage", "128"},
+    {"luminosite", "40"},
+    {"robert_seuil", "30"},
+    {"prewitt_seuil", "60"},
+    {"sobel_seuil", "90"},
+    {"laplace_seuil", "20"},
+    {"hough", "60"},
+};
+#define NB_PARAMETRES_BENCH (int)(sizeof(PARAMETRES_BENCH) / sizeof(PARAMETRES_BENCH[0]))
+
+static ImagePGM *bench_addition(ImagePGM *image, const char *parametre) { (void)parametre; return somme_images(image, image); }
+static ImagePGM *bench_soustraction(ImagePGM *image, const char *parametre) { (void)parametre; return difference_images(image, image); }
+
+static int comparer_durees(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+//! liste des cas mesurés; retourne leur nombre
+static int construire_cas_bench(CasBench *cas)
+{
+    int nb = 0;
+    cas[nb++] = (CasBench){"addition", NULL, bench_addition};
+    cas[nb++] = (CasBench){"soustraction", NULL, bench_soustraction};
+    for (int k = 0; k < NB_OPERATEURS; k++)
+    {
+        const char *parametre = NULL;
+        for (int p = 0; p < NB_PARAMETRES_BENCH; p++)
+        {
+            if (strcmp(PARAMETRES_BENCH[p].nom, OPERATEURS[k].nom) == 0)
+                parametre = PARAMETRES_BENCH[p].parametre;
+        }
+        if (OPERATEURS[k].avec_parametre && !parametre)
+        {
+            fprintf(stderr, "bench: pas de paramètre pour %s, ignoré\n", OPERATEURS[k].nom);
+            continue;
+        }
+        cas[nb++] = (CasBench){OPERATEURS[k].nom, parametre, OPERATEURS[k].appliquer};
+    }
+    return nb;
+}
+
+//! durées triées des repetitions mesurées; -1 si l'opérateur échoue
+static int mesurer_cas_bench(ImagePGM *image, const CasBench *cas, int repetitions, int echauffement, double *durees)
+{
+    for (int k = 0; k < echauffement + repetitions; k++)
+    {
+        double debut = horloge_ms();
+        ImagePGM *resultat = cas->appliquer(image, cas->parametre);
+        double duree = horloge_ms() - debut;
+        if (!resultat)
+            return -1;
+        liberer_une_image(resultat);
+        if (k >= echauffement)
+            durees[k - echauffement] = duree;
+    }
+    qsort(durees, repetitions, sizeof(double), comparer_durees);
+    return 0;
+}
+
+//! centile par rang le plus proche d'une série triée
+static double centile(const double *triees, int n, int pourcentage)
+{
+    int rang = (n * pourcentage + 99) / 100;
+    return triees[(rang > 0 ? rang : 1) - 1];
+}
+
+//! chaîne JSON entre guillemets: ", \ et caractères de contrôle échappés (noms de fichiers quelconques)
+static void ecrire_chaine_json(const char *texte)
+{
+    putchar('"');
+    for (const unsigned char *p = (const unsigned char *)texte; *p; p++)
+    {
+        if (*p == '"' || *p == '\\')
+            printf("\\%c", *p);
+        else if (*p < 0x20)
+            printf("\\u%04x", *p);
+        else
+            putchar(*p);
+    }
+    putchar('"');
+}
+
+//! champ CSV (RFC 4180): entre guillemets, guillemets doublés, s'il contient , " ou une fin de ligne
+static void ecrire_champ_csv(const char *texte)
+{
+    if (!strpbrk(texte, ",\"\r\n"))
+    {
+        fputs(texte, stdout);
+        return;
+    }
+    putchar('"');
+    for (const char *p = texte; *p; p++)
+    {
+        if (*p == '"')
+            putchar('"');
+        putchar(*p);
+    }
+    putchar('"');
+}
+
+int commande_bench(int argc, char **argv)
+{
+    if (argc < 1)
+    {
+        printf("usage: bench <dossier|liste> [<repetitions>[:<echauffement>]] [texte|csv|json]\n");
+        return 1;
+    }
+    int repetitions = REPETITIONS_BENCH, echauffement = ECHAUFFEMENT_BENCH;
+    if (argc > 1)
+    {
+        repetitions = to_int(argv[1]);
+        const char *deux_points = strchr(argv[1], ':');
+        if (deux_points)
+            echauffement = to_int(deux_points + 1);
+    }
+    FormatBench format = BENCH_TEXTE;
+    if (argc > 2 && strcmp(argv[2], "csv") == 0)
+        format = BENCH_CSV;
+    else if (argc > 2 && strcmp(argv[2], "json") == 0)
+        format = BENCH_JSON;
+    else if (argc > 2 && strcmp(argv[2], "texte") != 0)
+    {
+        printf("format inconnu: %s\n", argv[2]);
+        return 1;
+    }
+    if (repetitions <= 0 || echauffement < 0)
     {
-        seuil = to_int(argv[3]);
-        ImagePGM *image_seuillage = seuillage(image, seuil);
-        const char *seuillage_img = "binaire_img.pgm";
-        enregister_pgm(seuillage_img, image_seuillage);
+        printf("répétitions invalides: %s\n", argv[1]);
+        return 1;
     }
-    else if (strcmp(argv[1], "otsu") == 0)
+
+    int nb_entrees = 0;
+    char **entrees = lister_entrees(argv[0], &nb_entrees);
+    CasBench cas[NB_OPERATEURS + 2];
+    int nb_cas = construire_cas_bench(cas);
+    double *durees = malloc(repetitions * sizeof(double));
+    if (nb_entrees == 0 || !durees)
     {
-        ImagePGM *image_otsu = binaire_otsu(image);
-        const char *otsu_img = "otsu_img.pgm";
-        enregister_pgm(otsu_img, image_otsu);
+        printf("aucune image à mesurer\n");
+        for (int e = 0; e < nb_entrees; e++)
+        {
+            free(entrees[e]);
+        }
+        free(entrees);
+        free(durees);
+        return 1;
     }
-    else if (strcmp(argv[1], "moyenneur") == 0)
+
+    if (format == BENCH_TEXTE)
+        printf("%d threads, noyaux %s, %d répétitions après %d d'échauffement\n%-20s %11s %-16s %10s %10s %9s\n",
+               nb_threads_effectifs(), noyaux_ponctuels()->nom, repetitions, echauffement,
+               "image", "taille", "operation", "mediane_ms", "p95_ms", "MP/s");
+    else if (format == BENCH_CSV)
+        printf("image,largeur,hauteur,max_val,operation,parametre,threads,noyaux,repetitions,mediane_ms,p95_ms,mpixels_s\n");
+    else
+        printf("{\"threads\": %d, \"noyaux\": \"%s\", \"repetitions\": %d, \"echauffement\": %d, \"mesures\": [",
+               nb_threads_effectifs(), noyaux_ponctuels()->nom, repetitions, echauffement);
+
+    int code = 0, nb_mesures = 0;
+    for (int e = 0; e < nb_entrees; e++)
     {
-        ImagePGM *image_moyenneur = filtre_moyenneur(image);
-        const char *moyenneur_img = "moyenneur_img.pgm";
-        enregister_pgm(moyenneur_img, image_moyenneur);
+        ImagePGM *image = lecture(entrees[e]);
+        if (!image)
+        {
+            code = 1;
+            continue;
+        }
+        const char *nom = strrchr(entrees[e], '/');
+        nom = nom ? nom + 1 : entrees[e];
+        double mpixels = (double)image->largeur * image->hauteur / 1e6;
+
+        for (int c = 0; c < nb_cas; c++)
+        {
+            if (mesurer_cas_bench(image, &cas[c], repetitions, echauffement, durees) != 0)
+            {
+                fprintf(stderr, "bench: échec de %s sur %s\n", cas[c].nom, entrees[e]);
+                code = 1;
+                continue;
+            }
+            double mediane = centile(durees, repetitions, 50);
+            double p95 = centile(durees, repetitions, 95);
+            double debit = mediane > 0.0 ? mpixels / (mediane / 1e3) : 0.0;
+            const char *parametre = cas[c].parametre ? cas[c].parametre : "";
+
+            if (format == BENCH_TEXTE)
+            {
+                char taille[32], operation[64];
+                snprintf(taille, sizeof(taille), "%dx%d", image->largeur, image->hauteur);
+                snprintf(operation, sizeof(operation), "%s%s%s", cas[c].nom, *parametre ? ":" : "", parametre);
+                printf("%-20s %11s %-16s %10.3f %10.3f %9.1f\n", nom, taille, operation, mediane, p95, debit);
+            }
+            else if (format == BENCH_CSV)
+            {
+                ecrire_champ_csv(nom);
+                printf(",%d,%d,%d,%s,%s,%d,%s,%d,%.4f,%.4f,%.2f\n", image->largeur, image->hauteur, image->max_val,
+                       cas[c].nom, parametre, nb_threads_effectifs(), noyaux_ponctuels()->nom, repetitions, mediane, p95, debit);
+            }
+            else
+            {
+                printf("%s\n  {\"image\": ", nb_mesures ? "," : "");
+                ecrire_chaine_json(nom);
+                printf(", \"largeur\": %d, \"hauteur\": %d, \"max_val\": %d, \"operation\": \"%s\", \"parametre\": \"%s\", "
+                       "\"mediane_ms\": %.4f, \"p95_ms\": %.4f, \"mpixels_s\": %.2f}",
+                       image->largeur, image->hauteur, image->max_val, cas[c].nom, parametre, mediane, p95, debit);
+            }
+            nb_mesures++;
+            fflush(stdout);
+        }
+        liberer_une_image(image);
     }
-    else if (strcmp(argv[1], "gaussien") == 0)
+    if (format == BENCH_JSON)
+        printf("%s]}\n", nb_mesures ? "\n" : "");
+
+    for (int e = 0; e < nb_entrees; e++)
     {
-        ImagePGM *image_gaussien = filtre_gaussien(image);
-        const char *gaussien_img = "gaussien_img.pgm";
-        enregister_pgm(gaussien_img, image_gaussien);
+        free(entrees[e]);
     }
-    else if (strcmp(argv[1], "luminosite") == 0)
+    free(entrees);
+    free(durees);
+    return code;
+}
+
+/*-------------------------------------------
+//? MODE SERVEUR SUR SOCKET UNIX
+//? serveur <socket> [<travailleurs>[:<file>]]
+//? une requête par ligne: <op1,op2:param,...> <entree> <sortie>
+//? entree et sortie: chemin de fichier, ou shm:<nom> pour un objet de mémoire partagée POSIX
+//? (voir lecture_partagee); une réponse par ligne, dans l'ordre des requêtes:
+//?   ok <largeur> <hauteur> <max_val> <ms>   ou   erreur <message>
+//? "ping" répond "ok". Le thread principal surveille toutes les connexions (poll), découpe
+//? les lignes et dépose chaque requête dans une file bornée; les travailleurs les exécutent
+//? et écrivent les réponses de chaque connexion dans l'ordre de ses requêtes. Une connexion
+//? inactive n'occupe aucun travailleur. File pleine: plus aucune lecture, les requêtes restent
+//? dans les tampons du noyau et les clients attendent (contre-pression).
+//? SIGINT/SIGTERM: plus d'acceptation ni de lecture, les requêtes déjà dans la file sont
+//? exécutées et reçoivent leur réponse, puis le socket est supprimé.
+---------------------------------------------*/
+#define TRAVAILLEURS_SERVEUR 4
+#define PROFONDEUR_FILE_SERVEUR 16
+#define CONNEXIONS_MAX_SERVEUR 1024
+#define LONGUEUR_REQUETE_MAX 8192
+#define DELAI_ECRITURE_SERVEUR 5 //! secondes: un client qui ne lit plus ses réponses est abandonné
+#define PREFIXE_PARTAGE "shm:"
+
+typedef struct ConnexionServeur ConnexionServeur;
+
+typedef struct RequeteServeur
+{
+    ConnexionServeur *connexion;
+    struct RequeteServeur *suivante; //! requête suivante de la même connexion
+    int trop_longue;
+    int terminee;
+    char ligne[LONGUEUR_REQUETE_MAX];
+    char reponse[LONGUEUR_REQUETE_MAX + 64];
+} RequeteServeur;
+
+struct ConnexionServeur
+{
+    int fd;
+    //? lecture: thread principal seulement
+    char tampon[LONGUEUR_REQUETE_MAX - 1];
+    size_t rempli;
+    int ignorer;       //! reste d'une ligne trop longue, ignoré jusqu'à la fin de ligne
+    int lecture_finie; //! fin de flux, erreur ou écriture rompue
+    //? réponses: protégé par le verrou de la file
+    RequeteServeur *premiere; //! requêtes sans réponse écrite, dans l'ordre de lecture
+    RequeteServeur *derniere;
+    int ecriture; //! un travailleur écrit les réponses prêtes
+    int rompue;   //! écriture impossible: les réponses suivantes sont abandonnées
+};
+
+typedef struct
+{
+    RequeteServeur **requetes;
+    int capacite;
+    int debut;
+    int nombre;
+    int fermee;
+    long long traitees;
+    pthread_mutex_t verrou;
+    pthread_cond_t non_vide;
+    int reveil[2]; //! tube par lequel un travailleur réveille le thread principal
+} FileServeur;
+
+static volatile sig_atomic_t arret_serveur = 0;
+static int socket_ecoute_serveur = -1;
+
+//! shutdown (async-signal-safe) réveille accept même si le signal arrive juste avant l'appel
+static void signal_arret_serveur(int signal)
+{
+    (void)signal;
+    arret_serveur = 1;
+    if (socket_ecoute_serveur >= 0)
+        shutdown(socket_ecoute_serveur, SHUT_RDWR);
+}
+
+static void serveur_reveiller(FileServeur *file)
+{
+    char octet = 0;
+    if (write(file->reveil[1], &octet, 1) < 0)
     {
-        int delta_luminosite = to_int(argv[3]);
-        ImagePGM *image_modif = modifier_luminosite(image, delta_luminosite);
-        const char *modif_img = "lumin_img.pgm";
-        enregister_pgm(modif_img, image_modif);
+        //? tube plein (non bloquant): un réveil est déjà en attente
     }
-    else if (strcmp(argv[1], "robert") == 0)
+}
+
+//! dépose une requête (appelant: thread principal, verrou pris, file non pleine); -1 si mémoire épuisée
+static int file_serveur_deposer(FileServeur *file, ConnexionServeur *connexion, const char *ligne, size_t longueur)
+{
+    RequeteServeur *requete = malloc(sizeof(RequeteServeur));
+    if (!requete)
+        return -1;
+    requete->connexion = connexion;
+    requete->suivante = NULL;
+    requete->trop_longue = (ligne == NULL);
+    requete->terminee = 0;
+    if (ligne)
     {
-        ImagePGM *image_robert = filtre_robert(image);
-        const char *robert_img = "robert_img.pgm";
-        enregister_pgm(robert_img, image_robert);
+        memcpy(requete->ligne, ligne, longueur);
+        requete->ligne[longueur] = '\0';
     }
-    else if (strcmp(argv[1], "prewitt") == 0)
+    if (connexion->derniere)
+        connexion->derniere->suivante = requete;
+    else
+        connexion->premiere = requete;
+    connexion->derniere = requete;
+    file->requetes[(file->debut + file->nombre) % file->capacite] = requete;
+    file->nombre++;
+    pthread_cond_signal(&file->non_vide);
+    return 0;
+}
+
+//! prochaine requête; NULL quand la file est fermée et vide
+static RequeteServeur *file_serveur_retirer(FileServeur *file)
+{
+    pthread_mutex_lock(&file->verrou);
+    while (file->nombre == 0 && !file->fermee)
+        pthread_cond_wait(&file->non_vide, &file->verrou);
+    RequeteServeur *requete = NULL;
+    if (file->nombre > 0)
     {
-        ImagePGM *image_prewitt = filtre_prewitt(image);
-        const char *prewitt_img = "prewitt_img.pgm";
-        enregister_pgm(prewitt_img, image_prewitt);
+        requete = file->requetes[file->debut];
+        file->debut = (file->debut + 1) % file->capacite;
+        file->nombre--;
     }
-    else if (strcmp(argv[1], "sobel") == 0)
+    pthread_mutex_unlock(&file->verrou);
+    if (requete)
+        serveur_reveiller(file); //! une place s'est libérée: la lecture peut reprendre
+    return requete;
+}
+
+//! fermeture: les travailleurs vident la file puis s'arrêtent
+static void file_serveur_fermer(FileServeur *file)
+{
+    pthread_mutex_lock(&file->verrou);
+    file->fermee = 1;
+    pthread_cond_broadcast(&file->non_vide);
+    pthread_mutex_unlock(&file->verrou);
+}
+
+static ImagePGM *charger_image_serveur(const char *source)
+{
+    if (strncmp(source, PREFIXE_PARTAGE, strlen(PREFIXE_PARTAGE)) == 0)
+        return lecture_partagee(source + strlen(PREFIXE_PARTAGE));
+    return lecture(source);
+}
+
+static int enregister_image_serveur(const char *destination, ImagePGM *image)
+{
+    if (strncmp(destination, PREFIXE_PARTAGE, strlen(PREFIXE_PARTAGE)) == 0)
+        return enregister_partagee(destination + strlen(PREFIXE_PARTAGE), image);
+    return enregister_pgm(destination, image);
+}
+
+//! exécute une requête; la réponse (sans fin de ligne) est écrite dans reponse
+static void servir_requete(char *ligne, char *reponse, size_t taille)
+{
+    char *reste = NULL;
+    char *operations = strtok_r(ligne, " \t\r\n", &reste);
+    char *entree = strtok_r(NULL, " \t\r\n", &reste);
+    char *sortie = strtok_r(NULL, " \t\r\n", &reste);
+    if (operations && strcmp(operations, "ping") == 0 && !entree)
     {
-        ImagePGM *image_sobel = filtre_sobel(image);
-        const char *sobel_img = "sobel_img.pgm";
-        enregister_pgm(sobel_img, image_sobel);
+        snprintf(reponse, taille, "ok");
+        return;
     }
-    else if (strcmp(argv[1], "laplace") == 0)
+    if (!operations || !entree || !sortie || strtok_r(NULL, " \t\r\n", &reste))
     {
-        ImagePGM *image_laplace = filtre_laplacien(image);
-        const char *laplace_img = "laplace_img.pgm";
-        enregister_pgm(laplace_img, image_laplace);
+        snprintf(reponse, taille, "erreur requête attendue: <op1,op2:param,...> <entree> <sortie>");
+        return;
     }
-    else if (strcmp(argv[1], "robert_seuil") == 0)
+
+    double debut = horloge_ms();
+    EtapePipeline etapes[MAX_ETAPES_PIPELINE];
+    int nb_etapes = analyser_pipeline(operations, etapes, MAX_ETAPES_PIPELINE);
+    if (nb_etapes < 0)
     {
-        seuil = to_int(argv[3]);
-        ImagePGM *image_robert_seuil = filtre_robert_seuil(image, seuil);
-        const char *robert_seuil_img = "robert_seuil_img.pgm";
-        enregister_pgm(robert_seuil_img, image_robert_seuil);
+        snprintf(reponse, taille, "erreur pipeline invalide");
+        return;
     }
-    else if (strcmp(argv[1], "prewitt_seuil") == 0)
+    ImagePGM *image = charger_image_serveur(entree);
+    if (!image)
     {
-        seuil = to_int(argv[3]);
-        ImagePGM *image_prewitt_seuil = filtre_prewitt_seuil(image, seuil);
-        const char *prewitt_seuil_img = "prewitt_seuil_img.pgm";
-        enregister_pgm(prewitt_seuil_img, image_prewitt_seuil);
+        snprintf(reponse, taille, "erreur lecture impossible: %s", entree);
+        return;
     }
-    else if (strcmp(argv[1], "sobel_seuil") == 0)
+    ImagePGM *resultat = executer_pipeline(image, etapes, nb_etapes);
+    liberer_une_image(image);
+    if (!resultat)
+        snprintf(reponse, taille, "erreur échec du traitement");
+    else if (enregister_image_serveur(sortie, resultat) != 0)
+        snprintf(reponse, taille, "erreur écriture impossible: %s", sortie);
+    else
+        snprintf(reponse, taille, "ok %d %d %d %.3f", resultat->largeur, resultat->hauteur, resultat->max_val, horloge_ms() - debut);
+    liberer_une_image(resultat);
+}
+
+//! marque la requête terminée et écrit, dans l'ordre, les réponses prêtes de sa connexion;
+//! un seul travailleur écrit à la fois pour une connexion, les autres lui laissent leur réponse
+static void serveur_repondre(FileServeur *file, RequeteServeur *requete)
+{
+    ConnexionServeur *connexion = requete->connexion;
+    pthread_mutex_lock(&file->verrou);
+    requete->terminee = 1;
+    file->traitees++;
+    if (!connexion->ecriture)
     {
-        seuil = to_int(argv[3]);
-        ImagePGM *image_sobel_seuil = filtre_sobel_seuil(image, seuil);
-        const char *sobel_seuil_img = "sobel_seuil_img.pgm";
-        enregister_pgm(sobel_seuil_img, image_sobel_seuil);
+        connexion->ecriture = 1;
+        while (connexion->premiere && connexion->premiere->terminee)
+        {
+            RequeteServeur *prete = connexion->premiere;
+            connexion->premiere = prete->suivante;
+            if (!connexion->premiere)
+                connexion->derniere = NULL;
+            int rompue = connexion->rompue;
+            pthread_mutex_unlock(&file->verrou);
+            if (!rompue && ecrire_tout(connexion->fd, prete->reponse, strlen(prete->reponse)) != 0)
+                rompue = 1;
+            free(prete);
+            pthread_mutex_lock(&file->verrou);
+            connexion->rompue = rompue;
+        }
+        connexion->ecriture = 0;
     }
-    else if (strcmp(argv[1], "laplace_seuil") == 0)
+    pthread_mutex_unlock(&file->verrou);
+    serveur_reveiller(file); //! la connexion peut être terminée
+}
+
+static void *serveur_travailleur(void *argument)
+{
+    FileServeur *file = argument;
+    RequeteServeur *requete;
+    while ((requete = file_serveur_retirer(file)) != NULL)
     {
-        seuil = to_int(argv[3]);
-        ImagePGM *image_laplace_seuil = filtre_laplacien_seuil(image, seuil);
-        const char *laplace_seuil_img = "laplace_seuil_img.pgm";
-        enregister_pgm(laplace_seuil_img, image_laplace_seuil);
+        if (requete->trop_longue)
+            snprintf(requete->reponse, sizeof(requete->reponse), "erreur requête de plus de %d octets", LONGUEUR_REQUETE_MAX - 1);
+        else
+            servir_requete(requete->ligne, requete->reponse, sizeof(requete->reponse) - 1);
+        strcat(requete->reponse, "\n");
+        serveur_repondre(file, requete);
     }
-    else if (strcmp(argv[1], "hough") == 0)
+    return NULL;
+}
+
+//! lit ce qui est disponible sur la connexion (appelée après poll: ne bloque pas)
+static void serveur_lire(ConnexionServeur *connexion)
+{
+    ssize_t lus = read(connexion->fd, connexion->tampon + connexion->rempli, sizeof(connexion->tampon) - connexion->rempli);
+    if (lus > 0)
+        connexion->rempli += lus;
+    else if (lus == 0 || (errno != EINTR && errno != EAGAIN))
+        connexion->lecture_finie = 1;
+}
+
+//! dépose les lignes complètes du tampon tant que la file a de la place (verrou pris);
+//! retourne 1 s'il reste des lignes à déposer
+static int serveur_extraire(FileServeur *file, ConnexionServeur *connexion)
+{
+    while (connexion->rempli > 0 && file->nombre < file->capacite)
     {
-        seuil = to_int(argv[3]);
-        ImagePGM *image_hough = hough_transform(image, seuil);
-        const char *hough_img = "hough_img.pgm";
-        enregister_pgm(hough_img, image_hough);
+        char *fin = memchr(connexion->tampon, '\n', connexion->rempli);
+        size_t longueur = fin ? (size_t)(fin - connexion->tampon) + 1 : connexion->rempli;
+        int complete = fin || connexion->lecture_finie; //! dernière ligne sans fin de ligne
+        if (connexion->ignorer)
+        {
+            //? reste d'une ligne trop longue: jeté jusqu'à sa fin de ligne
+            connexion->ignorer = !fin;
+        }
+        else if (complete || connexion->rempli == sizeof(connexion->tampon))
+        {
+            //? tampon plein sans fin de ligne: requête refusée, son reste sera ignoré
+            if (!complete)
+                connexion->ignorer = 1;
+            if (file_serveur_deposer(file, connexion, complete ? connexion->tampon : NULL, longueur) != 0)
+            {
+                perror("cannot allocate memory");
+                connexion->lecture_finie = 1;
+                connexion->rempli = 0;
+                return 0;
+            }
+        }
+        else
+        {
+            return 0; //! ligne incomplète: attendre la suite
+        }
+        connexion->rempli -= longueur;
+        memmove(connexion->tampon, connexion->tampon + longueur, connexion->rempli);
     }
-    else{
-        printf("Commande inconnue.\n");
+    return connexion->rempli > 0 && (connexion->lecture_finie || memchr(connexion->tampon, '\n', connexion->rempli) != NULL);
+}
+
+//! ferme les connexions dont toutes les réponses sont écrites et qui ne liront plus (verrou pris)
+static void serveur_fermer_connexions_finies(ConnexionServeur **connexions, int *nb_connexions, int toutes)
+{
+    int k = 0;
+    for (int c = 0; c < *nb_connexions; c++)
+    {
+        ConnexionServeur *connexion = connexions[c];
+        if (connexion->rompue)
+        {
+            connexion->lecture_finie = 1;
+            connexion->rempli = 0;
+        }
+        int finie = connexion->lecture_finie && connexion->rempli == 0;
+        if ((toutes || finie) && !connexion->premiere && !connexion->ecriture)
+        {
+            close(connexion->fd);
+            free(connexion);
+        }
+        else
+        {
+            connexions[k++] = connexion;
+        }
+    }
+    *nb_connexions = k;
+}
+
+int commande_serveur(int argc, char **argv)
+{
+    if (argc < 1)
+    {
+        printf("usage: serveur <socket> [<travailleurs>[:<file>]]\n");
+        return 1;
+    }
+    int nb_travailleurs = TRAVAILLEURS_SERVEUR, profondeur = PROFONDEUR_FILE_SERVEUR;
+    if (argc > 1)
+    {
+        nb_travailleurs = to_int(argv[1]);
+        const char *deux_points = strchr(argv[1], ':');
+        if (deux_points)
+            profondeur = to_int(deux_points + 1);
+    }
+    struct sockaddr_un adresse = {.sun_family = AF_UNIX};
+    if (nb_travailleurs <= 0 || profondeur <= 0 || strlen(argv[0]) >= sizeof(adresse.sun_path))
+    {
+        printf("paramètres invalides: %s %s\n", argv[0], (argc > 1) ? argv[1] : "");
+        return 1;
+    }
+    strcpy(adresse.sun_path, argv[0]);
+
+    int ecoute = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (ecoute < 0)
+    {
+        perror("socket");
+        return 1;
+    }
+    unlink(adresse.sun_path);
+    if (bind(ecoute, (struct sockaddr *)&adresse, sizeof(adresse)) != 0 || listen(ecoute, SOMAXCONN) != 0)
+    {
+        perror("bind");
+        close(ecoute);
+        return 1;
+    }
+
+    FileServeur file = {.capacite = profondeur, .reveil = {-1, -1}};
+    file.requetes = malloc(profondeur * sizeof(RequeteServeur *));
+    ConnexionServeur **connexions = malloc(CONNEXIONS_MAX_SERVEUR * sizeof(ConnexionServeur *));
+    struct pollfd *surveillees = malloc((CONNEXIONS_MAX_SERVEUR + 2) * sizeof(struct pollfd));
+    ConnexionServeur **lues = malloc(CONNEXIONS_MAX_SERVEUR * sizeof(ConnexionServeur *)); //! connexion de surveillees[2 + k]
+    pthread_t *threads = malloc(nb_travailleurs * sizeof(pthread_t));
+    if (!file.requetes || !connexions || !surveillees || !lues || !threads || pipe(file.reveil) != 0)
+    {
+        perror("cannot allocate memory");
+        free(file.requetes);
+        free(connexions);
+        free(surveillees);
+        free(lues);
+        free(threads);
+        close(ecoute);
+        unlink(adresse.sun_path);
         return 1;
     }
-    
+    fcntl(file.reveil[0], F_SETFL, O_NONBLOCK);
+    fcntl(file.reveil[1], F_SETFL, O_NONBLOCK);
+    pthread_mutex_init(&file.verrou, NULL);
+    pthread_cond_init(&file.non_vide, NULL);
+
+    //? les signaux d'arrêt ne sont reçus que par ce thread (travailleurs et pool les héritent bloqués)
+    //? et interrompent poll (pas de SA_RESTART); un client qui ferme ne tue pas le serveur
+    struct sigaction action = {0};
+    action.sa_handler = signal_arret_serveur;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+    sigset_t arret, precedents;
+    sigemptyset(&arret);
+    sigaddset(&arret, SIGINT);
+    sigaddset(&arret, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &arret, &precedents);
+    int nb_lances = 0;
+    for (int t = 0; t < nb_travailleurs; t++)
+    {
+        if (pthread_create(&threads[nb_lances], NULL, serveur_travailleur, &file) == 0)
+            nb_lances++;
+    }
+    pthread_sigmask(SIG_SETMASK, &precedents, NULL);
+
+    socket_ecoute_serveur = ecoute;
+    fprintf(stderr, "serveur: %s, %d travailleurs, file de %d requêtes\n", adresse.sun_path, nb_lances, profondeur);
+    int nb_connexions = 0;
+    while (!arret_serveur && nb_lances > 0)
+    {
+        //? dépôt des lignes déjà lues; une connexion n'est relue que si tout est déposé
+        int nb_lues = 0;
+        pthread_mutex_lock(&file.verrou);
+        for (int c = 0; c < nb_connexions; c++)
+        {
+            ConnexionServeur *connexion = connexions[c];
+            if (!serveur_extraire(&file, connexion) && !connexion->lecture_finie && !connexion->rompue && file.nombre < file.capacite)
+                lues[nb_lues++] = connexion;
+        }
+        serveur_fermer_connexions_finies(connexions, &nb_connexions, 0);
+        pthread_mutex_unlock(&file.verrou);
+
+        //? la socket d'écoute reste surveillée même au maximum de connexions: le shutdown
+        //? du gestionnaire de signal la rend prête (POLLHUP) et termine poll
+        surveillees[0] = (struct pollfd){.fd = file.reveil[0], .events = POLLIN};
+        surveillees[1] = (struct pollfd){.fd = ecoute, .events = (nb_connexions < CONNEXIONS_MAX_SERVEUR) ? POLLIN : 0};
+        for (int k = 0; k < nb_lues; k++)
+        {
+            surveillees[2 + k] = (struct pollfd){.fd = lues[k]->fd, .events = POLLIN};
+        }
+        if (poll(surveillees, 2 + nb_lues, -1) < 0)
+        {
+            if (errno != EINTR)
+            {
+                perror("poll");
+                break;
+            }
+            continue;
+        }
+
+        if (surveillees[0].revents)
+        {
+            char vidange[256];
+            while (read(file.reveil[0], vidange, sizeof(vidange)) > 0)
+                ;
+        }
+        for (int k = 0; k < nb_lues; k++)
+        {
+            if (surveillees[2 + k].revents)
+                serveur_lire(lues[k]);
+        }
+        if (surveillees[1].revents && !arret_serveur)
+        {
+            int fd = accept(ecoute, NULL, NULL);
+            ConnexionServeur *connexion = (fd >= 0) ? calloc(1, sizeof(ConnexionServeur)) : NULL;
+            if (!connexion)
+            {
+                if (fd >= 0)
+                    close(fd);
+                else if (errno != EINTR && errno != ECONNABORTED)
+                {
+                    perror("accept");
+                    usleep(10000); //! EMFILE, ENOBUFS: laisser des connexions se fermer
+                }
+                continue;
+            }
+            struct timeval delai = {.tv_sec = DELAI_ECRITURE_SERVEUR};
+            setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &delai, sizeof(delai));
+            connexion->fd = fd;
+            connexions[nb_connexions++] = connexion;
+        }
+    }
+
+    socket_ecoute_serveur = -1;
+    close(ecoute);
+    unlink(adresse.sun_path);
+    file_serveur_fermer(&file);
+    for (int t = 0; t < nb_lances; t++)
+    {
+        pthread_join(threads[t], NULL);
+    }
+    serveur_fermer_connexions_finies(connexions, &nb_connexions, 1);
+    fprintf(stderr, "serveur: arrêt après %lld requêtes\n", file.traitees);
+
+    pthread_mutex_destroy(&file.verrou);
+    pthread_cond_destroy(&file.non_vide);
+    close(file.reveil[0]);
+    close(file.reveil[1]);
+    free(file.requetes);
+    free(connexions);
+    free(surveillees);
+    free(lues);
+    free(threads);
     return 0;
-}
\ No newline at end of file
+}
+/*-------------------------------------------
+//? OPTIONS GLOBALES (retirées de argv avant la lecture de la commande)
+//? --threads N : nombre de threads (par défaut un par cœur)
+//? --profile[=<trace.json>] : temps par étape sur stderr, ou trace Chrome dans le fichier
+//? --direct : écriture des images en O_DIRECT quand le système de fichiers l'accepte
+//? --format <p5|p2|pgmz> : format des images écrites, quelle que soit leur extension
+---------------------------------------------*/
+int extraire_options(int argc, char **argv)
+{
+    int k = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            nb_threads_demandes = to_int(argv[++i]);
+        }
+        else if (strncmp(argv[i], "--threads=", 10) == 0)
+        {
+            nb_threads_demandes = to_int(argv[i] + 10);
+        }
+        else if (strcmp(argv[i], "--profile") == 0)
+        {
+            activer_profil(NULL);
+        }
+        else if (strncmp(argv[i], "--profile=", 10) == 0)
+        {
+            activer_profil(argv[i] + 10);
+        }
+        else if (strcmp(argv[i], "--direct") == 0)
+        {
+            sortie_directe = 1;
+        }
+        else if ((strcmp(argv[i], "--format") == 0 && i + 1 < argc) || strncmp(argv[i], "--format=", 9) == 0)
+        {
+            const char *nom = (argv[i][8] == '=') ? argv[i] + 9 : argv[++i];
+            format_sortie = trouver_codec(nom);
+            if (!format_sortie)
+            {
+                printf("format inconnu: %s (p5, p2 ou pgmz)\n", nom);
+                return 1;
+            }
+        }
+        else
+        {
+            argv[k++] = argv[i];
+        }
+    }
+    argv[k] = NULL;
+    return k;
+}
+
+#ifndef TRAITEMENT_IMAGE_BIBLIOTHEQUE
+int main(int argc, char **argv)
+{
+    int code = 0;
+
+    argc = extraire_options(argc, argv);
+    if (argc < 3)
+    {
+        printf("usage: %s [--threads N] [--profile[=<trace.json>]] [--format p5|p2|pgmz] <commande> <image> [<parametre>]\n", argv[0]);
+        printf("       %s [--threads N] batch <commande> <dossier|liste> <motif_sortie> [<parametre>]\n", argv[0]);
+        printf("       %s [--threads N] flux <commande> <entree> <sortie> [<parametre>]\n", argv[0]);
+        printf("       %s [--threads N] pipeline <image> <op1,op2:param,...> [<sortie>]\n", argv[0]);
+        printf("       %s [--threads N] hough_pics <image> <seuil[:votes[:pas_angle[:pas_rho]]]> <K> [texte|json] [<image_tracee>]\n", argv[0]);
+        printf("       %s [--threads N] hough_prob <image> <seuil[:votes[:longueur_min[:ecart_max]]]> [texte|json] [<image_tracee>]\n", argv[0]);
+        printf("       %s [--threads N] bench <dossier|liste> [<repetitions>[:<echauffement>]] [texte|csv|json]\n", argv[0]);
+        printf("       %s [--threads N] serveur <socket> [<travailleurs>[:<file>]]\n", argv[0]);
+        return 1;
+    }
+
+    //? choix des noyaux vectoriels (CPUID) avant tout traitement
+    noyaux_ponctuels();
+
+    if (strcmp(argv[1], "batch") == 0)
+    {
+        code = commande_batch(argc - 2, argv + 2);
+        arreter_pool_threads();
+        return code;
+    }
+    if (strcmp(argv[1], "flux") == 0)
+    {
+        code = commande_flux(argc - 2, argv + 2);
+        arreter_pool_threads();
+        return code;
+    }
+    if (strcmp(argv[1], "pipeline") == 0)
+    {
+        code = commande_pipeline(argc - 2, argv + 2);
+        arreter_pool_threads();
+        return code;
+    }
+    if (strcmp(argv[1], "hough_pics") == 0)
+    {
+        code = commande_hough_pics(argc - 2, argv + 2);
+        arreter_pool_threads();
+        return code;
+    }
+    if (strcmp(argv[1], "hough_prob") == 0)
+    {
+        code = commande_hough_prob(argc - 2, argv + 2);
+        arreter_pool_threads();
+        return code;
+    }
+    if (strcmp(argv[1], "bench") == 0)
+    {
+        code = commande_bench(argc - 2, argv + 2);
+        arreter_pool_threads();
+        return code;
+    }
+    if (strcmp(argv[1], "serveur") == 0)
+    {
+        code = commande_serveur(argc - 2, argv + 2);
+        arreter_pool_threads();
+        return code;
+    }
+
+    ImagePGM *image = lecture(argv[2]);
+    if (!image)
+        return 1;
+    if (strcmp(argv[1], "addition") == 0 || strcmp(argv[1], "soustraction") == 0)
+    {
+        ImagePGM *image2 = (argc > 3) ? lecture(argv[3]) : NULL;
+        ImagePGM *resultat = NULL;
+        if (image2)
+        {
+            if (strcmp(argv[1], "addition") == 0)
+            {
+                resultat = somme_images(image, image2);
+                if (resultat && enregister_pgm("somme_img.pgm", resultat) != 0)
+                    code = 1;
+            }
+            else
+            {
+                resultat = difference_images(image, image2);
+                if (resultat && enregister_pgm("diff_img.pgm", resultat) != 0)
+                    code = 1;
+            }
+        }
+        if (!resultat)
+            code = 1;
+        liberer_une_image(resultat);
+        liberer_une_image(image2);
+    }
+    else
+    {
+        const Operateur *operateur = trouver_operateur(argv[1]);
+        if (!operateur)
+        {
+            printf("Commande inconnue.\n");
+            code = 1;
+        }
+        else if (operateur->avec_parametre && argc < 4)
+        {
+            printf("la commande %s attend un paramètre\n", operateur->nom);
+            code = 1;
+        }
+        else
+        {
+            ImagePGM *resultat = appliquer_operateur(operateur, image, argv[3]);
+            if (!resultat || enregister_pgm(operateur->fichier_sortie, resultat) != 0)
+                code = 1;
+            liberer_une_image(resultat);
+        }
+    }
+
+    liberer_une_image(image);
+    arreter_pool_threads();
+    return code;
+}
+#endif
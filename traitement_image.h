@@ -0,0 +1,110 @@
+/*-------------------------------------------
+//? API C DE LA BIBLIOTHÈQUE DE TRAITEMENT D'IMAGES
+//? compilation en bibliothèque (main() exclu):
+//?   gcc -O2 -fPIC -shared -DTRAITEMENT_IMAGE_BIBLIOTHEQUE -o libtraitement_image.so main.c -lm -lpthread
+//? Les fonctions ti_* et les structures de ce fichier forment l'interface stable:
+//? TI_VERSION change si l'une d'elles change de façon incompatible.
+---------------------------------------------*/
+#ifndef TRAITEMENT_IMAGE_H
+#define TRAITEMENT_IMAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TI_VERSION 1
+
+/*-------------------------------------------
+//? IMAGE FOURNIE PAR L'APPELANT
+//? max_val <= 255: un octet par pixel; max_val > 255: unsigned short dans l'ordre natif.
+//? pas: octets entre le début de deux lignes (>= largeur x octets par pixel).
+//? La bibliothèque ne garde aucun pointeur vers pixels après le retour.
+---------------------------------------------*/
+typedef struct
+{
+    int largeur;
+    int hauteur;
+    int max_val;
+    size_t pas;
+    void *pixels;
+} TiImage;
+
+typedef enum
+{
+    TI_OK = 0,
+    TI_ERREUR_PARAMETRE = -1,  //! image, pas ou chaîne d'opérations invalide
+    TI_ERREUR_TAILLE = -2,     //! la sortie n'a pas la taille ou la profondeur du résultat
+    TI_ERREUR_MEMOIRE = -3,
+    TI_ERREUR_TRAITEMENT = -4, //! un opérateur a échoué (paramètre hors domaine, ...)
+    TI_ERREUR_SYSTEME = -5     //! shm_open, mmap, ... (errno est positionné)
+} TiCode;
+
+//! TI_VERSION de la bibliothèque chargée
+int ti_version(void);
+
+//! message lisible pour un TiCode
+const char *ti_message(int code);
+
+//! nombre de threads de calcul (0: un par cœur); à appeler avant le premier traitement
+void ti_definir_threads(int nb_threads);
+
+//! arrête les threads et libère les tampons gardés; un traitement ultérieur les recrée
+void ti_terminer(void);
+
+/*-------------------------------------------
+//? TRAITEMENT
+//? operations: même syntaxe que la commande pipeline ("gaussien,sobel_seuil:80,otsu").
+//? sortie->largeur et sortie->hauteur doivent valoir ti_taille_sortie(); sortie->max_val
+//? reçoit celle du résultat. Sans copie quand les pas valent largeur x octets par pixel
+//? et que l'opération unique garde la taille; sinon une copie ligne à ligne.
+//? entree et sortie ne doivent pas se recouvrir.
+//? Sûr entre threads: les appels concurrents se partagent le pool de calcul.
+---------------------------------------------*/
+int ti_taille_sortie(const char *operations, int largeur, int hauteur, int *largeur_sortie, int *hauteur_sortie);
+int ti_appliquer(const char *operations, const TiImage *entree, TiImage *sortie);
+
+/*-------------------------------------------
+//? CADRES EN MÉMOIRE PARTAGÉE POSIX
+//? un objet shm_open contient un EnTeteCadre de 64 octets suivi des pixels (ordre natif,
+//? pas = largeur x octets par pixel). Le producteur écrit les pixels puis appelle
+//? ti_cadre_publier; le consommateur lit sequence pour savoir qu'un nouveau cadre est prêt.
+//? ti_cadre_image donne un TiImage qui pointe dans l'objet: aucune copie de part et d'autre.
+//? Le mode serveur lit et écrit ces objets (shm:<nom>).
+---------------------------------------------*/
+#define TI_MAGIQUE_CADRE "PGMCADR1"
+#define TI_ENTETE_CADRE 64
+
+typedef struct
+{
+    char magique[8]; //! TI_MAGIQUE_CADRE, sans zéro final
+    uint32_t largeur;
+    uint32_t hauteur;
+    uint32_t max_val;
+    uint32_t octets_pixel;
+    uint64_t pas;
+    uint64_t sequence; //! incrémenté par ti_cadre_publier
+    uint8_t reserve[TI_ENTETE_CADRE - 40];
+} EnTeteCadre;
+
+typedef struct TiCadre TiCadre;
+
+//! crée (ou remplace) l'objet nom, projeté en lecture-écriture
+TiCadre *ti_cadre_creer(const char *nom, int largeur, int hauteur, int max_val);
+//! projette un cadre existant; ecriture: 0 lecture seule, 1 lecture-écriture
+TiCadre *ti_cadre_ouvrir(const char *nom, int ecriture);
+//! vue sur les pixels du cadre
+TiImage ti_cadre_image(const TiCadre *cadre);
+uint64_t ti_cadre_sequence(const TiCadre *cadre);
+//! rend les pixels écrits visibles et incrémente la séquence; retourne la nouvelle valeur
+uint64_t ti_cadre_publier(TiCadre *cadre);
+void ti_cadre_fermer(TiCadre *cadre);
+int ti_cadre_supprimer(const char *nom);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif